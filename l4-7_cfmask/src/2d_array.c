@@ -1,6 +1,7 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "const.h"
 #include "error.h"
@@ -33,6 +34,9 @@ typedef struct ias_2d_array
    get an IAS_2D_ARRAY pointer from a row pointer. */
 #define SIGNATURE 0x326589ab
 
+/* Alignment of the data of each array, a cache line */
+#define ARRAY_DATA_ALIGN 64
+
 /* Given an address returned by the allocate routine, get a pointer to the
    entire structure. */
 #define GET_ARRAY_STRUCTURE_FROM_PTR(ptr) \
@@ -52,6 +56,7 @@ HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
 3/15/2013   Song Guo         Modified from LDCM IAS library
+10/17/2026  USGS EROS        Align the data to ARRAY_DATA_ALIGN
 **************************************************************************/
 void **allocate_2d_array
 (
@@ -63,15 +68,16 @@ void **allocate_2d_array
     int row;              /* row number */
     IAS_2D_ARRAY *array;
     size_t size;
-    int data_start_index; /* data starting index */
+    uintptr_t data_start; /* address of the data */
 
     /* Calculate the size needed for the array memory. The size includes the
        size of the base structure, an array of pointers to the rows in the
        2D array, an array for the data, and additional space
        (2 * sizeof(void*)) to account for different memory alignment rules
-       on some machine architectures. */
+       on some machine architectures, plus the space to align the data. */
     size = sizeof (*array) + (rows * sizeof (void *))
-        + (rows * columns * member_size) + 2 * sizeof (void *);
+        + (rows * columns * member_size) + 2 * sizeof (void *)
+        + ARRAY_DATA_ALIGN;
 
     /* Allocate the structure */
     array = malloc (size);
@@ -89,14 +95,13 @@ void **allocate_2d_array
        block */
     array->row_array_ptr = (void **) array->memory_block;
 
-    /* The data starts after the row pointers, with the index adjusted in
-       case the void pointer and memory block pointers are not the same
-       size */
-    data_start_index = rows * sizeof (void *)
-                       / sizeof (array->memory_block[0]);
-    if ((rows % 2) == 1)
-        data_start_index++;
-    array->data_ptr = &array->memory_block[data_start_index];
+    /* The data starts at the first ARRAY_DATA_ALIGN boundary after the
+       row pointers, so each row of arrays whose row size is a multiple of
+       it starts on a cache line */
+    data_start = (uintptr_t) (array->row_array_ptr + rows);
+    data_start = (data_start + ARRAY_DATA_ALIGN - 1)
+                 / ARRAY_DATA_ALIGN * ARRAY_DATA_ALIGN;
+    array->data_ptr = (void *) data_start;
 
     /* Initialize the row pointers */
     for (row = 0; row < rows; row++)
@@ -143,3 +148,52 @@ int free_2d_array
 
     return SUCCESS;
 }
+
+/*************************************************************************
+NAME: get_2d_array_view
+
+PURPOSE: Get a flat strided view of the data of a 2D array allocated by
+         allocate_2d_array
+
+RETURNS: SUCCESS or FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The rows of the data are contiguous, so the stride is the row size.  The
+   row pointers of the array stay valid; the view is just another way to
+   reach the same data.
+**************************************************************************/
+int get_2d_array_view
+(
+    void **array_ptr,    /* I: Pointer returned by the alloc routine */
+    Raster_view_t *view  /* O: flat view of the array data */
+)
+{
+    IAS_2D_ARRAY *array;
+
+    if (array_ptr == NULL)
+        RETURN_ERROR ("No 2D array to view", "get_2d_array_view", FAILURE);
+
+    /* Convert the array_ptr into a pointer to the structure */
+    array = GET_ARRAY_STRUCTURE_FROM_PTR (array_ptr);
+
+    /* Verify it is a valid 2D array */
+    if (array->signature != SIGNATURE)
+    {
+        RETURN_ERROR ("Invalid signature on 2D array - memory "
+                      "corruption or programming error?", "get_2d_array_view",
+                      FAILURE);
+    }
+
+    view->base = array->data_ptr;
+    view->rows = array->rows;
+    view->columns = array->columns;
+    view->member_size = array->member_size;
+    view->stride = (size_t) array->columns * array->member_size;
+
+    return SUCCESS;
+}
@@ -1,6 +1,30 @@
 #ifndef MISC_2D_ARRAY_H
 #define MISC_2D_ARRAY_H
 
+#include <stddef.h>
+
+/* Flat view of the data of a 2D array: row r starts r * stride bytes after
+   base.  Kernels index the rows from it instead of loading each row pointer
+   from the row table, and hold them in restrict pointers so the compiler
+   knows the rows don't alias the other data of the loop and can vectorize
+   it.  The view doesn't own the data; it is valid until the array is
+   freed. */
+typedef struct
+{
+    char *base;           /* first element of row 0 */
+    size_t stride;        /* bytes from the start of one row to the next */
+    int rows;             /* number of rows */
+    int columns;          /* number of columns */
+    size_t member_size;   /* bytes of each element */
+} Raster_view_t;
+
+/* Pointer to the first element of a row of a view, as an array of type */
+#define RASTER_ROW(view, type, row) \
+    ((type *) ((view)->base + (size_t) (row) * (view)->stride))
+
+/* Element of a view, as type */
+#define RASTER_AT(view, type, row, col) (RASTER_ROW (view, type, row)[col])
+
 void **allocate_2d_array
 (
     int rows,          /* I: Number of rows for the 2D array */
@@ -20,4 +44,10 @@ int free_2d_array
     void **array_ptr /* I: Pointer returned by the alloc routine */
 );
 
+int get_2d_array_view
+(
+    void **array_ptr,    /* I: Pointer returned by the alloc routine */
+    Raster_view_t *view  /* O: flat view of the array data */
+);
+
 #endif
@@ -0,0 +1,455 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "const.h"
+#include "error.h"
+#include "bitplane.h"
+
+/* Number of bits set in a word */
+#if defined(__GNUC__)
+#define POPCOUNT64(word) __builtin_popcountll (word)
+#else
+static int popcount64 (uint64_t word)
+{
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL)
+           + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int) ((word * 0x0101010101010101ULL) >> 56);
+}
+#define POPCOUNT64(word) popcount64 (word)
+#endif
+
+/******************************************************************************
+MODULE:  create_bitplane
+
+PURPOSE: Allocate a bit plane with every pixel cleared
+
+RETURN: Pointer to the bit plane, NULL on error
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+Bitplane_t *create_bitplane
+(
+    int nrows,  /* I: number of rows */
+    int ncols   /* I: number of columns */
+)
+{
+    char errstr[MAX_STR_LEN];  /* error string */
+    Bitplane_t *plane = NULL;  /* bit plane to return */
+
+    plane = malloc (sizeof (Bitplane_t));
+    if (plane == NULL)
+    {
+        sprintf (errstr, "Allocating bit plane");
+        RETURN_ERROR (errstr, "create_bitplane", NULL);
+    }
+
+    plane->nrows = nrows;
+    plane->ncols = ncols;
+    plane->words_per_row = (ncols + BITPLANE_WORD_BITS - 1)
+                           / BITPLANE_WORD_BITS;
+    plane->words = calloc ((size_t) nrows * plane->words_per_row,
+                           sizeof (uint64_t));
+    if (plane->words == NULL)
+    {
+        free (plane);
+        sprintf (errstr, "Allocating bit plane words");
+        RETURN_ERROR (errstr, "create_bitplane", NULL);
+    }
+
+    return plane;
+}
+
+/******************************************************************************
+MODULE:  free_bitplane
+
+PURPOSE: Free a bit plane allocated by create_bitplane
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void free_bitplane
+(
+    Bitplane_t *plane  /* I: bit plane to free; may be NULL */
+)
+{
+    if (plane == NULL)
+        return;
+
+    free (plane->words);
+    free (plane);
+}
+
+/******************************************************************************
+MODULE:  pack_bitplane
+
+PURPOSE: Pack one bit of a byte mask into a bit plane
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void pack_bitplane
+(
+    unsigned char **mask, /* I: byte mask */
+    int bit,              /* I: bit of the mask to pack */
+    Bitplane_t *plane     /* O: bit plane of the same size as the mask */
+)
+{
+    int row, col;          /* loop indices */
+    int iword;             /* word index */
+    int ibit;              /* bit index within the word */
+    int nbits;             /* number of columns in the word */
+    uint64_t word;         /* packed pixels */
+    uint64_t *plane_row;   /* words of the current row */
+    unsigned char *mask_row; /* pixels of the current row */
+
+    for (row = 0; row < plane->nrows; row++)
+    {
+        plane_row = BITPLANE_ROW (plane, row);
+        mask_row = mask[row];
+        for (iword = 0; iword < plane->words_per_row; iword++)
+        {
+            col = iword * BITPLANE_WORD_BITS;
+            nbits = plane->ncols - col;
+            if (nbits > BITPLANE_WORD_BITS)
+                nbits = BITPLANE_WORD_BITS;
+
+            word = 0;
+            for (ibit = 0; ibit < nbits; ibit++)
+                word |= (uint64_t) ((mask_row[col + ibit] >> bit) & 1)
+                        << ibit;
+            plane_row[iword] = word;
+        }
+    }
+}
+
+/******************************************************************************
+MODULE:  unpack_bitplane
+
+PURPOSE: Set one bit of a byte mask where the bit plane is set and clear it
+         everywhere else
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void unpack_bitplane
+(
+    const Bitplane_t *plane, /* I: bit plane */
+    int bit,                 /* I: bit of the mask to set or clear */
+    unsigned char **mask     /* I/O: byte mask of the same size */
+)
+{
+    int row, col;          /* loop indices */
+    const uint64_t *plane_row; /* words of the current row */
+    unsigned char *mask_row;   /* pixels of the current row */
+    unsigned char keep = (unsigned char) ~(1 << bit); /* bits not unpacked */
+
+    for (row = 0; row < plane->nrows; row++)
+    {
+        plane_row = BITPLANE_ROW (plane, row);
+        mask_row = mask[row];
+        for (col = 0; col < plane->ncols; col++)
+        {
+            mask_row[col] = (mask_row[col] & keep)
+                | (((plane_row[col / BITPLANE_WORD_BITS]
+                     >> (col % BITPLANE_WORD_BITS)) & 1) << bit);
+        }
+    }
+}
+
+/******************************************************************************
+MODULE:  or_bitplane
+
+PURPOSE: Set the pixels of a bit plane which are set in another bit plane
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void or_bitplane
+(
+    const Bitplane_t *in_plane, /* I: bit plane */
+    Bitplane_t *out_plane       /* I/O: bit plane of the same size, set where
+                                      in_plane is set */
+)
+{
+    size_t i;               /* word index */
+    size_t nwords = (size_t) in_plane->nrows * in_plane->words_per_row;
+
+    for (i = 0; i < nwords; i++)
+        out_plane->words[i] |= in_plane->words[i];
+}
+
+/******************************************************************************
+MODULE:  or_unpack_bitplane
+
+PURPOSE: Set one bit of a byte mask where the bit plane is set, leaving it as
+         it is everywhere else
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Only the words with pixels set are unpacked, so sparse planes are cheap.
+******************************************************************************/
+void or_unpack_bitplane
+(
+    const Bitplane_t *plane, /* I: bit plane */
+    int bit,                 /* I: bit of the mask to set */
+    unsigned char **mask     /* I/O: byte mask of the same size */
+)
+{
+    int row;               /* row index */
+    int iword;             /* word index */
+    int ibit;              /* bit index within the word */
+    uint64_t word;         /* packed pixels */
+    const uint64_t *plane_row; /* words of the current row */
+
+    for (row = 0; row < plane->nrows; row++)
+    {
+        plane_row = BITPLANE_ROW (plane, row);
+        for (iword = 0; iword < plane->words_per_row; iword++)
+        {
+            word = plane_row[iword];
+            for (ibit = 0; word != 0; ibit++, word >>= 1)
+            {
+                if (word & 1)
+                    mask[row][iword * BITPLANE_WORD_BITS + ibit] |= 1 << bit;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+MODULE:  count_bitplane
+
+PURPOSE: Count the pixels set in a bit plane
+
+RETURN: Number of pixels set
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+int count_bitplane
+(
+    const Bitplane_t *plane  /* I: bit plane */
+)
+{
+    size_t i;               /* word index */
+    size_t nwords = (size_t) plane->nrows * plane->words_per_row;
+    int count = 0;          /* pixel counter */
+
+    for (i = 0; i < nwords; i++)
+        count += POPCOUNT64 (plane->words[i]);
+
+    return count;
+}
+
+/******************************************************************************
+MODULE:  bits_at
+
+PURPOSE: Get the 64 pixels of a bit plane row starting at a column, which may
+         be outside the row
+
+RETURN: The pixels, with those outside the row cleared
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static uint64_t bits_at
+(
+    const uint64_t *words, /* I: words of the row */
+    int nwords,            /* I: number of words in the row */
+    int first_col          /* I: column of the first pixel returned */
+)
+{
+    int iword;             /* word holding first_col */
+    int shift;             /* bit of first_col within that word */
+    uint64_t low = 0;      /* word holding first_col */
+    uint64_t high = 0;     /* next word */
+
+    if (first_col >= 0)
+        iword = first_col / BITPLANE_WORD_BITS;
+    else
+        iword = -((-first_col + BITPLANE_WORD_BITS - 1)
+                  / BITPLANE_WORD_BITS);
+    shift = first_col - iword * BITPLANE_WORD_BITS;
+
+    if (iword >= 0 && iword < nwords)
+        low = words[iword];
+    if (shift == 0)
+        return low;
+
+    if (iword + 1 >= 0 && iword + 1 < nwords)
+        high = words[iword + 1];
+    return (low >> shift) | (high << (BITPLANE_WORD_BITS - shift));
+}
+
+/******************************************************************************
+MODULE:  dilate_bitplane
+
+PURPOSE: Dilate a bit plane with a n x n rectangular buffer, with the same
+         results as image_dilate
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The dilation is done as a column pass which ORs whole words of the rows
+   around each row, followed by a row pass which ORs shifted words.  Each
+   word operation handles 64 pixels.
+2. With compat_border the pixels of the first and last rows and columns only
+   set themselves (and then only when the image has at least 2 rows and 2
+   columns), as in the original image_dilate.  That rule applies to the rows
+   and the columns separately, so it is applied in each pass.
+******************************************************************************/
+int dilate_bitplane
+(
+    const Bitplane_t *in_plane, /* I: bit plane to be dilated */
+    int idx,                    /* I: pixel buffer 2 * idx + 1 */
+    bool compat_border,         /* I: keep the original border handling, where
+                                      the first and last rows and columns
+                                      only set themselves */
+    Bitplane_t *out_plane       /* O: dilated bit plane of the same size */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    int nrows = in_plane->nrows;  /* number of rows */
+    int ncols = in_plane->ncols;  /* number of columns */
+    int nwords = in_plane->words_per_row; /* words in each row */
+    int row, src_row;           /* row indices */
+    int first_src = 0;          /* first row which spreads to neighbors */
+    int last_src = nrows - 1;   /* last row which spreads to neighbors */
+    int iword;                  /* word index */
+    int k;                      /* offset to the source pixels */
+    int first_col;              /* first column of the word */
+    const uint64_t *in_row;     /* words of a source row */
+    uint64_t *out_row;          /* words of the output row */
+    uint64_t *interior = NULL;  /* output row without its end columns */
+    uint64_t word;              /* dilated pixels */
+    uint64_t last_word_mask;    /* valid pixels of the last word */
+
+    memset (out_plane->words, 0, (size_t) nrows * nwords * sizeof (uint64_t));
+    if (idx < 0 || (compat_border && (nrows < 2 || ncols < 2)))
+        return SUCCESS;
+    if (compat_border)
+    {
+        first_src = 1;
+        last_src = nrows - 2;
+    }
+
+    interior = malloc (nwords * sizeof (uint64_t));
+    if (interior == NULL)
+    {
+        sprintf (errstr, "Allocating interior row");
+        RETURN_ERROR (errstr, "dilate_bitplane", FAILURE);
+    }
+
+    if (ncols % BITPLANE_WORD_BITS == 0)
+        last_word_mask = ~(uint64_t) 0;
+    else
+        last_word_mask = ((uint64_t) 1 << (ncols % BITPLANE_WORD_BITS)) - 1;
+
+    for (row = 0; row < nrows; row++)
+    {
+        out_row = BITPLANE_ROW (out_plane, row);
+
+        /* Column pass: the pixel itself, plus the rows within idx which
+           spread to their neighbors */
+        memcpy (out_row, BITPLANE_ROW (in_plane, row),
+                nwords * sizeof (uint64_t));
+        for (k = 1; k <= idx; k++)
+        {
+            src_row = row - k;
+            if (src_row >= first_src && src_row <= last_src)
+            {
+                in_row = BITPLANE_ROW (in_plane, src_row);
+                for (iword = 0; iword < nwords; iword++)
+                    out_row[iword] |= in_row[iword];
+            }
+            src_row = row + k;
+            if (src_row >= first_src && src_row <= last_src)
+            {
+                in_row = BITPLANE_ROW (in_plane, src_row);
+                for (iword = 0; iword < nwords; iword++)
+                    out_row[iword] |= in_row[iword];
+            }
+        }
+
+        /* Row pass: the pixel itself, plus the columns within idx which
+           spread to their neighbors */
+        if (idx == 0)
+            continue;
+        memcpy (interior, out_row, nwords * sizeof (uint64_t));
+        if (compat_border)
+        {
+            interior[0] &= ~(uint64_t) 1;
+            interior[(ncols - 1) / BITPLANE_WORD_BITS] &=
+                ~((uint64_t) 1 << ((ncols - 1) % BITPLANE_WORD_BITS));
+        }
+        for (iword = 0; iword < nwords; iword++)
+        {
+            first_col = iword * BITPLANE_WORD_BITS;
+            word = out_row[iword];
+            for (k = 1; k <= idx; k++)
+            {
+                word |= bits_at (interior, nwords, first_col - k)
+                        | bits_at (interior, nwords, first_col + k);
+            }
+            out_row[iword] = word;
+        }
+        out_row[nwords - 1] &= last_word_mask;
+    }
+
+    free (interior);
+
+    return SUCCESS;
+}
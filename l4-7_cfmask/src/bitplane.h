@@ -0,0 +1,86 @@
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BITPLANE_WORD_BITS 64
+
+/* One mask class packed as a bitset, 64 pixels per word.  Column col of a row
+   is bit (col % 64) of word (col / 64); the bits past the last column of each
+   row are always zero. */
+typedef struct
+{
+    int nrows;            /* number of rows */
+    int ncols;            /* number of columns */
+    int words_per_row;    /* number of words in each row */
+    uint64_t *words;      /* nrows * words_per_row packed pixels */
+} Bitplane_t;
+
+/* Pointer to the first word of a row */
+#define BITPLANE_ROW(plane, row) \
+    ((plane)->words + (size_t) (row) * (plane)->words_per_row)
+
+/* Set or test the bit of one pixel */
+#define SET_BITPLANE_PIXEL(plane, row, col) \
+    (BITPLANE_ROW (plane, row)[(col) / BITPLANE_WORD_BITS] \
+        |= (uint64_t) 1 << ((col) % BITPLANE_WORD_BITS))
+#define TEST_BITPLANE_PIXEL(plane, row, col) \
+    ((BITPLANE_ROW (plane, row)[(col) / BITPLANE_WORD_BITS] \
+        >> ((col) % BITPLANE_WORD_BITS)) & 1)
+
+Bitplane_t *create_bitplane
+(
+    int nrows,  /* I: number of rows */
+    int ncols   /* I: number of columns */
+);
+
+void free_bitplane
+(
+    Bitplane_t *plane  /* I: bit plane to free; may be NULL */
+);
+
+void pack_bitplane
+(
+    unsigned char **mask, /* I: byte mask */
+    int bit,              /* I: bit of the mask to pack */
+    Bitplane_t *plane     /* O: bit plane of the same size as the mask */
+);
+
+void unpack_bitplane
+(
+    const Bitplane_t *plane, /* I: bit plane */
+    int bit,                 /* I: bit of the mask to set or clear */
+    unsigned char **mask     /* I/O: byte mask of the same size */
+);
+
+void or_bitplane
+(
+    const Bitplane_t *in_plane, /* I: bit plane */
+    Bitplane_t *out_plane       /* I/O: bit plane of the same size, set where
+                                      in_plane is set */
+);
+
+void or_unpack_bitplane
+(
+    const Bitplane_t *plane, /* I: bit plane */
+    int bit,                 /* I: bit of the mask to set */
+    unsigned char **mask     /* I/O: byte mask of the same size */
+);
+
+int count_bitplane
+(
+    const Bitplane_t *plane  /* I: bit plane */
+);
+
+int dilate_bitplane
+(
+    const Bitplane_t *in_plane, /* I: bit plane to be dilated */
+    int idx,                    /* I: pixel buffer 2 * idx + 1 */
+    bool compat_border,         /* I: keep the original border handling, where
+                                      the first and last rows and columns
+                                      only set themselves */
+    Bitplane_t *out_plane       /* O: dilated bit plane of the same size */
+);
+
+#endif
@@ -69,6 +69,13 @@ main (int argc, char *argv[])
     float cloud_prob;         /* Default cloud probability */
     float sun_azi_temp = 0.0; /* Keep the original sun azimuth angle */
     int max_cloud_pixels; /* Maximum cloud pixel number in cloud division */
+    int num_threads;      /* Maximum number of threads to use */
+    Input_read_mode_t read_mode; /* Method for reading the input bands */
+    Height_search_t height_search; /* Cloud base height search method */
+    int perimeter_pixels; /* Min pixels of clouds scored on the perimeter */
+    Prob_storage_t prob_storage; /* How the cloud probabilities are kept */
+    bool bitplane_masks;  /* Use packed bit planes for the matching masks */
+    bool compat_dilate;   /* Keep the original dilation border handling */
     Espa_internal_meta_t xml_metadata; /* XML metadata structure */
     Envi_header_t envi_hdr;            /* output ENVI header information */
 
@@ -79,7 +86,9 @@ main (int argc, char *argv[])
     /* Read the command-line arguments, including the name of the input
        Landsat TOA reflectance product and the DEM */
     status = get_args (argc, argv, &xml_name, &cloud_prob, &cldpix,
-                       &sdpix, &max_cloud_pixels, &verbose);
+                       &sdpix, &max_cloud_pixels, &num_threads, &read_mode,
+                       &height_search, &perimeter_pixels, &prob_storage,
+                       &bitplane_masks, &compat_dilate, &verbose);
     if (status != SUCCESS)
     {
         sprintf (errstr, "calling get_args");
@@ -119,7 +128,7 @@ main (int argc, char *argv[])
                 directory, scene_name, extension);
 
     /* Open input file, read metadata, and set up buffers */
-    input = OpenInput (&xml_metadata);
+    input = OpenInput (&xml_metadata, read_mode);
     if (input == NULL)
     {
         sprintf (errstr, "opening the TOA and brightness temp files in: %s",
@@ -200,18 +209,33 @@ main (int argc, char *argv[])
     }
 
     /* Initialize the mask to clear data */
+    Raster_view_t pixel_view;  /* flat view of the pixel mask */
+    Raster_view_t conf_view;   /* flat view of the confidence mask */
+    if (get_2d_array_view ((void **) pixel_mask, &pixel_view) != SUCCESS
+        || get_2d_array_view ((void **) conf_mask, &conf_view) != SUCCESS)
+    {
+        sprintf (errstr, "Getting the mask views");
+        CFMASK_ERROR (errstr, "main");
+    }
     int row, col;
     for (row = 0; row < input->size.l; row++)
+    {
+        unsigned char *restrict pixel_row =
+            RASTER_ROW (&pixel_view, unsigned char, row);
+        unsigned char *restrict conf_row =
+            RASTER_ROW (&conf_view, unsigned char, row);
         for (col = 0; col < input->size.s; col++)
         {
-            pixel_mask[row][col] = MASK_CLEAR_LAND;
-            conf_mask[row][col] = CLOUD_CONFIDENCE_NONE;
+            pixel_row[col] = MASK_CLEAR_LAND;
+            conf_row[col] = CLOUD_CONFIDENCE_NONE;
         }
+    }
 
     /* Build the potential cloud, shadow, snow, water mask */
     status = potential_cloud_shadow_snow_mask (input, cloud_prob, &clear_ptm,
                                                &t_templ, &t_temph, pixel_mask,
-                                               conf_mask, verbose);
+                                               conf_mask, num_threads,
+                                               prob_storage, verbose);
     if (status != SUCCESS)
     {
         sprintf (errstr, "processing potential_cloud_shadow_snow_mask");
@@ -225,7 +249,10 @@ main (int argc, char *argv[])
        the pixel_mask is a bit mask as input and a value mask as output */
     status = object_cloud_shadow_match (input, clear_ptm, t_templ, t_temph,
                                         cldpix, sdpix, max_cloud_pixels,
-                                        pixel_mask, verbose);
+                                        num_threads, height_search,
+                                        perimeter_pixels, pixel_mask,
+                                        bitplane_masks, compat_dilate,
+                                        verbose);
     if (status != SUCCESS)
     {
         sprintf (errstr, "processing object_cloud_and_shadow_match");
@@ -422,6 +449,13 @@ usage ()
             " --cldpix=input_cloud_pixel_buffer"
             " --sdpix=input_shadow_pixel_buffer"
             " --max_cloud_pixels=maximum_cloud_pixel_numbers_for_cloud_division"
+            " [--threads=maximum_number_of_threads]"
+            " [--input_mode=line|scene|mmap]"
+            " [--height_search=full|coarse|compare]"
+            " [--perimeter_pixels=minimum_cloud_pixels_scored_on_perimeter]"
+            " [--prob_storage=float|quantized|recompute]"
+            " [--bitplane_masks]"
+            " [--full_border_dilate]"
             " [--verbose]\n", CFMASK_APP_NAME);
 
     printf ("\nwhere the following parameters are required:\n");
@@ -437,6 +471,42 @@ usage ()
             " (default value is 3)\n");
     printf ("    -max_cloud_pixels: maximum_cloud_pixel_number for cloud"
             " division, (default value is 0)\n");
+    printf ("    -threads: maximum number of threads used by the"
+            " multi-threaded processing steps, (default value is 1)\n");
+    printf ("    -input_mode: how the input bands are read; 'line' reads"
+            " each line from the files as it is needed, 'scene' reads each"
+            " band into memory once so later passes do no file I/O, 'mmap'"
+            " maps the band files into memory and reads the lines in place,"
+            " (default value is line)\n");
+    printf ("    -height_search: how the cloud base heights are searched in"
+            " the cloud/shadow match; 'full' scores every cloud pixel at"
+            " every height step, 'coarse' scores a sample of the pixels of"
+            " large clouds at coarse steps and then every pixel around the"
+            " best coarse height, 'compare' does the coarse search and also"
+            " the full one, and reports how closely they agree with"
+            " --verbose, (default value is full)\n");
+    printf ("    -perimeter_pixels: clouds of at least this many pixels are"
+            " scored in the cloud base height search on their perimeter"
+            " pixels and a sample of their interior pixels no larger than"
+            " the perimeter, so the work of each height step follows the"
+            " perimeter instead of the area; the shadows may differ from"
+            " scoring every pixel, 0 scores every pixel, (default value is"
+            " 0)\n");
+    printf ("    -prob_storage: how the cloud probabilities are kept between"
+            " the pcloud passes; 'float' keeps 4 bytes per pixel,"
+            " 'quantized' keeps 2 bytes per pixel and calculates the few"
+            " too close to a threshold again, 'recompute' keeps none and"
+            " reads the bands again to calculate them; the masks are the"
+            " same for all three, so pick the one which fits the memory"
+            " available, (default value is float)\n");
+    printf ("    -bitplane_masks: keep the cloud and shadow masks used by the"
+            " cloud/shadow matching as packed bit planes (64 pixels per"
+            " word), which uses less memory and dilates them faster,"
+            " (default is false)\n");
+    printf ("    -full_border_dilate: let the pixels of the first and last"
+            " rows and columns spread to their neighbors in the cloud and"
+            " shadow dilation; by default they only set themselves, as in"
+            " earlier versions, (default is false)\n");
     printf ("    -verbose: should intermediate messages be printed?"
             " (default is false)\n");
 
@@ -0,0 +1,1203 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "const.h"
+#include "error.h"
+#include "cfmask.h"
+#include "2d_array.h"
+#include "cloud_label.h"
+
+/* Initial number of provisional labels the tables are allocated for */
+#define INITIAL_LABELS 1024
+
+/* Tables kept for each provisional label during labeling, and the merges
+   between labels in the order they happened */
+typedef struct
+{
+    int size;          /* number of labels the tables hold */
+    int *parent;       /* union-find parent; the root of a set is its
+                          smallest label */
+    int *merged_into;  /* label this label's set was merged into, 0 if none */
+    int *merge_rank;   /* pixels of merged_into set to this label before the
+                          merge; later the offset of the label's pixels in
+                          the object */
+    int *count;        /* pixels set to the label; later the pixels in the
+                          label and the labels merged into it */
+    int *cursor;       /* packed pixels placed so far */
+    int num_merges;    /* number of merges */
+    int merge_size;    /* number of merges the merge tables hold */
+    int *merge_label;  /* label merged into another, in merge order */
+    int *merge_pixel;  /* pixel index (row * ncols + col) of each merge */
+} Label_tables_t;
+
+/* Atomic operations used by the strip border merges; without them the
+   labeling is always done in one thread */
+#if defined(__GNUC__)
+#define ATOMIC_LABELS 1
+#define LOAD_LABEL(ptr) __atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+#define SWAP_LABEL(ptr, old, new) \
+    __sync_bool_compare_and_swap ((ptr), (old), (new))
+#define ADD_COUNT(ptr, value) __sync_fetch_and_add ((ptr), (value))
+#else
+#define ATOMIC_LABELS 0
+#endif
+
+/* One horizontal strip of the image for the threaded labeling */
+typedef struct
+{
+    unsigned char **pixel_mask; /* I: cloud pixel mask */
+    int **cloud;          /* I/O: label raster; strip labels, then the
+                             object numbers */
+    int ncols;            /* I: number of columns */
+    int first_row;        /* I: first row of the strip */
+    int end_row;          /* I: row after the strip */
+    Label_tables_t tables; /* strip labels; parent and count are used, count
+                              holds the number of the object started by each
+                              label, 0 if it doesn't start one */
+    int num_labels;       /* number of strip labels */
+    int num_starts;       /* pixels starting a new object */
+    int label_base;       /* first shared label of the strip, less one */
+    int above_base;       /* label_base of the strip above */
+    int *shared_parent;   /* union-find parents of all the strips' labels */
+    int *shared_number;   /* object number started by each shared label */
+    int *object_number;   /* object number of each shared label */
+    unsigned int *obj_num; /* number of pixels in each object */
+    int status;           /* return value */
+} Label_strip_t;
+
+/******************************************************************************
+MODULE:  grow_array
+
+PURPOSE: Grow an int array allocated with malloc/realloc
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static int grow_array
+(
+    int **array,   /* I/O: array to grow */
+    int new_size   /* I: new number of elements */
+)
+{
+    int *new_array = realloc (*array, new_size * sizeof (int));
+
+    if (new_array == NULL)
+        return FAILURE;
+    *array = new_array;
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  grow_label_tables
+
+PURPOSE: Double the number of labels the label tables hold
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static int grow_label_tables
+(
+    Label_tables_t *tables  /* I/O: label tables */
+)
+{
+    char errstr[MAX_STR_LEN];  /* error string */
+    int new_size = (tables->size == 0) ? INITIAL_LABELS : 2 * tables->size;
+
+    if (grow_array (&tables->parent, new_size) != SUCCESS
+        || grow_array (&tables->merged_into, new_size) != SUCCESS
+        || grow_array (&tables->merge_rank, new_size) != SUCCESS
+        || grow_array (&tables->count, new_size) != SUCCESS
+        || grow_array (&tables->cursor, new_size) != SUCCESS)
+    {
+        sprintf (errstr, "Allocating label tables");
+        RETURN_ERROR (errstr, "grow_label_tables", FAILURE);
+    }
+    tables->size = new_size;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  find_root
+
+PURPOSE: Find the smallest label of the set holding a label, halving the
+         path to it
+
+RETURN: Root label
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static int find_root
+(
+    int *parent,  /* I/O: union-find parents */
+    int lab       /* I: label */
+)
+{
+    while (parent[lab] != lab)
+    {
+        parent[lab] = parent[parent[lab]];
+        lab = parent[lab];
+    }
+    return lab;
+}
+
+/******************************************************************************
+MODULE:  free_label_tables
+
+PURPOSE: Free the label tables
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static void free_label_tables
+(
+    Label_tables_t *tables  /* I/O: label tables */
+)
+{
+    free (tables->parent);
+    free (tables->merged_into);
+    free (tables->merge_rank);
+    free (tables->count);
+    free (tables->cursor);
+    free (tables->merge_label);
+    free (tables->merge_pixel);
+}
+
+/******************************************************************************
+MODULE:  label_serial
+
+PURPOSE: label each cloud pixel with a cloud number in one pass over the
+         whole image
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Two pass labeling with a union-find table, an
+                             int label raster and packed object pixels,
+                             replacing the cloud_node linked lists
+
+NOTES:
+1. Cloud pixels are 8-connected.  The first pass gives each cloud pixel the
+   smallest current label of its NW, N, NE and W neighbors, or a new label
+   when none is cloud, and merges the other neighboring sets into it.  The
+   smallest label of a set is its root, so the final object number of each
+   pixel is the label of the first pixel of its object in raster order, the
+   same numbering as the linked list version.
+2. The pixels of each object are packed in the order the linked list version
+   chained them: a pixel goes to the end of the set it joins, and a merged
+   set goes to the end of the set it is merged into.  That order only
+   matters when large objects are divided (max_cloud_pixels).  It is rebuilt
+   from the merges: each label's position inside its object follows from
+   the sizes of the labels merged into it, and the pixels are then placed
+   in one raster pass which replays the merges.
+******************************************************************************/
+static int label_serial
+(
+    unsigned char **pixel_mask, /* I: cloud pixel mask */
+    int nrows,                  /* I: number of rows */
+    int ncols,                  /* I: number of columns */
+    Cloud_objects_t *objects    /* O: label raster, packed pixels and object
+                                      tables */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    int row, col;               /* loop indices */
+    int pixel;                  /* pixel index (row * ncols + col) */
+    int neighbor[4];            /* labels of the NW, N, NE and W neighbors */
+    int ineighbor;              /* neighbor index */
+    int min;                    /* smallest neighboring set label */
+    int root;                   /* set label of a neighbor */
+    int lab;                    /* label index */
+    int imerge;                 /* merge index */
+    int pos;                    /* packed pixel index */
+    int num_clouds = 0;         /* number of provisional labels */
+    int num_pixels = 0;         /* number of cloud pixels */
+    int **cloud;                /* label raster */
+    unsigned int *obj_num;      /* number of pixels in each object */
+    unsigned int *obj_first;    /* packed index of each object */
+    Label_tables_t tables = {0};  /* label and merge tables */
+
+    cloud = objects->label;
+
+    /* First pass: provisional labels and the merges between them */
+    for (row = 0; row < nrows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            if (!(pixel_mask[row][col] & (1 << CLOUD_BIT)))
+            {
+                cloud[row][col] = 0;
+                continue;
+            }
+            num_pixels++;
+
+            neighbor[0] = (row > 0 && col > 0) ? cloud[row - 1][col - 1] : 0;
+            neighbor[1] = (row > 0) ? cloud[row - 1][col] : 0;
+            neighbor[2] = (row > 0 && col < ncols - 1)
+                          ? cloud[row - 1][col + 1] : 0;
+            neighbor[3] = (col > 0) ? cloud[row][col - 1] : 0;
+
+            /* The cloud pixel will be labeled as a new cloud if
+               neighboring pixels before it are not cloud pixels,
+               otherwise it will be labeled as lowest cloud number
+               neighboring it */
+            min = 0;
+            for (ineighbor = 0; ineighbor < 4; ineighbor++)
+            {
+                if (neighbor[ineighbor] == 0)
+                    continue;
+                root = find_root (tables.parent, neighbor[ineighbor]);
+                if (min == 0 || root < min)
+                    min = root;
+            }
+
+            if (min == 0)
+            {
+                num_clouds++;
+                if (num_clouds >= tables.size
+                    && grow_label_tables (&tables) != SUCCESS)
+                {
+                    free_label_tables (&tables);
+                    sprintf (errstr, "Growing label tables");
+                    RETURN_ERROR (errstr, "label_serial", FAILURE);
+                }
+                min = num_clouds;
+                tables.parent[min] = min;
+                tables.merged_into[min] = 0;
+                tables.count[min] = 0;
+            }
+            cloud[row][col] = min;
+            tables.count[min]++;
+
+            /* If two neighboring pixels are labeled as different cloud
+               numbers, the two cloud pixels are relabeled as the same
+               cloud */
+            for (ineighbor = 0; ineighbor < 4; ineighbor++)
+            {
+                if (neighbor[ineighbor] == 0)
+                    continue;
+                root = find_root (tables.parent, neighbor[ineighbor]);
+                if (root == min)
+                    continue;
+
+                if (tables.num_merges >= tables.merge_size)
+                {
+                    tables.merge_size = (tables.merge_size == 0)
+                        ? INITIAL_LABELS : 2 * tables.merge_size;
+                    if (grow_array (&tables.merge_label, tables.merge_size)
+                            != SUCCESS
+                        || grow_array (&tables.merge_pixel,
+                                       tables.merge_size) != SUCCESS)
+                    {
+                        free_label_tables (&tables);
+                        sprintf (errstr, "Growing merge tables");
+                        RETURN_ERROR (errstr, "label_serial", FAILURE);
+                    }
+                }
+                tables.parent[root] = min;
+                tables.merged_into[root] = min;
+                tables.merge_rank[root] = tables.count[min];
+                tables.merge_label[tables.num_merges] = root;
+                tables.merge_pixel[tables.num_merges] = row * ncols + col;
+                tables.num_merges++;
+            }
+        }
+    }
+    printf ("First pass in labeling algorithm done\n");
+
+    /* Pixels of each label including the labels merged into it; merged
+       labels are always larger than the label they are merged into */
+    for (lab = num_clouds; lab >= 1; lab--)
+    {
+        if (tables.merged_into[lab] != 0)
+            tables.count[tables.merged_into[lab]] += tables.count[lab];
+    }
+
+    /* Offset of each merged label in the label it was merged into: the
+       pixels set to that label before the merge plus the labels merged
+       into it earlier */
+    for (lab = 1; lab <= num_clouds; lab++)
+        tables.cursor[lab] = 0;
+    for (imerge = 0; imerge < tables.num_merges; imerge++)
+    {
+        lab = tables.merge_label[imerge];
+        tables.merge_rank[lab] += tables.cursor[tables.merged_into[lab]];
+        tables.cursor[tables.merged_into[lab]] += tables.count[lab];
+    }
+
+    if (grow_cloud_objects (objects, num_clouds + 1) != SUCCESS)
+    {
+        free_label_tables (&tables);
+        sprintf (errstr, "Allocating object tables");
+        RETURN_ERROR (errstr, "label_serial", FAILURE);
+    }
+    obj_num = objects->obj_num;
+    obj_first = objects->obj_first;
+
+    /* Packed offset of each label; objects are packed in object number
+       order.  The final object number of each label is kept in parent. */
+    pos = 0;
+    for (lab = 1; lab <= num_clouds; lab++)
+    {
+        if (tables.merged_into[lab] == 0)
+        {
+            tables.parent[lab] = lab;
+            tables.merge_rank[lab] = pos;
+            obj_num[lab] = tables.count[lab];
+            obj_first[lab] = pos;
+            pos += tables.count[lab];
+        }
+        else
+        {
+            root = tables.merged_into[lab];
+            tables.parent[lab] = tables.parent[root];
+            tables.merge_rank[lab] += tables.merge_rank[root];
+        }
+        tables.cursor[lab] = 0;
+    }
+
+    objects->pixel = malloc (num_pixels * sizeof (int));
+    if ((num_pixels > 0) && (objects->pixel == NULL))
+    {
+        free_label_tables (&tables);
+        sprintf (errstr, "Allocating packed cloud pixels");
+        RETURN_ERROR (errstr, "label_serial", FAILURE);
+    }
+
+    /* The second pass labels all cloud pixels with their object number and
+       packs them, replaying the merges as it goes */
+    imerge = 0;
+    for (row = 0; row < nrows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            lab = cloud[row][col];
+            if (lab == 0)
+                continue;
+
+            pixel = row * ncols + col;
+            pos = tables.merge_rank[lab] + tables.cursor[lab]++;
+            objects->pixel[pos] = pixel;
+            cloud[row][col] = tables.parent[lab];
+
+            while (imerge < tables.num_merges
+                   && tables.merge_pixel[imerge] == pixel)
+            {
+                lab = tables.merge_label[imerge];
+                tables.cursor[tables.merged_into[lab]] += tables.count[lab];
+                imerge++;
+            }
+        }
+    }
+    printf ("Second pass in labeling algorithm done\n");
+
+    objects->num_clouds = num_clouds;
+    objects->num_pixels = num_pixels;
+    free_label_tables (&tables);
+
+    return SUCCESS;
+}
+
+#if ATOMIC_LABELS
+/******************************************************************************
+MODULE:  find_shared_root
+
+PURPOSE: Find the smallest label of the set holding a label while other
+         threads may be merging sets
+
+RETURN: Root label
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Parents are never larger than their labels, so the walk ends even when a
+   root is merged while it is being read.
+******************************************************************************/
+static int find_shared_root
+(
+    int *parent,  /* I: union-find parents */
+    int lab       /* I: label */
+)
+{
+    int next;     /* parent of lab */
+
+    while ((next = LOAD_LABEL (&parent[lab])) != lab)
+        lab = next;
+    return lab;
+}
+
+/******************************************************************************
+MODULE:  merge_shared_sets
+
+PURPOSE: Merge the sets holding two labels without locks
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The larger root is pointed at the smaller one with a compare and swap,
+   which fails and is retried if another thread changed the larger root
+   first.  The smallest label of a set stays its root.
+******************************************************************************/
+static void merge_shared_sets
+(
+    int *parent,  /* I/O: union-find parents */
+    int lab1,     /* I: label in the first set */
+    int lab2      /* I: label in the second set */
+)
+{
+    int temp;     /* swap variable */
+
+    while (true)
+    {
+        lab1 = find_shared_root (parent, lab1);
+        lab2 = find_shared_root (parent, lab2);
+        if (lab1 == lab2)
+            return;
+        if (lab1 < lab2)
+        {
+            temp = lab1;
+            lab1 = lab2;
+            lab2 = temp;
+        }
+        if (SWAP_LABEL (&parent[lab1], lab1, lab2))
+            return;
+    }
+}
+
+/******************************************************************************
+MODULE:  label_strip_thread
+
+PURPOSE: Thread start routine which labels the cloud pixels of one strip,
+         ignoring the strips above and below
+
+RETURN: NULL; the return value is stored in the strip status
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Pixels which would start a new object when the whole image is labeled
+   (no NW, N, NE or W cloud neighbor, including the row above the strip) are
+   counted, so the object numbers of the serial labeling can be given out
+   once the strips are merged.
+******************************************************************************/
+static void *label_strip_thread
+(
+    void *args  /* I/O: pointer to the Label_strip_t of the strip */
+)
+{
+    Label_strip_t *strip = (Label_strip_t *) args;
+    Label_tables_t *tables = &strip->tables;
+    unsigned char **pixel_mask = strip->pixel_mask;
+    int **cloud = strip->cloud;
+    int ncols = strip->ncols;
+    int row, col;               /* loop indices */
+    int neighbor[4];            /* labels of the NW, N, NE and W neighbors */
+    int ineighbor;              /* neighbor index */
+    int min;                    /* smallest neighboring set label */
+    int root;                   /* set label of a neighbor */
+    bool starts_object;         /* pixel starts a new object */
+
+    strip->status = SUCCESS;
+    for (row = strip->first_row; row < strip->end_row; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            if (!(pixel_mask[row][col] & (1 << CLOUD_BIT)))
+            {
+                cloud[row][col] = 0;
+                continue;
+            }
+
+            starts_object = !((col > 0
+                               && (pixel_mask[row][col - 1]
+                                   & (1 << CLOUD_BIT)))
+                              || (row > 0 && col > 0
+                                  && (pixel_mask[row - 1][col - 1]
+                                      & (1 << CLOUD_BIT)))
+                              || (row > 0
+                                  && (pixel_mask[row - 1][col]
+                                      & (1 << CLOUD_BIT)))
+                              || (row > 0 && col < ncols - 1
+                                  && (pixel_mask[row - 1][col + 1]
+                                      & (1 << CLOUD_BIT))));
+
+            if (row > strip->first_row)
+            {
+                neighbor[0] = (col > 0) ? cloud[row - 1][col - 1] : 0;
+                neighbor[1] = cloud[row - 1][col];
+                neighbor[2] = (col < ncols - 1) ? cloud[row - 1][col + 1]
+                              : 0;
+            }
+            else
+                neighbor[0] = neighbor[1] = neighbor[2] = 0;
+            neighbor[3] = (col > 0) ? cloud[row][col - 1] : 0;
+
+            min = 0;
+            for (ineighbor = 0; ineighbor < 4; ineighbor++)
+            {
+                if (neighbor[ineighbor] == 0)
+                    continue;
+                root = find_root (tables->parent, neighbor[ineighbor]);
+                if (min == 0 || root < min)
+                    min = root;
+            }
+
+            if (min == 0)
+            {
+                strip->num_labels++;
+                if (strip->num_labels >= tables->size
+                    && grow_label_tables (tables) != SUCCESS)
+                {
+                    strip->status = FAILURE;
+                    return NULL;
+                }
+                min = strip->num_labels;
+                tables->parent[min] = min;
+                tables->count[min] = 0;
+                if (starts_object)
+                    tables->count[min] = ++strip->num_starts;
+            }
+            cloud[row][col] = min;
+
+            for (ineighbor = 0; ineighbor < 4; ineighbor++)
+            {
+                if (neighbor[ineighbor] == 0)
+                    continue;
+                root = find_root (tables->parent, neighbor[ineighbor]);
+                if (root != min)
+                    tables->parent[root] = min;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+MODULE:  merge_strip_thread
+
+PURPOSE: Thread start routine which merges the sets of the first row of a
+         strip with the neighboring sets of the last row of the strip above
+
+RETURN: NULL
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static void *merge_strip_thread
+(
+    void *args  /* I/O: pointer to the Label_strip_t of the strip */
+)
+{
+    Label_strip_t *strip = (Label_strip_t *) args;
+    int **cloud = strip->cloud;
+    int ncols = strip->ncols;
+    int row = strip->first_row;   /* first row of the strip */
+    int col;                      /* column index */
+    int above;                    /* column of the neighbor above */
+
+    for (col = 0; col < ncols; col++)
+    {
+        if (cloud[row][col] == 0)
+            continue;
+        for (above = col - 1; above <= col + 1; above++)
+        {
+            if (above < 0 || above >= ncols || cloud[row - 1][above] == 0)
+                continue;
+            merge_shared_sets (strip->shared_parent,
+                               strip->label_base + cloud[row][col],
+                               strip->above_base + cloud[row - 1][above]);
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+MODULE:  number_strip_thread
+
+PURPOSE: Thread start routine which sets the pixels of a strip to their
+         object numbers and counts the pixels of each object
+
+RETURN: NULL
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Pixel counts are added to the shared obj_num table once for each run of
+   pixels of the same object along a row.
+******************************************************************************/
+static void *number_strip_thread
+(
+    void *args  /* I/O: pointer to the Label_strip_t of the strip */
+)
+{
+    Label_strip_t *strip = (Label_strip_t *) args;
+    int **cloud = strip->cloud;
+    int ncols = strip->ncols;
+    int row, col;               /* loop indices */
+    int lab;                    /* shared label index */
+    int number;                 /* object number of the pixel */
+    int run_number;             /* object number of the current run */
+    int run_length;             /* pixels in the current run */
+
+    for (lab = strip->label_base + 1;
+         lab <= strip->label_base + strip->num_labels; lab++)
+    {
+        strip->object_number[lab] = strip->shared_number[
+            find_shared_root (strip->shared_parent, lab)];
+    }
+
+    for (row = strip->first_row; row < strip->end_row; row++)
+    {
+        run_number = 0;
+        run_length = 0;
+        for (col = 0; col < ncols; col++)
+        {
+            if (cloud[row][col] == 0)
+                continue;
+            number = strip->object_number[strip->label_base
+                                          + cloud[row][col]];
+            cloud[row][col] = number;
+            if (number != run_number)
+            {
+                if (run_length > 0)
+                    ADD_COUNT (&strip->obj_num[run_number], run_length);
+                run_number = number;
+                run_length = 0;
+            }
+            run_length++;
+        }
+        if (run_length > 0)
+            ADD_COUNT (&strip->obj_num[run_number], run_length);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+MODULE:  run_strip_threads
+
+PURPOSE: Run a thread start routine on every strip, one thread per strip
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The first strip is done in the calling thread.  A strip whose thread
+   can't be started is done in the calling thread once the others finish.
+******************************************************************************/
+static int run_strip_threads
+(
+    void *(*start_routine) (void *), /* I: thread start routine */
+    Label_strip_t *strips,           /* I/O: strips */
+    int first_strip,                 /* I: first strip to run */
+    int num_strips                   /* I: number of strips */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    int istrip;                 /* strip index */
+    pthread_t *threads;         /* thread of each strip */
+    bool *threaded;             /* was the strip run in a thread */
+    int status = SUCCESS;       /* return value */
+
+    threads = malloc (num_strips * sizeof (pthread_t));
+    threaded = calloc (num_strips, sizeof (bool));
+    if (threads == NULL || threaded == NULL)
+    {
+        free (threads);
+        free (threaded);
+        sprintf (errstr, "Allocating thread memory");
+        RETURN_ERROR (errstr, "run_strip_threads", FAILURE);
+    }
+
+    for (istrip = first_strip + 1; istrip < num_strips; istrip++)
+    {
+        if (pthread_create (&threads[istrip], NULL, start_routine,
+                            &strips[istrip]) == 0)
+            threaded[istrip] = true;
+    }
+    if (first_strip < num_strips)
+        start_routine (&strips[first_strip]);
+    for (istrip = first_strip + 1; istrip < num_strips; istrip++)
+    {
+        if (!threaded[istrip])
+            start_routine (&strips[istrip]);
+        else if (pthread_join (threads[istrip], NULL) != 0)
+            status = FAILURE;
+    }
+
+    free (threads);
+    free (threaded);
+    if (status != SUCCESS)
+    {
+        sprintf (errstr, "Joining labeling threads");
+        RETURN_ERROR (errstr, "run_strip_threads", FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  free_parallel_tables
+
+PURPOSE: Free the strips and shared tables of label_parallel
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Used on every return of label_parallel, so the tables not allocated yet
+   must be NULL.
+******************************************************************************/
+static void free_parallel_tables
+(
+    Label_strip_t *strips,      /* I/O: strips, each with its label tables */
+    int num_strips,             /* I: number of strips */
+    int *shared_parent,         /* I/O: union-find parents of the strip
+                                        labels */
+    int *shared_number,         /* I/O: object number started by each label */
+    int *object_number,         /* I/O: object number of each label */
+    unsigned int *cursor        /* I/O: packed pixels placed in each object */
+)
+{
+    int istrip;                 /* strip index */
+
+    if (strips != NULL)
+    {
+        for (istrip = 0; istrip < num_strips; istrip++)
+            free_label_tables (&strips[istrip].tables);
+    }
+    free (strips);
+    free (shared_parent);
+    free (shared_number);
+    free (object_number);
+    free (cursor);
+}
+
+/******************************************************************************
+MODULE:  label_parallel
+
+PURPOSE: label each cloud pixel with a cloud number, labeling horizontal
+         strips of the image in separate threads
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Each strip is labeled on its own like the first pass of label_serial.
+   The strip labels are then numbered one after the other into a shared
+   union-find table, each set pointing at its smallest label, and the sets
+   touching across each strip border are merged in parallel without locks.
+   Since the smallest label is always the root, the root of each object is
+   the strip label of its first pixel in raster order, which is a pixel
+   that starts an object.  Numbering the pixels which start an object in
+   raster order (a count within each strip plus the counts of the strips
+   above) gives every object the number label_serial gives it.
+2. The objects are the same as those of label_serial, but the pixels of each
+   object are packed in raster order, not in the order label_serial packs
+   them, so this must not be used when large objects are divided.
+******************************************************************************/
+static int label_parallel
+(
+    unsigned char **pixel_mask, /* I: cloud pixel mask */
+    int nrows,                  /* I: number of rows */
+    int ncols,                  /* I: number of columns */
+    int num_threads,            /* I: number of threads to use */
+    Cloud_objects_t *objects    /* O: label raster, packed pixels and object
+                                      tables */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    int row, col;               /* loop indices */
+    int num_strips;             /* number of strips */
+    int istrip;                 /* strip index */
+    int lab;                    /* label index */
+    int root;                   /* root of a strip label */
+    int pos;                    /* packed pixel index */
+    int num_labels = 0;         /* number of strip labels in all strips */
+    int num_clouds = 0;         /* number of objects started */
+    int num_pixels = 0;         /* number of cloud pixels */
+    int *shared_parent = NULL;  /* union-find parents of the strip labels */
+    int *shared_number = NULL;  /* object number started by each label */
+    int *object_number = NULL;  /* object number of each label */
+    unsigned int *cursor = NULL; /* packed pixels placed in each object */
+    unsigned int *obj_num;      /* number of pixels in each object */
+    unsigned int *obj_first;    /* packed index of each object */
+    Label_strip_t *strips = NULL; /* strips labeled by each thread */
+    Label_strip_t *strip;       /* current strip */
+
+    num_strips = (num_threads < nrows) ? num_threads : nrows;
+    strips = calloc (num_strips, sizeof (Label_strip_t));
+    if (strips == NULL)
+    {
+        sprintf (errstr, "Allocating strip memory");
+        RETURN_ERROR (errstr, "label_parallel", FAILURE);
+    }
+    for (istrip = 0; istrip < num_strips; istrip++)
+    {
+        strip = &strips[istrip];
+        strip->pixel_mask = pixel_mask;
+        strip->cloud = objects->label;
+        strip->ncols = ncols;
+        strip->first_row = (int) ((long) nrows * istrip / num_strips);
+        strip->end_row = (int) ((long) nrows * (istrip + 1) / num_strips);
+    }
+
+    /* Label each strip on its own */
+    if (run_strip_threads (label_strip_thread, strips, 0, num_strips)
+        != SUCCESS)
+    {
+        free_parallel_tables (strips, num_strips, shared_parent,
+                              shared_number, object_number, cursor);
+        sprintf (errstr, "Labeling strips");
+        RETURN_ERROR (errstr, "label_parallel", FAILURE);
+    }
+    for (istrip = 0; istrip < num_strips; istrip++)
+    {
+        if (strips[istrip].status != SUCCESS)
+        {
+            free_parallel_tables (strips, num_strips, shared_parent,
+                                  shared_number, object_number, cursor);
+            sprintf (errstr, "Labeling strip %d", istrip);
+            RETURN_ERROR (errstr, "label_parallel", FAILURE);
+        }
+        num_labels += strips[istrip].num_labels;
+        num_clouds += strips[istrip].num_starts;
+    }
+    printf ("First pass in labeling algorithm done\n");
+
+    if (grow_cloud_objects (objects, num_clouds + 1) != SUCCESS)
+    {
+        free_parallel_tables (strips, num_strips, shared_parent,
+                              shared_number, object_number, cursor);
+        sprintf (errstr, "Allocating object tables");
+        RETURN_ERROR (errstr, "label_parallel", FAILURE);
+    }
+    obj_num = objects->obj_num;
+    obj_first = objects->obj_first;
+
+    /* Number the strip labels one strip after the other, pointing each at
+       the root of its set within the strip */
+    shared_parent = malloc ((num_labels + 1) * sizeof (int));
+    shared_number = malloc ((num_labels + 1) * sizeof (int));
+    object_number = malloc ((num_labels + 1) * sizeof (int));
+    if (shared_parent == NULL || shared_number == NULL
+        || object_number == NULL)
+    {
+        free_parallel_tables (strips, num_strips, shared_parent,
+                              shared_number, object_number, cursor);
+        sprintf (errstr, "Allocating shared label tables");
+        RETURN_ERROR (errstr, "label_parallel", FAILURE);
+    }
+    num_labels = 0;
+    num_clouds = 0;
+    for (istrip = 0; istrip < num_strips; istrip++)
+    {
+        strip = &strips[istrip];
+        strip->label_base = num_labels;
+        strip->above_base = (istrip > 0) ? strips[istrip - 1].label_base : 0;
+        strip->shared_parent = shared_parent;
+        strip->shared_number = shared_number;
+        strip->object_number = object_number;
+        strip->obj_num = obj_num;
+        for (lab = 1; lab <= strip->num_labels; lab++)
+        {
+            root = find_root (strip->tables.parent, lab);
+            shared_parent[num_labels + lab] = num_labels + root;
+            shared_number[num_labels + lab] = (strip->tables.count[lab] > 0)
+                ? num_clouds + strip->tables.count[lab] : 0;
+        }
+        num_labels += strip->num_labels;
+        num_clouds += strip->num_starts;
+    }
+
+    /* Merge the sets across the strip borders, then number the pixels */
+    if (run_strip_threads (merge_strip_thread, strips, 1, num_strips)
+            != SUCCESS
+        || run_strip_threads (number_strip_thread, strips, 0, num_strips)
+            != SUCCESS)
+    {
+        free_parallel_tables (strips, num_strips, shared_parent,
+                              shared_number, object_number, cursor);
+        sprintf (errstr, "Merging strips");
+        RETURN_ERROR (errstr, "label_parallel", FAILURE);
+    }
+
+    /* Pack the pixels of each object in raster order */
+    for (lab = 1; lab <= num_clouds; lab++)
+    {
+        obj_first[lab] = num_pixels;
+        num_pixels += obj_num[lab];
+    }
+    objects->pixel = malloc (num_pixels * sizeof (int));
+    cursor = calloc (num_clouds + 1, sizeof (unsigned int));
+    if (cursor == NULL || ((num_pixels > 0) && (objects->pixel == NULL)))
+    {
+        free_parallel_tables (strips, num_strips, shared_parent,
+                              shared_number, object_number, cursor);
+        sprintf (errstr, "Allocating packed cloud pixels");
+        RETURN_ERROR (errstr, "label_parallel", FAILURE);
+    }
+    for (row = 0; row < nrows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            lab = objects->label[row][col];
+            if (lab == 0)
+                continue;
+            pos = obj_first[lab] + cursor[lab]++;
+            objects->pixel[pos] = row * ncols + col;
+        }
+    }
+    printf ("Second pass in labeling algorithm done\n");
+
+    objects->num_clouds = num_clouds;
+    objects->num_pixels = num_pixels;
+
+    free_parallel_tables (strips, num_strips, shared_parent, shared_number,
+                          object_number, cursor);
+
+    return SUCCESS;
+}
+
+#endif
+
+/******************************************************************************
+MODULE:  label
+
+PURPOSE: label each cloud pixel with a cloud number
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Two pass labeling with a union-find table, an
+                             int label raster and packed object pixels,
+                             replacing the cloud_node linked lists
+10/17/2026  USGS EROS        Label strips in parallel when more than one
+                             thread is allowed
+
+NOTES:
+1. Both labelings give the same objects with the same numbers.  With more
+   than one thread the pixels of each object are packed in raster order
+   (see label_parallel), otherwise in the order of the original linked list
+   version (see label_serial).
+2. On failure whatever was allocated for the objects is freed.
+******************************************************************************/
+int label
+(
+    unsigned char **pixel_mask, /* I: cloud pixel mask */
+    int nrows,                  /* I: number of rows */
+    int ncols,                  /* I: number of columns */
+    int num_threads,            /* I: number of threads to use; 1 keeps the
+                                      packed pixel order of the original
+                                      code */
+    Cloud_objects_t *objects    /* O: label raster, packed pixels and object
+                                      tables */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    int status;                 /* return value */
+
+    objects->label = NULL;
+    objects->ncols = ncols;
+    objects->pixel = NULL;
+    objects->table_size = 0;
+    objects->obj_num = NULL;
+    objects->obj_first = NULL;
+
+    objects->label = (int **) allocate_2d_array (nrows, ncols, sizeof (int));
+    if (objects->label == NULL)
+    {
+        sprintf (errstr, "Allocating label raster");
+        RETURN_ERROR (errstr, "label", FAILURE);
+    }
+
+#if ATOMIC_LABELS
+    if (num_threads > 1 && nrows > 1)
+        status = label_parallel (pixel_mask, nrows, ncols, num_threads,
+                                 objects);
+    else
+#endif
+        status = label_serial (pixel_mask, nrows, ncols, objects);
+    if (status != SUCCESS)
+    {
+        free_cloud_objects (objects);
+        sprintf (errstr, "Labeling cloud pixels");
+        RETURN_ERROR (errstr, "label", FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  grow_cloud_objects
+
+PURPOSE: Grow the obj_num and obj_first tables of the cloud objects to hold
+         at least min_size objects
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The tables at least double each time they grow, so adding objects one at
+   a time (dividing large clouds) costs a constant amount per object.  The
+   new obj_num entries are zero.
+******************************************************************************/
+int grow_cloud_objects
+(
+    Cloud_objects_t *objects,   /* I/O: objects whose tables are grown */
+    int min_size                /* I: number of objects the tables must hold */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    int new_size;               /* new number of objects */
+    unsigned int *new_table;    /* reallocated table */
+
+    if (min_size <= objects->table_size)
+        return SUCCESS;
+    new_size = 2 * objects->table_size;
+    if (new_size < min_size)
+        new_size = min_size;
+
+    new_table = realloc (objects->obj_num, new_size * sizeof (unsigned int));
+    if (new_table == NULL)
+    {
+        sprintf (errstr, "Allocating obj_num table");
+        RETURN_ERROR (errstr, "grow_cloud_objects", FAILURE);
+    }
+    memset (new_table + objects->table_size, 0,
+            (new_size - objects->table_size) * sizeof (unsigned int));
+    objects->obj_num = new_table;
+
+    new_table = realloc (objects->obj_first,
+                         new_size * sizeof (unsigned int));
+    if (new_table == NULL)
+    {
+        sprintf (errstr, "Allocating obj_first table");
+        RETURN_ERROR (errstr, "grow_cloud_objects", FAILURE);
+    }
+    objects->obj_first = new_table;
+    objects->table_size = new_size;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  free_cloud_objects
+
+PURPOSE: Free the label raster and packed pixels of the cloud objects
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+int free_cloud_objects
+(
+    Cloud_objects_t *objects    /* I/O: objects to free */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    int status;                 /* return value */
+
+    free (objects->pixel);
+    free (objects->obj_num);
+    free (objects->obj_first);
+    objects->obj_num = NULL;
+    objects->obj_first = NULL;
+    objects->table_size = 0;
+    objects->pixel = NULL;
+
+    if (objects->label != NULL)
+    {
+        status = free_2d_array ((void **) objects->label);
+        objects->label = NULL;
+        if (status != SUCCESS)
+        {
+            sprintf (errstr, "Freeing memory: label\n");
+            RETURN_ERROR (errstr, "free_cloud_objects", FAILURE);
+        }
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,51 @@
+#ifndef CLOUD_LABEL_H
+#define CLOUD_LABEL_H
+
+/* Connected cloud objects found by label.  The pixels of each object are
+   packed together (compressed sparse rows); object k is the obj_num[k]
+   packed pixels from obj_first[k]. */
+typedef struct
+{
+    int **label;       /* nrows x ncols cloud object number of each pixel,
+                          0 for non-cloud pixels */
+    int ncols;         /* number of columns of the label raster */
+    int num_clouds;    /* object numbers are 1 to num_clouds; numbers which
+                          were merged into another object have no pixels */
+    int num_pixels;    /* number of cloud pixels */
+    int *pixel;        /* pixel index (row * ncols + col) of each packed
+                          cloud pixel */
+    int table_size;    /* number of objects obj_num and obj_first hold, at
+                          least num_clouds + 1 */
+    unsigned int *obj_num;   /* number of pixels in each object */
+    unsigned int *obj_first; /* packed index of the first pixel of each
+                                object */
+} Cloud_objects_t;
+
+/* Row and column of the packed pixel pos */
+#define CLOUD_PIXEL_ROW(objects, pos) ((objects).pixel[pos] / (objects).ncols)
+#define CLOUD_PIXEL_COL(objects, pos) ((objects).pixel[pos] % (objects).ncols)
+
+int label
+(
+    unsigned char **pixel_mask, /* I: cloud pixel mask */
+    int nrows,                  /* I: number of rows */
+    int ncols,                  /* I: number of columns */
+    int num_threads,            /* I: number of threads to use; 1 keeps the
+                                      packed pixel order of the original
+                                      code */
+    Cloud_objects_t *objects    /* O: label raster, packed pixels and object
+                                      tables */
+);
+
+int grow_cloud_objects
+(
+    Cloud_objects_t *objects,   /* I/O: objects whose tables are grown */
+    int min_size                /* I: number of objects the tables must hold */
+);
+
+int free_cloud_objects
+(
+    Cloud_objects_t *objects    /* I/O: objects to free */
+);
+
+#endif
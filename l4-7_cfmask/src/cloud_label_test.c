@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "const.h"
+#include "error.h"
+#include "cfmask.h"
+#include "2d_array.h"
+#include "cloud_label.h"
+
+#define NUM_MASKS 600           /* random masks checked */
+#define MAX_SIZE 150            /* largest number of rows and columns */
+#define MAX_THREADS 10          /* largest number of labeling threads */
+#define SAMPLE_PIXELS 16        /* pixels sampled from each object */
+
+/******************************************************************************
+MODULE:  compare_objects
+
+PURPOSE: Compare the objects of the parallel labeling with those of the
+         serial labeling
+
+RETURN: Number of differences found
+
+NOTES:
+1. The objects must have the same numbers, pixel counts and packed offsets.
+   The serial labeling packs the pixels of each object in the order of the
+   original linked list version and the parallel one in raster order, so
+   each packed pixel of the parallel objects must be labeled with its object
+   and follow the pixel before it in raster order.
+******************************************************************************/
+static int compare_objects
+(
+    const Cloud_objects_t *serial,   /* I: objects labeled in one thread */
+    const Cloud_objects_t *parallel, /* I: objects labeled in threads */
+    int nrows,                       /* I: number of rows */
+    int ncols                        /* I: number of columns */
+)
+{
+    int row, col;               /* pixel location */
+    int lab;                    /* object number */
+    int pos;                    /* packed pixel index */
+    int differences = 0;        /* differences found */
+
+    if (serial->num_clouds != parallel->num_clouds
+        || serial->num_pixels != parallel->num_pixels)
+        return 1;
+
+    for (row = 0; row < nrows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            if (serial->label[row][col] != parallel->label[row][col])
+                differences++;
+        }
+    }
+
+    for (lab = 1; lab <= serial->num_clouds; lab++)
+    {
+        if (serial->obj_num[lab] != parallel->obj_num[lab])
+        {
+            differences++;
+            continue;
+        }
+        if (serial->obj_num[lab] == 0)
+            continue;
+        if (serial->obj_first[lab] != parallel->obj_first[lab])
+            differences++;
+
+        for (pos = parallel->obj_first[lab];
+             pos < parallel->obj_first[lab] + parallel->obj_num[lab]; pos++)
+        {
+            row = CLOUD_PIXEL_ROW (*parallel, pos);
+            col = CLOUD_PIXEL_COL (*parallel, pos);
+            if (parallel->label[row][col] != lab
+                || (pos > parallel->obj_first[lab]
+                    && parallel->pixel[pos] <= parallel->pixel[pos - 1]))
+                differences++;
+        }
+    }
+
+    return differences;
+}
+
+/******************************************************************************
+MODULE:  compare_pixel_index
+
+PURPOSE: qsort comparison putting pixel indices in raster order
+
+RETURN: < 0, 0 or > 0 as the first pixel goes before, with or after the
+        second
+******************************************************************************/
+static int compare_pixel_index
+(
+    const void *p1,  /* I: first pixel index */
+    const void *p2   /* I: second pixel index */
+)
+{
+    int pixel1 = *(const int *) p1;
+    int pixel2 = *(const int *) p2;
+
+    if (pixel1 != pixel2)
+        return (pixel1 < pixel2) ? -1 : 1;
+    return 0;
+}
+
+/******************************************************************************
+MODULE:  sample_object
+
+PURPOSE: Take every stride-th pixel of an object in raster order, as the
+         coarse height search samples large objects
+
+RETURN: None
+
+NOTES:
+1. pixel has obj_num[lab] elements and is left holding the object pixels in
+   raster order; its first (obj_num[lab] + stride - 1) / stride elements
+   are the sample.
+******************************************************************************/
+static void sample_object
+(
+    const Cloud_objects_t *objects, /* I: labeled objects */
+    int lab,                        /* I: object number */
+    int stride,                     /* I: object pixels per sample pixel */
+    int *pixel                      /* O: sampled pixel indices */
+)
+{
+    int num = objects->obj_num[lab];
+    int n;
+
+    for (n = 0; n < num; n++)
+        pixel[n] = objects->pixel[objects->obj_first[lab] + n];
+    qsort (pixel, num, sizeof (int), compare_pixel_index);
+    for (n = 0; n * stride < num; n++)
+        pixel[n] = pixel[n * stride];
+}
+
+/******************************************************************************
+MODULE:  compare_samples
+
+PURPOSE: Compare the coarse height search samples of the parallel labeling
+         objects with those of the serial labeling
+
+RETURN: Number of differences found, or -1 if allocating memory failed
+
+NOTES:
+1. The two labelings pack the pixels of an object in different orders, so
+   the coarse search samples in raster order to give the same shadows
+   whatever the number of threads.  Sampling in packed order would differ
+   between the labelings; those objects are counted in packed_differs.
+******************************************************************************/
+static int compare_samples
+(
+    const Cloud_objects_t *serial,   /* I: objects labeled in one thread */
+    const Cloud_objects_t *parallel, /* I: objects labeled in threads */
+    int *packed_differs              /* I/O: objects whose packed order
+                                             samples differ */
+)
+{
+    int *serial_pixel;          /* serial object sample */
+    int *parallel_pixel;        /* parallel object sample */
+    int lab;                    /* object number */
+    int num;                    /* object pixels */
+    int stride;                 /* object pixels per sample pixel */
+    int n;
+    int differences = 0;        /* differences found */
+
+    serial_pixel = malloc ((serial->num_pixels + 1) * sizeof (int));
+    parallel_pixel = malloc ((serial->num_pixels + 1) * sizeof (int));
+    if (serial_pixel == NULL || parallel_pixel == NULL)
+    {
+        free (serial_pixel);
+        free (parallel_pixel);
+        return -1;
+    }
+
+    for (lab = 1; lab <= serial->num_clouds; lab++)
+    {
+        num = serial->obj_num[lab];
+        if (num == 0)
+            continue;
+        stride = (num > SAMPLE_PIXELS) ? num / SAMPLE_PIXELS : 1;
+
+        for (n = 0; n < num; n += stride)
+        {
+            if (serial->pixel[serial->obj_first[lab] + n]
+                != parallel->pixel[parallel->obj_first[lab] + n])
+            {
+                (*packed_differs)++;
+                break;
+            }
+        }
+
+        sample_object (serial, lab, stride, serial_pixel);
+        sample_object (parallel, lab, stride, parallel_pixel);
+        for (n = 0; n * stride < num; n++)
+        {
+            if (serial_pixel[n] != parallel_pixel[n])
+                differences++;
+        }
+    }
+
+    free (serial_pixel);
+    free (parallel_pixel);
+
+    return differences;
+}
+
+/******************************************************************************
+MODULE:  main (cloud_label_test)
+
+PURPOSE: Check that labeling cloud pixels in parallel strips gives the same
+         objects and coarse height search samples as labeling them in one
+         thread, on random masks
+
+RETURN: SUCCESS if every mask gives the same objects
+        FAILURE if any doesn't
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Built and run by "make test".  The strip border merges are lock-free, so
+   it is worth running under the thread sanitizer as well, built with
+   "make test TEST_FLAGS=-fsanitize=thread".
+2. The masks have 1 to MAX_SIZE rows and columns, random cloud densities,
+   and are labeled with 2 to MAX_THREADS threads, so there are strips of a
+   single row and more threads than rows.
+3. The number of objects whose samples would differ if taken in packed
+   order is printed to show the sample check has something to catch.
+******************************************************************************/
+int main (void)
+{
+    unsigned char **pixel_mask; /* random cloud mask */
+    Cloud_objects_t serial;     /* objects labeled in one thread */
+    Cloud_objects_t parallel;   /* objects labeled in threads */
+    int nrows, ncols;           /* mask size */
+    int density;                /* percent of cloud pixels */
+    int num_threads;            /* labeling threads */
+    int row, col;               /* pixel location */
+    int imask;                  /* mask index */
+    int differences;            /* differences found in a mask */
+    int failures = 0;           /* masks which differed */
+    int packed_differs = 0;     /* objects whose packed order samples
+                                   differ */
+
+    srand (777);
+    for (imask = 0; imask < NUM_MASKS; imask++)
+    {
+        nrows = 1 + rand () % MAX_SIZE;
+        ncols = 1 + rand () % MAX_SIZE;
+        density = rand () % 100;
+        num_threads = 2 + rand () % (MAX_THREADS - 1);
+
+        pixel_mask = (unsigned char **) allocate_2d_array (nrows, ncols,
+                                                   sizeof (unsigned char));
+        if (pixel_mask == NULL)
+        {
+            printf ("Allocating the pixel mask failed\n");
+            return FAILURE;
+        }
+        for (row = 0; row < nrows; row++)
+        {
+            for (col = 0; col < ncols; col++)
+            {
+                pixel_mask[row][col] = (rand () % 100 < density)
+                                       ? 1 << CLOUD_BIT : 0;
+            }
+        }
+
+        if (label (pixel_mask, nrows, ncols, 1, &serial) != SUCCESS
+            || label (pixel_mask, nrows, ncols, num_threads, &parallel)
+               != SUCCESS)
+        {
+            printf ("Labeling mask %d failed\n", imask);
+            return FAILURE;
+        }
+
+        differences = compare_objects (&serial, &parallel, nrows, ncols);
+        if (differences == 0)
+        {
+            differences = compare_samples (&serial, &parallel,
+                                           &packed_differs);
+            if (differences < 0)
+            {
+                printf ("Allocating the sample memory failed\n");
+                return FAILURE;
+            }
+        }
+        if (differences != 0)
+        {
+            printf ("mask %d (%d x %d, %d%% cloud, %d threads): %d "
+                    "differences\n", imask, nrows, ncols, density,
+                    num_threads, differences);
+            failures++;
+        }
+
+        free_cloud_objects (&serial);
+        free_cloud_objects (&parallel);
+        free_2d_array ((void **) pixel_mask);
+    }
+
+    printf ("%d of %d masks differed\n", failures, NUM_MASKS);
+    printf ("%d objects would differ if sampled in packed order\n",
+            packed_differs);
+
+    return failures == 0 ? SUCCESS : FAILURE;
+}
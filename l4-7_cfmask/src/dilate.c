@@ -0,0 +1,323 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "const.h"
+#include "error.h"
+#include "2d_array.h"
+#include "dilate.h"
+
+/* Row used before the first set pixel of a column, far enough away that no
+   buffer size reaches it */
+#define NO_PIXEL_BEFORE (INT_MIN / 2)
+
+/******************************************************************************
+MODULE:  dilate_row
+
+PURPOSE: Dilate the bits of one row of a mask which share a buffer size along
+         the row
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Uses the van Herk/Gil-Werman algorithm: the padded row is split into
+   blocks of 2 * idx + 1 pixels, prefix and suffix ORs are taken within each
+   block, and each output pixel is one suffix OR the other prefix OR.  That
+   is three ORs per pixel whatever the buffer size, and all the bits of the
+   group are done at once.
+******************************************************************************/
+static void dilate_row
+(
+    const unsigned char *in_row, /* I: row of the mask to be dilated */
+    int ncols,                   /* I: number of columns */
+    int idx,                     /* I: pixel buffer 2 * idx + 1, >= 0 */
+    unsigned char bits,          /* I: bits to dilate */
+    bool compat_border,          /* I: first and last columns only set
+                                       themselves */
+    unsigned char *prefix,       /* I/O: scratch of ncols + 2 * idx values */
+    unsigned char *suffix,       /* I/O: scratch of ncols + 2 * idx values */
+    unsigned char *out_row       /* I/O: row the dilated bits are ORed into */
+)
+{
+    int col;                 /* column index */
+    int block;               /* first column of the block */
+    int block_end;           /* column after the block */
+    int block_size;          /* pixels in a block */
+    int padded_cols;         /* number of padded columns */
+    unsigned char acc;       /* running OR */
+
+    /* A buffer reaching past the row needs no more pixels than it has */
+    if (idx > ncols - 1)
+        idx = ncols - 1;
+    block_size = 2 * idx + 1;
+    padded_cols = ncols + 2 * idx;
+
+    /* Padded row, idx pixels on each side; with compat_border the end
+       columns don't spread to their neighbors */
+    memset (prefix, 0, padded_cols * sizeof (unsigned char));
+    for (col = 0; col < ncols; col++)
+        prefix[idx + col] = in_row[col] & bits;
+    if (compat_border)
+    {
+        prefix[idx] = 0;
+        prefix[idx + ncols - 1] = 0;
+    }
+
+    for (block = 0; block < padded_cols; block += block_size)
+    {
+        block_end = block + block_size;
+        if (block_end > padded_cols)
+            block_end = padded_cols;
+
+        acc = 0;
+        for (col = block_end - 1; col >= block; col--)
+        {
+            acc |= prefix[col];
+            suffix[col] = acc;
+        }
+        acc = 0;
+        for (col = block; col < block_end; col++)
+        {
+            acc |= prefix[col];
+            prefix[col] = acc;
+        }
+    }
+
+    /* The buffer of output column col is padded columns col to
+       col + 2 * idx */
+    for (col = 0; col < ncols; col++)
+        out_row[col] |= suffix[col] | prefix[col + 2 * idx];
+
+    if (compat_border && ncols >= 2)
+    {
+        out_row[0] |= in_row[0] & bits;
+        out_row[ncols - 1] |= in_row[ncols - 1] & bits;
+    }
+}
+
+/******************************************************************************
+MODULE:  image_dilate
+
+PURPOSE: Dilate bits of the image, each with its own n x n rectangular buffer
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+11/18/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Separable dilation whose cost does not depend
+                             on the buffer size
+10/17/2026  USGS EROS        Dilate several bits in one pass over the image
+
+NOTES:
+1. The rectangular buffer is separable, so each row is dilated along the row
+   and the result is dilated down the columns, O(1) per pixel instead of the
+   (idx + 1)^2 neighborhood scan of the original code.
+2. All the bits are done in one pass over the rows.  The bits which share a
+   buffer size are dilated along the row together by dilate_row.  The rows
+   dilated along the row are kept in a ring of max(radius) + 1 rows (at most
+   nrows).  For each column and bit the last row which has the bit set is
+   tracked; once row r + radius (or the last row, if that comes first) has
+   been read, row r of the output has the bit set if that last row is within
+   radius of r.  Each bit is written that many rows behind the rows being
+   read.
+3. The original code never spreads the pixels of the first and last rows and
+   columns to their neighbors; they only set themselves, and only when the
+   image has at least 2 rows and 2 columns.  compat_border keeps that rule,
+   which applies to the rows and the columns separately.  Without it the
+   border pixels are dilated like any other pixel.
+4. A negative radius clears the bit everywhere, like the original code.  The
+   bits of out_mask which are not dilated are left as they are.
+******************************************************************************/
+int image_dilate
+(
+    unsigned char **in_mask, /* I: Mask to be dilated */
+    int nrows,               /* I: Number of rows in the mask */
+    int ncols,               /* I: Number of columns in the mask */
+    unsigned char bits,      /* I: bits to dilate, 1 << bit for each */
+    const int *radius,       /* I: pixel buffer 2 * radius[bit] + 1 for each
+                                   bit, DILATE_MAX_BITS values */
+    bool compat_border,      /* I: keep the original border handling, where
+                                   the first and last rows and columns only
+                                   set themselves */
+    unsigned char **out_mask /* O: Mask after dilate */
+)
+{
+    char errstr[MAX_STR_LEN];     /* error string */
+    int row, col;                 /* loop indices */
+    int out_row;                  /* output row of a bit */
+    int bit;                      /* bit index */
+    int nbits = 0;                /* number of bits dilated */
+    int bit_list[DILATE_MAX_BITS]; /* bits dilated */
+    int lag[DILATE_MAX_BITS];     /* rows each bit is written behind */
+    int ibit;                     /* index into bit_list */
+    int ngroups = 0;              /* number of distinct buffer sizes */
+    int group_idx[DILATE_MAX_BITS];  /* buffer size of each group */
+    unsigned char group_bits[DILATE_MAX_BITS]; /* bits of each group */
+    int igroup;                   /* group index */
+    int idx;                      /* buffer of the current bit */
+    int max_idx = 0;              /* largest buffer */
+    int max_lag = 0;              /* largest lag */
+    int ring_size;                /* number of rows in the ring */
+    int first_src = 0;            /* first row which spreads to neighbors */
+    int last_src = nrows - 1;     /* last row which spreads to neighbors */
+    bool border_row;              /* output row only sets itself */
+    unsigned char set_bit;        /* bit to set */
+    unsigned char clear_bit;      /* bits to keep */
+    unsigned char mask;           /* dilated pixel */
+    unsigned char **ring = NULL;  /* rows dilated along the row */
+    unsigned char *src_row;       /* ring row being read or written */
+    unsigned char *prefix = NULL; /* dilate_row scratch */
+    unsigned char *suffix = NULL; /* dilate_row scratch */
+    int **before = NULL;  /* last spreading row so far in each column, for
+                             each bit */
+    int *bit_before;      /* before for the current bit */
+    int status;           /* return value */
+
+    if (nrows < 1 || ncols < 1)
+        return SUCCESS;
+
+    for (bit = 0; bit < DILATE_MAX_BITS; bit++)
+    {
+        if (!(bits & (1 << bit)))
+            continue;
+        idx = radius[bit];
+
+        /* A buffer reaching past the image needs no more rows than the
+           image has */
+        lag[nbits] = idx;
+        if (lag[nbits] < 0)
+            lag[nbits] = 0;
+        if (lag[nbits] > nrows - 1)
+            lag[nbits] = nrows - 1;
+        if (lag[nbits] > max_lag)
+            max_lag = lag[nbits];
+        bit_list[nbits++] = bit;
+
+        /* Negative buffers only clear the bit */
+        if (idx < 0)
+            continue;
+        if (idx > ncols - 1)
+            idx = ncols - 1;
+        if (idx > max_idx)
+            max_idx = idx;
+        for (igroup = 0; igroup < ngroups; igroup++)
+        {
+            if (group_idx[igroup] == idx)
+                break;
+        }
+        if (igroup == ngroups)
+        {
+            group_idx[ngroups] = idx;
+            group_bits[ngroups] = 0;
+            ngroups++;
+        }
+        group_bits[igroup] |= 1 << bit;
+    }
+    if (nbits == 0)
+        return SUCCESS;
+
+    ring_size = max_lag + 1;
+    ring = (unsigned char **) allocate_2d_array (ring_size, ncols,
+                                                 sizeof (unsigned char));
+    before = (int **) allocate_2d_array (nbits, ncols, sizeof (int));
+    prefix = malloc ((ncols + 2 * max_idx) * sizeof (unsigned char));
+    suffix = malloc ((ncols + 2 * max_idx) * sizeof (unsigned char));
+    if (ring == NULL || before == NULL || prefix == NULL || suffix == NULL)
+    {
+        sprintf (errstr, "Allocating dilate memory");
+        RETURN_ERROR (errstr, "image_dilate", FAILURE);
+    }
+
+    for (ibit = 0; ibit < nbits; ibit++)
+    {
+        for (col = 0; col < ncols; col++)
+            before[ibit][col] = NO_PIXEL_BEFORE;
+    }
+
+    if (compat_border)
+    {
+        first_src = 1;
+        last_src = nrows - 2;
+    }
+
+    /* Read one more row each time, and write each bit of the row which is
+       its lag behind */
+    for (row = 0; row < nrows + max_lag; row++)
+    {
+        if (row < nrows)
+        {
+            src_row = ring[row % ring_size];
+            memset (src_row, 0, ncols * sizeof (unsigned char));
+            for (igroup = 0; igroup < ngroups; igroup++)
+            {
+                dilate_row (in_mask[row], ncols, group_idx[igroup],
+                            group_bits[igroup], compat_border, prefix,
+                            suffix, src_row);
+            }
+
+            if (row >= first_src && row <= last_src)
+            {
+                for (ibit = 0; ibit < nbits; ibit++)
+                {
+                    set_bit = 1 << bit_list[ibit];
+                    bit_before = before[ibit];
+                    for (col = 0; col < ncols; col++)
+                    {
+                        bit_before[col] = (src_row[col] & set_bit) ? row
+                                          : bit_before[col];
+                    }
+                }
+            }
+        }
+
+        for (ibit = 0; ibit < nbits; ibit++)
+        {
+            out_row = row - lag[ibit];
+            if (out_row < 0 || out_row >= nrows)
+                continue;
+
+            bit = bit_list[ibit];
+            idx = radius[bit];
+            set_bit = 1 << bit;
+            clear_bit = ~set_bit;
+            bit_before = before[ibit];
+            src_row = ring[out_row % ring_size];
+            border_row = compat_border && nrows >= 2 && idx >= 0
+                         && (out_row == 0 || out_row == nrows - 1);
+            for (col = 0; col < ncols; col++)
+            {
+                mask = ((out_row - bit_before[col]) <= idx)
+                       | (border_row & ((src_row[col] & set_bit) != 0));
+                out_mask[out_row][col] = (out_mask[out_row][col] & clear_bit)
+                                         | (mask << bit);
+            }
+        }
+    }
+
+    free (prefix);
+    free (suffix);
+    status = free_2d_array ((void **) ring);
+    if (status != SUCCESS)
+    {
+        sprintf (errstr, "Freeing memory: ring\n");
+        RETURN_ERROR (errstr, "image_dilate", FAILURE);
+    }
+    status = free_2d_array ((void **) before);
+    if (status != SUCCESS)
+    {
+        sprintf (errstr, "Freeing memory: before\n");
+        RETURN_ERROR (errstr, "image_dilate", FAILURE);
+    }
+
+    return SUCCESS;
+}
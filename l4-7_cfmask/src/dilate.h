@@ -0,0 +1,23 @@
+#ifndef DILATE_H
+#define DILATE_H
+
+#include <stdbool.h>
+
+/* Number of bits in a mask value, the size of the radius table */
+#define DILATE_MAX_BITS 8
+
+int image_dilate
+(
+    unsigned char **in_mask, /* I: Mask to be dilated */
+    int nrows,               /* I: Number of rows in the mask */
+    int ncols,               /* I: Number of columns in the mask */
+    unsigned char bits,      /* I: bits to dilate, 1 << bit for each */
+    const int *radius,       /* I: pixel buffer 2 * radius[bit] + 1 for each
+                                   bit, DILATE_MAX_BITS values */
+    bool compat_border,      /* I: keep the original border handling, where
+                                   the first and last rows and columns only
+                                   set themselves */
+    unsigned char **out_mask /* O: Mask after dilate */
+);
+
+#endif
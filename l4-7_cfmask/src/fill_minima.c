@@ -0,0 +1,296 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "const.h"
+#include "error.h"
+#include "cfmask.h"
+#include "fill_minima.h"
+
+/* The hierarchical pixel queue holds one FIFO queue of pixel indices per
+   grey level.  Each pixel is added to the queue at most once, so the links
+   for all of the levels can share one array indexed by pixel. */
+typedef struct
+{
+    int min_level;  /* grey level of the first queue */
+    int num_levels; /* number of grey levels (queues) */
+    int *first;     /* first pixel in the queue for each level, -1 if empty */
+    int *last;      /* last pixel in the queue for each level, -1 if empty */
+    int *next;      /* next pixel in the same queue, -1 at the end */
+} Pixel_queue_t;
+
+/******************************************************************************
+MODULE:  pq_add
+
+PURPOSE: Add a pixel to the end of the queue at grey level h
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Ported from the C support code in fillminima.py
+
+NOTES:
+******************************************************************************/
+static void pq_add
+(
+    Pixel_queue_t *pixq, /* I/O: pixel queue */
+    int pixel,           /* I: pixel index (row * ncols + col) */
+    int h                /* I: grey level */
+)
+{
+    int ndx = h - pixq->min_level;  /* queue index for this level */
+
+    pixq->next[pixel] = -1;
+    if (pixq->last[ndx] != -1)
+        pixq->next[pixq->last[ndx]] = pixel;
+    else
+        pixq->first[ndx] = pixel;
+    pixq->last[ndx] = pixel;
+}
+
+/******************************************************************************
+MODULE:  fill_minima
+
+PURPOSE: Fill all local minima in an image using the reconstruction by erosion
+         (flood fill) algorithm
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Ported from fillminima.py to remove the Python
+                             dependency and the intermediate files
+
+NOTES:
+1. The algorithm is from
+       Soille, P., and Gratin, C. (1994). An efficient algorithm for drainage
+       network extraction on DEMs. J. Visual Communication and Image
+       Representation.  5(2). 181-189.
+2. The output is identical to the fillMinima routine in fillminima.py.  If
+   the image has null pixels, the non-null pixels next to them form the
+   boundary, otherwise the edges of the image do.  The boundary pixels are
+   set to the boundary value and the queue is processed up to, but not
+   including, the maximum grey level.
+******************************************************************************/
+int fill_minima
+(
+    int16 *in_img,        /* I: image to be filled (nrows * ncols) */
+    int nrows,            /* I: number of rows in the image */
+    int ncols,            /* I: number of columns in the image */
+    int16 null_value,     /* I: value of pixels outside the image */
+    float boundary_value, /* I: value the image boundary is set to; 0.0
+                                means use the image maximum */
+    int16 *out_img        /* O: filled image (nrows * ncols) */
+)
+{
+    int row, col;          /* loop indices */
+    int ir, ic;            /* neighbor loop indices */
+    int nbr_row, nbr_col;  /* neighbor row and column */
+    int pixel;             /* current pixel index */
+    int nbr;               /* neighbor pixel index */
+    int npixels = nrows * ncols; /* number of pixels in the image */
+    int h_min = SHRT_MAX;  /* minimum value of the non-null pixels */
+    int h_max = SHRT_MIN;  /* maximum value of the non-null pixels */
+    int h_crt;             /* current grey level */
+    int h_boundary;        /* boundary grey level */
+    int new_value;         /* filled value of a neighbor */
+    int null_count = 0;    /* number of null pixels */
+    int max_level;         /* highest grey level in the queue */
+    int ndx;               /* queue index of the current grey level */
+    bool is_boundary;      /* is the current pixel a boundary pixel */
+    Pixel_queue_t pixq;    /* hierarchical pixel queue */
+
+    /* Find the minimum and maximum values in the data */
+    for (pixel = 0; pixel < npixels; pixel++)
+    {
+        if (in_img[pixel] == null_value)
+        {
+            null_count++;
+            continue;
+        }
+        if (in_img[pixel] < h_min)
+            h_min = in_img[pixel];
+        if (in_img[pixel] > h_max)
+            h_max = in_img[pixel];
+    }
+
+    /* Nothing to fill if all the pixels are null */
+    if (null_count == npixels)
+    {
+        for (pixel = 0; pixel < npixels; pixel++)
+            out_img[pixel] = null_value;
+        return SUCCESS;
+    }
+
+    /* If boundary was set to zero use the maximum value */
+    if (boundary_value == 0.0)
+        h_boundary = h_max;
+    else
+        h_boundary = (int) boundary_value;
+
+    /* The queue has to hold the boundary level even if it is out of the data
+       range */
+    pixq.min_level = h_min;
+    if (h_boundary < pixq.min_level)
+        pixq.min_level = h_boundary;
+    max_level = h_max;
+    if (h_boundary > max_level)
+        max_level = h_boundary;
+    pixq.num_levels = max_level - pixq.min_level + 1;
+
+    pixq.first = malloc (pixq.num_levels * sizeof (int));
+    pixq.last = malloc (pixq.num_levels * sizeof (int));
+    pixq.next = malloc ((size_t) nrows * ncols * sizeof (int));
+    if (pixq.first == NULL || pixq.last == NULL || pixq.next == NULL)
+    {
+        free (pixq.first);
+        free (pixq.last);
+        free (pixq.next);
+        RETURN_ERROR ("Allocating pixel queue memory", "fill_minima",
+                      FAILURE);
+    }
+    for (ndx = 0; ndx < pixq.num_levels; ndx++)
+    {
+        pixq.first[ndx] = -1;
+        pixq.last[ndx] = -1;
+    }
+
+    /* Initialize the output image with the maximum value */
+    for (pixel = 0; pixel < npixels; pixel++)
+    {
+        if (in_img[pixel] == null_value)
+            out_img[pixel] = null_value;
+        else
+            out_img[pixel] = h_max;
+    }
+
+    /* Initialize the boundary */
+    for (row = 0; row < nrows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            pixel = row * ncols + col;
+            if (in_img[pixel] == null_value)
+                continue;
+
+            is_boundary = false;
+            if (null_count > 0)
+            {
+                /* Use the inner boundary of the null area */
+                for (ir = -1; ir <= 1 && !is_boundary; ir++)
+                {
+                    nbr_row = row + ir;
+                    if (nbr_row < 0 || nbr_row >= nrows)
+                        continue;
+                    for (ic = -1; ic <= 1; ic++)
+                    {
+                        nbr_col = col + ic;
+                        if (nbr_col < 0 || nbr_col >= ncols)
+                            continue;
+                        if (in_img[nbr_row * ncols + nbr_col] == null_value)
+                        {
+                            is_boundary = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            else if (row == 0 || row == nrows - 1
+                     || col == 0 || col == ncols - 1)
+            {
+                /* Use the edges of the image which aren't at the maximum */
+                if (in_img[pixel] != h_max)
+                    is_boundary = true;
+            }
+
+            if (is_boundary)
+            {
+                out_img[pixel] = h_boundary;
+                pq_add (&pixq, pixel, h_boundary);
+            }
+        }
+    }
+
+    /* Process until stability */
+    for (h_crt = pixq.min_level; h_crt < h_max; h_crt++)
+    {
+        ndx = h_crt - pixq.min_level;
+        while (pixq.first[ndx] != -1)
+        {
+            /* Remove the first pixel from the queue at this level */
+            pixel = pixq.first[ndx];
+            pixq.first[ndx] = pixq.next[pixel];
+            if (pixq.first[ndx] == -1)
+                pixq.last[ndx] = -1;
+
+            row = pixel / ncols;
+            col = pixel % ncols;
+            for (ir = -1; ir <= 1; ir++)
+            {
+                nbr_row = row + ir;
+                if (nbr_row < 0 || nbr_row >= nrows)
+                    continue;
+                for (ic = -1; ic <= 1; ic++)
+                {
+                    nbr_col = col + ic;
+                    if ((ir == 0 && ic == 0) || nbr_col < 0
+                        || nbr_col >= ncols)
+                        continue;
+
+                    /* Exclude null area of original image */
+                    nbr = nbr_row * ncols + nbr_col;
+                    if (in_img[nbr] == null_value || out_img[nbr] != h_max)
+                        continue;
+
+                    new_value = in_img[nbr];
+                    if (new_value < h_crt)
+                        new_value = h_crt;
+                    out_img[nbr] = new_value;
+                    if (in_img[nbr] < h_max)
+                        pq_add (&pixq, nbr, new_value);
+                }
+            }
+        }
+    }
+
+    free (pixq.first);
+    free (pixq.last);
+    free (pixq.next);
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  fill_minima_thread
+
+PURPOSE: Thread start routine which runs fill_minima on the image described
+         by a Fill_minima_args_t structure
+
+RETURN: NULL; the fill_minima return value is stored in args->status
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void *fill_minima_thread
+(
+    void *args /* I/O: pointer to the Fill_minima_args_t for this fill */
+)
+{
+    Fill_minima_args_t *fill_args = (Fill_minima_args_t *) args;
+
+    fill_args->status = fill_minima (fill_args->in_img, fill_args->nrows,
+                                     fill_args->ncols, fill_args->null_value,
+                                     fill_args->boundary_value,
+                                     fill_args->out_img);
+
+    return NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef FILL_MINIMA_H
+#define FILL_MINIMA_H
+
+#include "cfmask.h"
+
+/* Arguments for running fill_minima in a separate thread */
+typedef struct
+{
+    int16 *in_img;        /* I: image to be filled (nrows * ncols) */
+    int nrows;            /* I: number of rows in the image */
+    int ncols;            /* I: number of columns in the image */
+    int16 null_value;     /* I: value of pixels outside the image */
+    float boundary_value; /* I: value the image boundary is set to */
+    int16 *out_img;       /* O: filled image (nrows * ncols) */
+    int status;           /* O: return value from fill_minima */
+} Fill_minima_args_t;
+
+int fill_minima
+(
+    int16 *in_img,        /* I: image to be filled (nrows * ncols) */
+    int nrows,            /* I: number of rows in the image */
+    int ncols,            /* I: number of columns in the image */
+    int16 null_value,     /* I: value of pixels outside the image */
+    float boundary_value, /* I: value the image boundary is set to; 0.0
+                                means use the image maximum */
+    int16 *out_img        /* O: filled image (nrows * ncols) */
+);
+
+void *fill_minima_thread
+(
+    void *args /* I/O: pointer to the Fill_minima_args_t for this fill */
+);
+
+#endif
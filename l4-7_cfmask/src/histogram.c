@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "const.h"
+#include "error.h"
+#include "histogram.h"
+
+/******************************************************************************
+MODULE:  create_histogram16
+
+PURPOSE: Allocate an int16 histogram with no values
+
+RETURN: Pointer to the histogram, NULL on error
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+Histogram16_t *create_histogram16 (void)
+{
+    char errstr[MAX_STR_LEN];  /* error string */
+    Histogram16_t *hist = NULL; /* histogram to return */
+
+    hist = malloc (sizeof (Histogram16_t));
+    if (hist == NULL)
+    {
+        sprintf (errstr, "Allocating histogram");
+        RETURN_ERROR (errstr, "create_histogram16", NULL);
+    }
+
+    hist->nums = 0;
+    hist->counts = calloc (HISTOGRAM16_BINS, sizeof (int));
+    if (hist->counts == NULL)
+    {
+        free (hist);
+        sprintf (errstr, "Allocating histogram counts");
+        RETURN_ERROR (errstr, "create_histogram16", NULL);
+    }
+
+    return hist;
+}
+
+/******************************************************************************
+MODULE:  free_histogram16
+
+PURPOSE: Free a histogram allocated by create_histogram16
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void free_histogram16
+(
+    Histogram16_t *hist  /* I: histogram to free; may be NULL */
+)
+{
+    if (hist == NULL)
+        return;
+    free (hist->counts);
+    free (hist);
+}
+
+/******************************************************************************
+MODULE:  histogram16_prctile
+
+PURPOSE: Calculate a percentile of the values counted in an int16 histogram
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. prctile builds the same histogram from the values and then does the
+   same calculation, so for the same values, min and max the result is the
+   same as prctile gives.
+******************************************************************************/
+void histogram16_prctile
+(
+    const Histogram16_t *hist, /* I: histogram of the values */
+    int16 min,    /* I: minimum value in the histogram, or less */
+    int16 max,    /* I: maximum value in the histogram, or more */
+    float prct,   /* I: percentage threshold */
+    float *result /* O: percentile calculated */
+)
+{
+    const int *interval;      /* counts of the values from min up */
+    int j;                    /* loop variable */
+    int loops;                /* data range for input data */
+    float inv_nums_100;       /* inverse of the nums value * 100 */
+    int sum;
+
+    /* Just return 0 if no input value */
+    if (hist->nums == 0)
+    {
+        *result = 0.0;
+        return;
+    }
+    *result = max;
+
+    interval = hist->counts + ((int) min - SHRT_MIN);
+    loops = max - min + 1;
+    inv_nums_100 = (1.0/((float) hist->nums)) * 100.0;
+    sum = 0;
+    for (j = 0; j < loops; j++)
+    {
+        sum += interval[j];
+        if (((float) sum * inv_nums_100) >= prct)
+        {
+            *result = (float) (min + j);
+            break;
+        }
+    }
+}
+
+/******************************************************************************
+MODULE:  create_binned_histogram
+
+PURPOSE: Allocate a binned float histogram with no values
+
+RETURN: Pointer to the histogram, NULL on error
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+Binned_histogram_t *create_binned_histogram (void)
+{
+    char errstr[MAX_STR_LEN];  /* error string */
+    Binned_histogram_t *hist = NULL; /* histogram to return */
+
+    hist = malloc (sizeof (Binned_histogram_t));
+    if (hist == NULL)
+    {
+        sprintf (errstr, "Allocating histogram");
+        RETURN_ERROR (errstr, "create_binned_histogram", NULL);
+    }
+
+    hist->spill = NULL;
+    hist->num_spill = 0;
+    hist->spill_size = 0;
+    hist->nums = 0;
+    hist->bins = create_histogram16 ();
+    if (hist->bins == NULL)
+    {
+        free (hist);
+        sprintf (errstr, "Allocating histogram bins");
+        RETURN_ERROR (errstr, "create_binned_histogram", NULL);
+    }
+
+    return hist;
+}
+
+/******************************************************************************
+MODULE:  free_binned_histogram
+
+PURPOSE: Free a histogram allocated by create_binned_histogram
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void free_binned_histogram
+(
+    Binned_histogram_t *hist  /* I: histogram to free; may be NULL */
+)
+{
+    if (hist == NULL)
+        return;
+    free_histogram16 (hist->bins);
+    free (hist->spill);
+    free (hist);
+}
+
+/******************************************************************************
+MODULE:  add_binned_value
+
+PURPOSE: Add a value to a binned float histogram
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The value is binned to its nearest integer with rint, as in prctile2.
+******************************************************************************/
+int add_binned_value
+(
+    Binned_histogram_t *hist, /* I/O: histogram */
+    float value               /* I: value to add */
+)
+{
+    char errstr[MAX_STR_LEN];  /* error string */
+    int bin = (int) rint (value); /* nearest integer */
+    int *spill;                /* reallocated list */
+
+    hist->nums++;
+    if (bin >= SHRT_MIN && bin <= SHRT_MAX)
+    {
+        hist->bins->counts[bin - SHRT_MIN]++;
+        return SUCCESS;
+    }
+
+    if (hist->num_spill == hist->spill_size)
+    {
+        spill = realloc (hist->spill, (2 * hist->spill_size + 64)
+                                      * sizeof (int));
+        if (spill == NULL)
+        {
+            sprintf (errstr, "Allocating histogram list");
+            RETURN_ERROR (errstr, "add_binned_value", FAILURE);
+        }
+        hist->spill = spill;
+        hist->spill_size = 2 * hist->spill_size + 64;
+    }
+    hist->spill[hist->num_spill++] = bin;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  compare_int
+
+PURPOSE: qsort comparison for ascending ints
+
+RETURN: < 0, 0 or > 0 as the first int is less, equal or greater
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static int compare_int
+(
+    const void *p1,  /* I: first int */
+    const void *p2   /* I: second int */
+)
+{
+    int i1 = *(const int *) p1;
+    int i2 = *(const int *) p2;
+
+    return (i1 > i2) - (i1 < i2);
+}
+
+/******************************************************************************
+MODULE:  binned_prctile
+
+PURPOSE: Calculate a percentile of the values counted in a binned float
+         histogram
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. prctile2 bins the values the same way and then steps through the
+   integers from rint (min) to rint (max) + 1, so for the same values, min
+   and max the result is the same as prctile2 gives.  The cumulative count
+   only changes at the integers with values, so after the first integer
+   only those are checked, which skips the empty stretches outside the
+   int16 bins.
+******************************************************************************/
+void binned_prctile
+(
+    Binned_histogram_t *hist, /* I/O: histogram of the values; the list of
+                                      values outside the bins is sorted */
+    float min,    /* I: minimum value in the histogram, or less */
+    float max,    /* I: maximum value in the histogram, or more */
+    float prct,   /* I: percentage threshold */
+    float *result /* O: percentile calculated */
+)
+{
+    int start, end;           /* start/end variables */
+    int bin;                  /* integer being checked */
+    int next;                 /* next integer with values */
+    int i = 0;                /* index of the next value in the list */
+    float inv_nums_100;       /* inverse of the nums value * 100 */
+    int sum;
+
+    /* Just return 0 if no input value */
+    if (hist->nums == 0)
+    {
+        *result = 0.0;
+        return;
+    }
+    *result = max;
+
+    start = (int) rint (min);
+    end = (int) rint (max);
+
+    qsort (hist->spill, hist->num_spill, sizeof (int), compare_int);
+    while (i < hist->num_spill && hist->spill[i] < start)
+        i++;
+
+    inv_nums_100 = (1.0/((float) hist->nums)) * 100.0;
+    sum = 0;
+    bin = start;
+    while (bin <= end + 1)
+    {
+        if (bin >= SHRT_MIN && bin <= SHRT_MAX)
+            sum += hist->bins->counts[bin - SHRT_MIN];
+        while (i < hist->num_spill && hist->spill[i] == bin)
+        {
+            sum++;
+            i++;
+        }
+        if (((float) sum * inv_nums_100) >= prct)
+        {
+            *result = (float) bin;
+            break;
+        }
+
+        /* Step to the next integer in the bins, else to the next one in
+           the list or the start of the bins */
+        if (bin >= SHRT_MIN - 1 && bin < SHRT_MAX)
+            bin++;
+        else
+        {
+            next = end + 2;
+            if (i < hist->num_spill)
+                next = hist->spill[i];
+            if (bin < SHRT_MIN && next > SHRT_MIN)
+                next = SHRT_MIN;
+            bin = next;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <limits.h>
+
+#include "cfmask.h"
+
+/* Number of bins of an int16 histogram, one for each value */
+#define HISTOGRAM16_BINS (SHRT_MAX - SHRT_MIN + 1)
+
+/* Count of each int16 value added, so the percentiles of the values can be
+   found without keeping them.  Value v is counted in counts[v - SHRT_MIN]. */
+typedef struct
+{
+    int *counts;          /* HISTOGRAM16_BINS counts */
+    int nums;             /* number of values added */
+} Histogram16_t;
+
+/* Add one value to a histogram */
+#define ADD_HISTOGRAM16_VALUE(hist, value) \
+    ((hist)->counts[(int) (value) - SHRT_MIN]++, (hist)->nums++)
+
+Histogram16_t *create_histogram16 (void);
+
+void free_histogram16
+(
+    Histogram16_t *hist  /* I: histogram to free; may be NULL */
+);
+
+void histogram16_prctile
+(
+    const Histogram16_t *hist, /* I: histogram of the values */
+    int16 min,    /* I: minimum value in the histogram, or less */
+    int16 max,    /* I: maximum value in the histogram, or more */
+    float prct,   /* I: percentage threshold */
+    float *result /* O: percentile calculated */
+);
+
+/* Count of float values binned to their nearest integers, as prctile2 bins
+   them.  The nearest integers in the int16 range are counted in bins; the
+   rest, which are rare, are kept in a list. */
+typedef struct
+{
+    Histogram16_t *bins;  /* counts of the nearest integers in the int16
+                             range */
+    int *spill;           /* nearest integers outside the int16 range */
+    int num_spill;        /* number of values in spill */
+    int spill_size;       /* number of values spill has room for */
+    int nums;             /* number of values added */
+} Binned_histogram_t;
+
+Binned_histogram_t *create_binned_histogram (void);
+
+void free_binned_histogram
+(
+    Binned_histogram_t *hist  /* I: histogram to free; may be NULL */
+);
+
+int add_binned_value
+(
+    Binned_histogram_t *hist, /* I/O: histogram */
+    float value               /* I: value to add */
+);
+
+void binned_prctile
+(
+    Binned_histogram_t *hist, /* I/O: histogram of the values; the list of
+                                      values outside the bins is sorted */
+    float min,    /* I: minimum value in the histogram, or less */
+    float max,    /* I: maximum value in the histogram, or more */
+    float prct,   /* I: percentage threshold */
+    float *result /* O: percentile calculated */
+);
+
+#endif
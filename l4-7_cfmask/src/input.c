@@ -2,6 +2,10 @@
 !File: input.c
 *****************************************************************************/
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "raw_binary_io.h"
@@ -132,6 +136,325 @@ dn_to_toa_saturation (Input_t *input)
     }
 }
 
+/******************************************************************************
+MODULE:  read_scene_band
+
+PURPOSE: Read all the lines of an input band into a newly allocated buffer
+
+RETURN: Pointer to the band data (size.l * size.s) or NULL on error
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static int16 *read_scene_band
+(
+    FILE *fp,             /* I: raw binary file pointer for the band */
+    Img_coord_int_t size  /* I: number of lines and samples in the band */
+)
+{
+    int16 *scene_buf = NULL;  /* buffer for the whole band */
+
+    scene_buf = malloc ((size_t) size.l * size.s * sizeof (int16));
+    if (scene_buf == NULL)
+        RETURN_ERROR ("allocating band buffer", "read_scene_band", NULL);
+
+    if (fseek (fp, 0L, SEEK_SET))
+    {
+        free (scene_buf);
+        RETURN_ERROR ("error seeking band (binary)", "read_scene_band", NULL);
+    }
+    if (read_raw_binary (fp, size.l, size.s, sizeof (int16), scene_buf)
+        != SUCCESS)
+    {
+        free (scene_buf);
+        RETURN_ERROR ("error reading band (binary)", "read_scene_band", NULL);
+    }
+
+    return scene_buf;
+}
+
+/******************************************************************************
+MODULE:  map_scene_band
+
+PURPOSE: Map all the lines of an input band into memory
+
+RETURN: Pointer to the mapped band data (size.l * size.s) or NULL on error
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The mapping is private and writable, so the in-place updates the
+   processing makes to the line buffers never reach the file.
+2. The mapping stays valid after the file is closed and is released with
+   munmap.
+******************************************************************************/
+static int16 *map_scene_band
+(
+    FILE *fp,             /* I: raw binary file pointer for the band */
+    Img_coord_int_t size  /* I: number of lines and samples in the band */
+)
+{
+    void *map = NULL;     /* mapped band data */
+    size_t map_size;      /* number of bytes in the band */
+    struct stat file_stat; /* band file status */
+
+    map_size = (size_t) size.l * size.s * sizeof (int16);
+    if (fstat (fileno (fp), &file_stat) != 0)
+        RETURN_ERROR ("error getting band file size", "map_scene_band",
+                      NULL);
+    if (map_size == 0 || (size_t) file_stat.st_size < map_size)
+        RETURN_ERROR ("band file is smaller than the band size",
+                      "map_scene_band", NULL);
+
+    map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                fileno (fp), 0);
+    if (map == MAP_FAILED)
+        RETURN_ERROR ("error mapping band file", "map_scene_band", NULL);
+
+    /* The passes go through the bands from top to bottom; this is only a
+       hint, so failures are ignored */
+    madvise (map, map_size, MADV_SEQUENTIAL);
+    madvise (map, map_size, MADV_WILLNEED);
+
+    return (int16 *) map;
+}
+
+/******************************************************************************
+MODULE:  therm_to_celsius
+
+PURPOSE: Convert the whole thermal band from scaled Kelvin to the unscaled
+         Celsius values (degrees Celsius * 100) the processing is based on
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Moved the conversion out of GetInputThermLine so
+                             it is done once per pixel
+
+NOTES:
+1. Fill and saturated pixels are left as fill or saturated, which is what
+   the cloud/shadow match uses.  GetInputThermLine sets the saturated values
+   to the maximum temperature for pcloud.
+2. The loop has no branches or calls so the compiler can vectorize it (gcc
+   does so at -O3 or with -ftree-vectorize).  The float/double rounding
+   steps are the same as the original per line conversion, so the results
+   are identical.
+******************************************************************************/
+static void therm_to_celsius
+(
+    Input_t *this  /* I/O: 'input' data structure; therm_scene_buf is
+                           converted in place */
+)
+{
+    int16 *therm = this->therm_scene_buf;  /* thermal band data */
+    int16 fill = this->meta.fill;          /* fill value */
+    int16 satu = this->meta.therm_satu_value_ref;  /* saturation value */
+    float scale = this->meta.therm_scale_fact;     /* thermal scale factor */
+    size_t npixels = (size_t) this->size.l * this->size.s;
+    size_t i;          /* looping variable */
+    float therm_val;   /* thermal value converted from Kelvin to Celsius */
+    int16 raw;         /* original thermal value */
+    int16 celsius;     /* rounded Celsius value */
+    int16 keep;        /* all bits set if the original value is kept */
+
+    for (i = 0; i < npixels; i++)
+    {
+        /* unscale and convert to celsius, then apply the old scale factor
+           that the cfmask processing is based upon */
+        raw = therm[i];
+        therm_val = raw * scale;
+        therm_val -= 273.15;
+        therm_val *= 100.0;
+        celsius = (int) (therm_val + 0.5);
+
+        /* select with a mask rather than a branch */
+        keep = -((raw == fill) | (raw == satu));
+        therm[i] = (raw & keep) | (celsius & ~keep);
+    }
+}
+
+/******************************************************************************
+MODULE:  set_saturated_values
+
+PURPOSE: Set the saturated values of a TOA reflectance band or line to the
+         maximum reflectance, or of a thermal line to the maximum
+         temperature
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Moved out of the passes of
+                             potential_cloud_shadow_snow_mask so it is done
+                             once per pixel
+
+NOTES:
+1. Every value is written with a select, so the loop vectorizes, unless
+   only_saturated is set.  Then only the saturated values are written, so
+   the pages of a mapped band without any stay shared with the file.
+******************************************************************************/
+static void set_saturated_values
+(
+    int16 *data,      /* I/O: band values */
+    size_t npixels,   /* I: number of values */
+    int satu_ref,     /* I: saturation value of the band */
+    int satu_max,     /* I: maximum value of the band */
+    bool only_saturated /* I: write only the saturated values */
+)
+{
+    size_t i;         /* looping variable */
+
+    if (only_saturated)
+    {
+        for (i = 0; i < npixels; i++)
+        {
+            if (data[i] == satu_ref)
+                data[i] = satu_max;
+        }
+    }
+    else
+    {
+        for (i = 0; i < npixels; i++)
+            data[i] = (data[i] == satu_ref) ? satu_max : data[i];
+    }
+}
+
+/******************************************************************************
+MODULE:  fill_test_line
+
+PURPOSE: Test which pixels of one line are fill in any band
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Due to a problem with the input LPGS data, the thermal band may have
+   values less than -9999 after scaling so those are fill as well.
+2. The restrict qualified parameters let the compiler vectorize the loop
+   without checking for overlapping lines.
+******************************************************************************/
+static void fill_test_line
+(
+    const int16 *restrict blue,   /* I: one line of each band */
+    const int16 *restrict green,
+    const int16 *restrict red,
+    const int16 *restrict nir,
+    const int16 *restrict swir1,
+    const int16 *restrict swir2,
+    const int16 *restrict therm,
+    int ncols,                    /* I: number of columns */
+    unsigned char *restrict fill  /* O: 1 for the fill pixels, else 0 */
+)
+{
+    int col;           /* column index */
+
+    for (col = 0; col < ncols; col++)
+    {
+        fill[col] = (therm[col] <= -9999) | (blue[col] == -9999)
+                    | (green[col] == -9999) | (red[col] == -9999)
+                    | (nir[col] == -9999) | (swir1[col] == -9999)
+                    | (swir2[col] == -9999);
+    }
+}
+
+/******************************************************************************
+MODULE:  build_fill_plane
+
+PURPOSE: Find the pixels which are fill in any band
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Moved the fill test out of the passes of
+                             potential_cloud_shadow_snow_mask so it is done
+                             once per pixel
+
+NOTES:
+1. The fill test is the one the passes of potential_cloud_shadow_snow_mask
+   did on every pixel, see fill_test_line.
+******************************************************************************/
+static int build_fill_plane
+(
+    Input_t *this  /* I/O: 'input' data structure; fill_plane is set */
+)
+{
+    int row;           /* row index */
+    int col;           /* column index */
+    int ib;            /* band index */
+    int iword;         /* bit plane word index */
+    int ibit;          /* bit index within the word */
+    int nbits;         /* number of columns in the word */
+    uint64_t *words;   /* bit plane words of the row */
+    uint64_t word;     /* fill pixels of the word */
+    unsigned char *fill_line = NULL; /* is each pixel of the row fill */
+
+    this->fill_plane = create_bitplane (this->size.l, this->size.s);
+    fill_line = malloc (this->size.s * sizeof (unsigned char));
+    if (this->fill_plane == NULL || fill_line == NULL)
+    {
+        free (fill_line);
+        RETURN_ERROR ("allocating fill bit plane", "build_fill_plane",
+                      FAILURE);
+    }
+
+    for (row = 0; row < this->size.l; row++)
+    {
+        for (ib = 0; ib < this->nband; ib++)
+        {
+            if (!GetInputLine (this, ib, row))
+            {
+                free (fill_line);
+                RETURN_ERROR ("reading input TOA line", "build_fill_plane",
+                              FAILURE);
+            }
+        }
+        if (!GetInputThermLine (this, row))
+        {
+            free (fill_line);
+            RETURN_ERROR ("reading input thermal line", "build_fill_plane",
+                          FAILURE);
+        }
+
+        /* Test the whole row first, which vectorizes, then pack it */
+        fill_test_line (this->buf[BI_BLUE], this->buf[BI_GREEN],
+            this->buf[BI_RED], this->buf[BI_NIR], this->buf[BI_SWIR_1],
+            this->buf[BI_SWIR_2], this->therm_buf, this->size.s, fill_line);
+
+        words = BITPLANE_ROW (this->fill_plane, row);
+        for (iword = 0; iword < this->fill_plane->words_per_row; iword++)
+        {
+            word = 0;
+            col = iword * BITPLANE_WORD_BITS;
+            nbits = this->size.s - col;
+            if (nbits > BITPLANE_WORD_BITS)
+                nbits = BITPLANE_WORD_BITS;
+            for (ibit = 0; ibit < nbits; ibit++)
+                word |= (uint64_t) fill_line[col + ibit] << ibit;
+            words[iword] = word;
+        }
+    }
+
+    free (fill_line);
+    return SUCCESS;
+}
+
 /******************************************************************************
 !Description: 'OpenInput' sets up the 'input' data structure, opens the
  input file for read access, allocates space, and stores some of the metadata.
@@ -147,12 +470,19 @@ Date        Programmer       Reason
 --------    ---------------  -------------------------------------
 2/13/2014   Gail Schmidt     Modified to work with ESPA internal raw binary
                              file format
+10/17/2026  USGS EROS        Added the read_mode to optionally read each band
+                             into memory once
+10/17/2026  USGS EROS        Added the INPUT_READ_MMAP read_mode
+10/17/2026  USGS EROS        Read and convert the thermal band once
+10/17/2026  USGS EROS        Set the saturated values to the maximum values
+                             and find the fill pixels once
 
 !Design Notes:
 ******************************************************************************/
 Input_t *OpenInput
 (
-    Espa_internal_meta_t *metadata /* I: input metadata */
+    Espa_internal_meta_t *metadata, /* I: input metadata */
+    Input_read_mode_t read_mode     /* I: method for reading the input bands */
 )
 {
     Input_t *this = NULL;
@@ -178,6 +508,11 @@ Input_t *OpenInput
     }
 
     /* Open TOA reflectance files for access */
+    this->read_mode = read_mode;
+    this->therm_scene_buf = NULL;
+    this->fill_plane = NULL;
+    for (ib = 0; ib < BI_REFL_BAND_COUNT; ib++)
+        this->scene_buf[ib] = NULL;
     for (ib = 0; ib < this->nband; ib++)
     {
         printf ("DEBUG: band %d filename: %s\n", ib, this->file_name[ib]);
@@ -198,15 +533,24 @@ Input_t *OpenInput
         this->open_therm = true;
 
     /* Allocate input buffers.  Thermal band only has one band.  Image and QA
-       buffers have multiple bands. */
-    buf = calloc ((size_t) (this->size.s * this->nband), sizeof (int16));
-    if (buf == NULL)
-        error_string = "allocating input buffer";
+       buffers have multiple bands.  The mapped image lines are used in place,
+       so they don't need buffers. */
+    if (this->read_mode == INPUT_READ_MMAP)
+    {
+        for (ib = 0; ib < this->nband; ib++)
+            this->buf[ib] = NULL;
+    }
     else
     {
-        this->buf[0] = buf;
-        for (ib = 1; ib < this->nband; ib++)
-            this->buf[ib] = this->buf[ib - 1] + this->size.s;
+        buf = calloc ((size_t) (this->size.s * this->nband), sizeof (int16));
+        if (buf == NULL)
+            error_string = "allocating input buffer";
+        else
+        {
+            this->buf[0] = buf;
+            for (ib = 1; ib < this->nband; ib++)
+                this->buf[ib] = this->buf[ib - 1] + this->size.s;
+        }
     }
 
     this->therm_buf = calloc ((size_t) (this->size.s), sizeof (int16));
@@ -245,12 +589,61 @@ Input_t *OpenInput
     }
     fclose (dsun_in);
 
-    /* Calculate maximum TOA reflectance values and put them in metadata */
+    /* Calculate maximum TOA reflectance values and put them in metadata.
+       The saturated values are set to the maximum values as the bands are
+       read, see set_saturated_values and GetInputThermLine, so they are
+       calculated first. */
     dn_to_toa_saturation (this);
 
     /* Calculate maximum BT values and put them in metadata */
     dn_to_bt_saturation (this);
 
+    /* Read each band into memory once, so the passes over the scene don't
+       have to go back to the files */
+    if (this->read_mode == INPUT_READ_SCENE)
+    {
+        for (ib = 0; ib < this->nband; ib++)
+        {
+            this->scene_buf[ib] = read_scene_band (this->fp_bin[ib],
+                                                   this->size);
+            if (this->scene_buf[ib] == NULL)
+                RETURN_ERROR ("reading input TOA band into memory",
+                              "OpenInput", NULL);
+        }
+
+    }
+    else if (this->read_mode == INPUT_READ_MMAP)
+    {
+        for (ib = 0; ib < this->nband; ib++)
+        {
+            this->scene_buf[ib] = map_scene_band (this->fp_bin[ib],
+                                                  this->size);
+            if (this->scene_buf[ib] == NULL)
+                RETURN_ERROR ("mapping input TOA band", "OpenInput", NULL);
+        }
+    }
+    if (this->read_mode != INPUT_READ_LINE)
+    {
+        for (ib = 0; ib < this->nband; ib++)
+            set_saturated_values (this->scene_buf[ib],
+                                  (size_t) this->size.l * this->size.s,
+                                  this->meta.satu_value_ref[ib],
+                                  this->meta.satu_value_max[ib],
+                                  this->read_mode == INPUT_READ_MMAP);
+    }
+
+    /* The thermal band is read and converted to Celsius once for every
+       read_mode, since every pass uses the converted values */
+    this->therm_scene_buf = read_scene_band (this->fp_bin_therm, this->size);
+    if (this->therm_scene_buf == NULL)
+        RETURN_ERROR ("reading input thermal band into memory", "OpenInput",
+                      NULL);
+    therm_to_celsius (this);
+
+    /* Find the fill pixels once for every pass */
+    if (build_fill_plane (this) != SUCCESS)
+        RETURN_ERROR ("finding the fill pixels", "OpenInput", NULL);
+
     return this;
 }
 
@@ -305,6 +698,37 @@ CloseInput (Input_t *this)
 }
 
 
+/******************************************************************************
+MODULE:  free_scene_band
+
+PURPOSE: Release the memory for a TOA reflectance band read by
+         read_scene_band or mapped by map_scene_band
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static void free_scene_band
+(
+    Input_t *this,     /* I: 'input' data structure */
+    int16 *scene_buf   /* I: band data to be released, may be NULL */
+)
+{
+    if (scene_buf == NULL)
+        return;
+
+    if (this->read_mode == INPUT_READ_MMAP)
+        munmap (scene_buf, (size_t) this->size.l * this->size.s
+                           * sizeof (int16));
+    else
+        free (scene_buf);
+}
+
 /******************************************************************************
 !Description: 'FreeInput' frees the 'input' data structure memory.
 !Input Parameters:
@@ -332,7 +756,13 @@ FreeInput (Input_t *this)
                 RETURN_ERROR ("file still open", "FreeInput", false);
             free (this->file_name[ib]);
             this->file_name[ib] = NULL;
+            free_scene_band (this, this->scene_buf[ib]);
+            this->scene_buf[ib] = NULL;
         }
+        free (this->therm_scene_buf);
+        this->therm_scene_buf = NULL;
+        free_bitplane (this->fill_plane);
+        this->fill_plane = NULL;
         free (this->file_name_therm);
         this->file_name_therm = NULL;
 
@@ -355,7 +785,10 @@ FreeInput (Input_t *this)
 
 !Output Parameters:
  this           'input' data structure; the following fields are modified:
-                   buf -- contains the line read
+                   buf -- contains the line read, with the saturated
+                          values set to the maximum values; for
+                          INPUT_READ_MMAP it points at the line in the
+                          mapped band
  (returns)      status:
                   'true' = okay
                   'false' = error return
@@ -380,6 +813,23 @@ GetInputLine (Input_t *this, int iband, int iline)
     if (iline < 0 || iline >= this->size.l)
         RETURN_ERROR ("invalid line number", "GetInputLine", false);
 
+    /* Point at the line in place if the band is mapped */
+    if (this->read_mode == INPUT_READ_MMAP)
+    {
+        this->buf[iband] = &this->scene_buf[iband][(size_t) iline
+                                                   * this->size.s];
+        return true;
+    }
+
+    /* Copy the line from memory if the band has already been read */
+    if (this->scene_buf[iband] != NULL)
+    {
+        memcpy (this->buf[iband],
+                &this->scene_buf[iband][(size_t) iline * this->size.s],
+                this->size.s * sizeof (int16));
+        return true;
+    }
+
     /* Read the data */
     buf = (void *) this->buf[iband];
     loc = (long) (iline * this->size.s * sizeof (int16));
@@ -389,6 +839,9 @@ GetInputLine (Input_t *this, int iband, int iline)
         (this->fp_bin[iband], 1, this->size.s, sizeof (int16),
          buf) != SUCCESS)
         RETURN_ERROR ("error reading line (binary)", "GetInputLine", false);
+    set_saturated_values (this->buf[iband], this->size.s,
+                          this->meta.satu_value_ref[iband],
+                          this->meta.satu_value_max[iband], false);
 
     return true;
 }
@@ -403,7 +856,9 @@ current line
 
 !Output Parameters:
  this           'input' data structure; the following fields are modified:
-                   therm_buf -- contains the line read
+                   therm_buf -- contains the line read (degrees Celsius
+                                * 100), with the saturated values set
+                                to the maximum temperature
  (returns)      status:
                   'true' = okay
                   'false' = error return
@@ -415,12 +870,6 @@ current line
 bool
 GetInputThermLine (Input_t *this, int iline)
 {
-    void *buf = NULL;
-    int i;            /* looping variable */
-    long loc;         /* pointer location in the raw binary file */
-    float therm_val;  /* tempoary thermal value for conversion from Kelvin to
-                         Celsius */
-
     /* Check the parameters */
     if (this == (Input_t *) NULL)
         RETURN_ERROR ("invalid input structure", "GetIntputThermLine", false);
@@ -429,35 +878,14 @@ GetInputThermLine (Input_t *this, int iline)
     if (iline < 0 || iline >= this->size.l)
         RETURN_ERROR ("invalid line number", "GetInputThermLine", false);
 
-    /* Read the data */
-    buf = (void *) this->therm_buf;
-    loc = (long) (iline * this->size.s * sizeof (int16));
-    if (fseek (this->fp_bin_therm, loc, SEEK_SET))
-        RETURN_ERROR ("error seeking thermal line (binary)",
-                      "GetInputThermLine", false);
-    if (read_raw_binary
-        (this->fp_bin_therm, 1, this->size.s, sizeof (int16), buf) != SUCCESS)
-        RETURN_ERROR ("error reading thermal line (binary)",
-                      "GetInputThermLine", false);
-
-    /* Convert from Kelvin back to degrees Celsius since the application is
-       based on the unscaled Celsius values originally produced.  If this is
-       fill or saturated, then leave as fill or saturated. */
-    for (i = 0; i < this->size.s; i++)
-    {
-        if (this->therm_buf[i] != this->meta.fill &&
-            this->therm_buf[i] != this->meta.therm_satu_value_ref)
-        {
-            /* unscale and convert to celsius */
-            therm_val = this->therm_buf[i] * this->meta.therm_scale_fact;
-            therm_val -= 273.15;
-
-            /* apply the old scale factor that the cfmask processing is based
-               upon, to get the original unscaled Celsius values */
-            therm_val *= 100.0;
-            this->therm_buf[i] = (int) (therm_val + 0.5);
-        }
-    }
+    /* Copy the line from the thermal band, which was converted to degrees
+       Celsius when the input was opened */
+    memcpy (this->therm_buf,
+            &this->therm_scene_buf[(size_t) iline * this->size.s],
+            this->size.s * sizeof (int16));
+    set_saturated_values (this->therm_buf, this->size.s,
+                          this->meta.therm_satu_value_ref,
+                          this->meta.therm_satu_value_max, false);
 
     return true;
 }
@@ -4,6 +4,36 @@
 #include "const.h"
 #include "date.h"
 #include "cfmask.h"
+#include "bitplane.h"
+
+/* Methods for reading the input bands */
+typedef enum
+{
+    INPUT_READ_LINE = 0,  /* seek and read each line as it is requested */
+    INPUT_READ_SCENE,     /* read each band into memory once when opened */
+    INPUT_READ_MMAP       /* map each band file into memory when opened */
+} Input_read_mode_t;
+
+/* Methods for searching the cloud base heights in the cloud/shadow match */
+typedef enum
+{
+    HEIGHT_SEARCH_FULL = 0,  /* score every pixel at every height step */
+    HEIGHT_SEARCH_COARSE,    /* score a sample of the pixels at coarse steps
+                                of large objects, then every pixel around
+                                the best coarse height */
+    HEIGHT_SEARCH_COMPARE    /* the coarse search, also doing the full
+                                search to report how closely they agree */
+} Height_search_t;
+
+/* How pcloud keeps the cloud probabilities of the pixels between the pass
+   calculating them and the pass comparing them to the thresholds */
+typedef enum
+{
+    PROB_STORAGE_FLOAT = 0,  /* a float for each pixel */
+    PROB_STORAGE_QUANTIZED,  /* a 16 bit value for each pixel, calculating
+                                the few too close to a threshold again */
+    PROB_STORAGE_RECOMPUTE   /* none, calculating them again from the bands */
+} Prob_storage_t;
 
 /* Structure for the metadata */
 typedef struct
@@ -39,17 +69,31 @@ typedef struct
     bool open[BI_REFL_BAND_COUNT];  /* Indicates whether the specific input
                                        TOA reflectance file is open for access;
                                        'true' = open, 'false' = not open */
-    int16 *buf[BI_REFL_BAND_COUNT]; /* Input data buffer (one line of data) */
+    int16 *buf[BI_REFL_BAND_COUNT]; /* Input data buffer (one line of data);
+                                       points into scene_buf for
+                                       INPUT_READ_MMAP */
     FILE *fp_bin_therm;         /* File pointer for thermal binary file */
     bool open_therm;            /* Flag to indicate whether the input thermal
                                    file is open for access */
     int16 *therm_buf;           /* Input data buffer (one line of data) */
+    Input_read_mode_t read_mode; /* Method used to read the input bands */
+    int16 *scene_buf[BI_REFL_BAND_COUNT]; /* Whole band TOA reflectance data
+                                       for INPUT_READ_SCENE (allocated) and
+                                       INPUT_READ_MMAP (mapped), otherwise
+                                       NULL */
+    int16 *therm_scene_buf;     /* Whole band thermal data, converted to
+                                   degrees Celsius * 100 when the input is
+                                   opened; shared by all processing steps */
+    Bitplane_t *fill_plane;     /* Pixels which are fill in any band, found
+                                   when the input is opened; shared by all
+                                   processing steps */
     float dsun_doy[366];        /* Array of earth/sun distances for each DOY;
                                    read from the EarthSunDistance.txt file */
 } Input_t;
 
 /* Prototypes */
-Input_t *OpenInput (Espa_internal_meta_t * metadata);
+Input_t *OpenInput (Espa_internal_meta_t * metadata,
+                    Input_read_mode_t read_mode);
 bool GetInputLine (Input_t * this, int iband, int iline);
 bool GetInputThermLine (Input_t * this, int iline);
 bool CloseInput (Input_t * this);
@@ -65,6 +109,8 @@ int potential_cloud_shadow_snow_mask
     float *t_temph,             /*O: percentile of high background temp */
     unsigned char **pixel_mask, /*I/O: pixel mask */
     unsigned char **conf_mask,  /*I/O: confidence mask */
+    int num_threads,            /*I: maximum number of threads to use */
+    Prob_storage_t prob_storage, /*I: how the cloud probabilities are kept */
     bool verbose                /*I: value to indicate if intermediate
                                      messages be printed */
 );
@@ -78,7 +124,14 @@ int object_cloud_shadow_match
     int cldpix,      /*I: cloud buffer size */
     int sdpix,       /*I: shadow buffer size */
     int max_cloud_pixels, /* I: Max cloud pixel number to divide cloud */
+    int num_threads, /*I: maximum number of threads to use */
+    Height_search_t height_search, /*I: cloud base height search method */
+    int perimeter_pixels, /*I: min pixels of the objects scored on their
+                               perimeter, 0 for none */
     unsigned char **pixel_mask, /*I/O:pixel mask */
+    bool bitplane_masks, /*I: use packed bit planes for the matching masks */
+    bool compat_dilate,  /*I: keep the original border handling of the
+                              cloud and shadow dilation */
     bool verbose     /*I: value to indicate if intermediate messages be
                           printed */
 );
@@ -111,6 +164,16 @@ int prctile2
     float *result /*O: percentile calculated */
 );
 
+void select_prctile
+(
+    int16 *array, /*I/O: input data pointer; the values are reordered */
+    int nums,     /*I: number of input data array */
+    int16 min,    /*I: minimum value in the input data array */
+    int16 max,    /*I: maximum value in the input data array  */
+    float prct,   /*I: percentage threshold */
+    float *result /*O: percentile calculated */
+);
+
 int get_args
 (
     int argc,          /* I: number of cmd-line args */
@@ -120,6 +183,15 @@ int get_args
     int *cldpix,       /* O: cloud_pixel buffer used for image dilate */
     int *sdpix,        /* O: shadow_pixel buffer used for image dilate  */
     int *max_cloud_pixels, /* O: Max cloud pixel number to divide cloud */
+    int *num_threads,  /* O: maximum number of threads to use */
+    Input_read_mode_t *read_mode, /* O: method for reading the input bands */
+    Height_search_t *height_search, /* O: cloud base height search method */
+    int *perimeter_pixels, /* O: min pixels of the objects scored on their
+                                 perimeter, 0 for none */
+    Prob_storage_t *prob_storage, /* O: how the cloud probabilities are
+                                        kept */
+    bool *bitplane_masks, /* O: use packed bit planes for the masks */
+    bool *compat_dilate,  /* O: keep the original dilation border handling */
     bool * verbose     /* O: verbose flag */
 );
 
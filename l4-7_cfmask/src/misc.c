@@ -5,9 +5,11 @@
 #include <string.h>
 #include <math.h>
 
+#include "espa_geoloc.h"
 #include "const.h"
 #include "error.h"
 #include "cfmask.h"
+#include "input.h"
 
 /******************************************************************************
 MODULE:  prctile
@@ -165,6 +167,237 @@ int prctile2
     return SUCCESS;
 }
 
+/* Ranges of at most SELECT_INSERTION_SIZE values are sorted instead of
+   partitioned */
+#define SELECT_INSERTION_SIZE 16
+
+/******************************************************************************
+MODULE:  sift_down16
+
+PURPOSE: Move a value of an int16 max heap down until it is no smaller than
+         its children
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static void sift_down16
+(
+    int16 *heap,  /*I/O: heap values */
+    int size,     /*I: number of values in the heap */
+    int parent    /*I: position of the value to move down */
+)
+{
+    int16 value = heap[parent]; /* value moved down */
+    int child;                  /* larger child of parent */
+
+    child = 2 * parent + 1;
+    while (child < size)
+    {
+        if (child + 1 < size && heap[child + 1] > heap[child])
+            child++;
+        if (heap[child] <= value)
+            break;
+        heap[parent] = heap[child];
+        parent = child;
+        child = 2 * parent + 1;
+    }
+    heap[parent] = value;
+}
+
+/******************************************************************************
+MODULE:  select16
+
+PURPOSE: Put the k-th smallest value of an int16 array in place, by
+         introselect
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. After the call array[k] is the value a sort would put there; the other
+   values are reordered.
+2. The ranges are partitioned three ways around the median of three values,
+   so runs of equal temperatures are done with at once.  If the partitions
+   keep being uneven the remaining range is done with a heap, so the worst
+   case is O(n log n) instead of O(n * n).
+******************************************************************************/
+static void select16
+(
+    int16 *array, /*I/O: values, reordered */
+    int nums,     /*I: number of values */
+    int k         /*I: index to put in place, 0 <= k < nums */
+)
+{
+    int lo = 0;                 /* first index of the range holding k */
+    int hi = nums - 1;          /* last index of the range holding k */
+    int depth = 0;              /* partitions left before using a heap */
+    int lt, gt;                 /* ends of the values equal to the pivot */
+    int i, j;                   /* loop indexes */
+    int16 a, b, c;              /* values the pivot is the median of */
+    int16 pivot;                /* partition value */
+    int16 value;                /* value moved */
+
+    for (i = nums; i > 1; i >>= 1)
+        depth += 2;
+
+    while (hi - lo + 1 > SELECT_INSERTION_SIZE)
+    {
+        if (depth-- == 0)
+        {
+            /* Put the k - lo + 1 smallest values in a max heap, whose top
+               is then the k-th smallest */
+            for (i = (k - lo + 1) / 2 - 1; i >= 0; i--)
+                sift_down16 (array + lo, k - lo + 1, i);
+            for (i = k + 1; i <= hi; i++)
+            {
+                if (array[i] < array[lo])
+                {
+                    value = array[i];
+                    array[i] = array[lo];
+                    array[lo] = value;
+                    sift_down16 (array + lo, k - lo + 1, 0);
+                }
+            }
+            value = array[lo];
+            array[lo] = array[k];
+            array[k] = value;
+            return;
+        }
+
+        a = array[lo];
+        b = array[lo + (hi - lo) / 2];
+        c = array[hi];
+        if (a > b)
+        {
+            value = a;
+            a = b;
+            b = value;
+        }
+        if (b > c)
+            b = (a > c) ? a : c;
+        pivot = b;
+
+        /* Partition into values less than, equal to and greater than the
+           pivot */
+        lt = lo;
+        gt = hi;
+        i = lo;
+        while (i <= gt)
+        {
+            if (array[i] < pivot)
+            {
+                value = array[i];
+                array[i++] = array[lt];
+                array[lt++] = value;
+            }
+            else if (array[i] > pivot)
+            {
+                value = array[i];
+                array[i] = array[gt];
+                array[gt--] = value;
+            }
+            else
+                i++;
+        }
+
+        if (k < lt)
+            hi = lt - 1;
+        else if (k > gt)
+            lo = gt + 1;
+        else
+            return;
+    }
+
+    /* Sort the small range left */
+    for (i = lo + 1; i <= hi; i++)
+    {
+        value = array[i];
+        for (j = i; j > lo && array[j - 1] > value; j--)
+            array[j] = array[j - 1];
+        array[j] = value;
+    }
+}
+
+/******************************************************************************
+MODULE:  select_prctile
+
+PURPOSE: Calculate a percentile of an integer array by selection, without
+         allocating memory
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. prctile returns the smallest value whose count of values no larger than
+   it passes the percentage test.  That is the value of the smallest rank
+   passing the test, so this finds that rank with the same float
+   arithmetic and selects its value; for the same values, min and max the
+   result is the same as prctile gives.
+2. The array is reordered; pass a copy to keep the order.
+******************************************************************************/
+void select_prctile
+(
+    int16 *array, /*I/O: input data pointer; the values are reordered */
+    int nums,     /*I: number of input data array */
+    int16 min,    /*I: minimum value in the input data array */
+    int16 max,    /*I: maximum value in the input data array  */
+    float prct,   /*I: percentage threshold */
+    float *result /*O: percentile calculated */
+)
+{
+    float inv_nums_100;       /* inverse of the nums value * 100 */
+    int rank;                 /* count of the values up to the result */
+
+    /* Just return 0 if no input value */
+    if (nums == 0)
+    {
+        *result = 0.0;
+        return;
+    }
+
+    /* prctile gives max if no count passes and min if a zero count does */
+    inv_nums_100 = (1.0/((float) nums)) * 100.0;
+    if (!(((float) nums * inv_nums_100) >= prct))
+    {
+        *result = max;
+        return;
+    }
+    if (((float) 0 * inv_nums_100) >= prct)
+    {
+        *result = min;
+        return;
+    }
+
+    /* Start from the rank the percentage gives and move to the smallest
+       rank passing the test; the test only passes for larger ranks */
+    rank = (int) ceil (prct * nums / 100.0);
+    if (rank < 1)
+        rank = 1;
+    if (rank > nums)
+        rank = nums;
+    while (!(((float) rank * inv_nums_100) >= prct))
+        rank++;
+    while (rank > 1 && ((float) (rank - 1) * inv_nums_100) >= prct)
+        rank--;
+
+    select16 (array, nums, rank - 1);
+    *result = (float) array[rank - 1];
+}
+
 /******************************************************************************
 MODULE:  get_args
 
@@ -202,26 +435,48 @@ int get_args
     int *cldpix,           /* O: cloud_pixel buffer used for image dilate */
     int *sdpix,            /* O: shadow_pixel buffer used for image dilate */
     int *max_cloud_pixels, /* O: Max cloud pixel number to divide cloud */
+    int *num_threads,      /* O: maximum number of threads to use */
+    Input_read_mode_t *read_mode, /* O: method for reading the input bands */
+    Height_search_t *height_search, /* O: cloud base height search method */
+    int *perimeter_pixels, /* O: min pixels of the objects scored on their
+                                 perimeter, 0 for none */
+    Prob_storage_t *prob_storage, /* O: how the cloud probabilities are
+                                        kept */
+    bool *bitplane_masks,  /* O: use packed bit planes for the masks */
+    bool *compat_dilate,   /* O: keep the original dilation border handling */
     bool * verbose         /* O: verbose flag */
 )
 {
     int c;                         /* current argument index */
     int option_index;              /* index for the command-line option */
     static int verbose_flag = 0;   /* verbose flag */
+    static int bitplane_flag = 0;  /* packed bit plane masks flag */
+    static int full_border_flag = 0; /* dilate the border pixels too */
     static int cldpix_default = 3; /* Default buffer for cloud pixel dilate */
     static int sdpix_default = 3;  /* Default buffer for shadow pixel dilate */
     static int max_pixel_default = 0; /* Default maxium cloud pixel number for
                                          cloud division, 0 means no division */
+    static int num_threads_default = 1; /* Default maximum number of threads */
+    static int perimeter_pixels_default = 0; /* Default minimum object size
+                                                scored on the perimeter, 0
+                                                means none */
     static float cloud_prob_default = 22.5; /* Default cloud probability */
     char errmsg[MAX_STR_LEN];               /* error message */
     char FUNC_NAME[] = "get_args";          /* function name */
     static struct option long_options[] = {
         {"verbose", no_argument, &verbose_flag, 1},
+        {"bitplane_masks", no_argument, &bitplane_flag, 1},
+        {"full_border_dilate", no_argument, &full_border_flag, 1},
         {"xml", required_argument, 0, 'i'},
         {"prob", required_argument, 0, 'p'},
         {"cldpix", required_argument, 0, 'c'},
         {"sdpix", required_argument, 0, 's'},
         {"max_cloud_pixels", required_argument, 0, 'x'},
+        {"threads", required_argument, 0, 't'},
+        {"input_mode", required_argument, 0, 'm'},
+        {"height_search", required_argument, 0, 'e'},
+        {"perimeter_pixels", required_argument, 0, 'r'},
+        {"prob_storage", required_argument, 0, 'b'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -231,6 +486,11 @@ int get_args
     *cldpix = cldpix_default;
     *sdpix = sdpix_default;
     *max_cloud_pixels = max_pixel_default;
+    *num_threads = num_threads_default;
+    *read_mode = INPUT_READ_LINE;
+    *height_search = HEIGHT_SEARCH_FULL;
+    *perimeter_pixels = perimeter_pixels_default;
+    *prob_storage = PROB_STORAGE_FLOAT;
 
     /* Loop through all the cmd-line options */
     opterr = 0; /* turn off getopt_long error msgs as we'll print our own */
@@ -278,6 +538,60 @@ int get_args
             *max_cloud_pixels = atoi (optarg);
             break;
 
+        case 't':              /* maximum number of threads */
+            *num_threads = atoi (optarg);
+            break;
+
+        case 'm':              /* method for reading the input bands */
+            if (strcmp (optarg, "line") == 0)
+                *read_mode = INPUT_READ_LINE;
+            else if (strcmp (optarg, "scene") == 0)
+                *read_mode = INPUT_READ_SCENE;
+            else if (strcmp (optarg, "mmap") == 0)
+                *read_mode = INPUT_READ_MMAP;
+            else
+            {
+                sprintf (errmsg, "Unknown input_mode %s", optarg);
+                usage ();
+                RETURN_ERROR (errmsg, FUNC_NAME, FAILURE);
+            }
+            break;
+
+        case 'e':              /* cloud base height search method */
+            if (strcmp (optarg, "full") == 0)
+                *height_search = HEIGHT_SEARCH_FULL;
+            else if (strcmp (optarg, "coarse") == 0)
+                *height_search = HEIGHT_SEARCH_COARSE;
+            else if (strcmp (optarg, "compare") == 0)
+                *height_search = HEIGHT_SEARCH_COMPARE;
+            else
+            {
+                sprintf (errmsg, "Unknown height_search %s", optarg);
+                usage ();
+                RETURN_ERROR (errmsg, FUNC_NAME, FAILURE);
+            }
+            break;
+
+        case 'r':              /* minimum object size scored on the
+                                   perimeter, 0 means none */
+            *perimeter_pixels = atoi (optarg);
+            break;
+
+        case 'b':              /* how the cloud probabilities are kept */
+            if (strcmp (optarg, "float") == 0)
+                *prob_storage = PROB_STORAGE_FLOAT;
+            else if (strcmp (optarg, "quantized") == 0)
+                *prob_storage = PROB_STORAGE_QUANTIZED;
+            else if (strcmp (optarg, "recompute") == 0)
+                *prob_storage = PROB_STORAGE_RECOMPUTE;
+            else
+            {
+                sprintf (errmsg, "Unknown prob_storage %s", optarg);
+                usage ();
+                RETURN_ERROR (errmsg, FUNC_NAME, FAILURE);
+            }
+            break;
+
         case '?':
         default:
             sprintf (errmsg, "Unknown option %s", argv[optind - 1]);
@@ -302,6 +616,33 @@ int get_args
         RETURN_ERROR (errmsg, FUNC_NAME, FAILURE);
     }
 
+    /* Make sure this is some positive value */
+    if (*perimeter_pixels < 0)
+    {
+        sprintf (errmsg, "perimeter_pixels must be >= 0");
+        RETURN_ERROR (errmsg, FUNC_NAME, FAILURE);
+    }
+
+    /* Make sure at least one thread is used */
+    if (*num_threads < 1)
+    {
+        sprintf (errmsg, "threads must be >= 1");
+        RETURN_ERROR (errmsg, FUNC_NAME, FAILURE);
+    }
+
+    /* Check the bit plane masks flag */
+    if (bitplane_flag)
+        *bitplane_masks = true;
+    else
+        *bitplane_masks = false;
+
+    /* The original dilation border handling is kept unless the border
+       pixels are to be dilated too */
+    if (full_border_flag)
+        *compat_dilate = false;
+    else
+        *compat_dilate = true;
+
     /* Check the verbose flag */
     if (verbose_flag)
         *verbose = true;
@@ -315,6 +656,29 @@ int get_args
         printf ("cloud_pixel_buffer = %d\n", *cldpix);
         printf ("shadow_pixel_buffer = %d\n", *sdpix);
         printf ("max_cloud_pixels = %d\n", *max_cloud_pixels);
+        printf ("threads = %d\n", *num_threads);
+        if (*read_mode == INPUT_READ_SCENE)
+            printf ("input_mode = scene\n");
+        else if (*read_mode == INPUT_READ_MMAP)
+            printf ("input_mode = mmap\n");
+        else
+            printf ("input_mode = line\n");
+        if (*height_search == HEIGHT_SEARCH_COARSE)
+            printf ("height_search = coarse\n");
+        else if (*height_search == HEIGHT_SEARCH_COMPARE)
+            printf ("height_search = compare\n");
+        else
+            printf ("height_search = full\n");
+        printf ("perimeter_pixels = %d\n", *perimeter_pixels);
+        if (*prob_storage == PROB_STORAGE_QUANTIZED)
+            printf ("prob_storage = quantized\n");
+        else if (*prob_storage == PROB_STORAGE_RECOMPUTE)
+            printf ("prob_storage = recompute\n");
+        else
+            printf ("prob_storage = float\n");
+        printf ("bitplane_masks = %s\n", *bitplane_masks ? "true" : "false");
+        printf ("full_border_dilate = %s\n",
+                *compat_dilate ? "false" : "true");
     }
 
     return SUCCESS;
@@ -1,7 +1,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <math.h>
 #include <time.h>
 
@@ -11,20 +13,148 @@
 #include "error.h"
 #include "2d_array.h"
 #include "input.h"
+#include "bitplane.h"
+#include "dilate.h"
+#include "cloud_label.h"
+#include "shadow_project.h"
+#include "scratch_arena.h"
 
-#define MAX_CLOUD_TYPE 3000000
 #define MIN_CLOUD_OBJ 9
 
-static int num_clouds = 0;
+/* The coarse height search is used for objects of at least
+   COARSE_MIN_PIXELS pixels; it scores about COARSE_SAMPLE_PIXELS of their
+   pixels every COARSE_STEP_FACTOR height steps */
+#define COARSE_MIN_PIXELS 4096
+#define COARSE_SAMPLE_PIXELS 1024
+#define COARSE_STEP_FACTOR 4
+
+/* Objects scored on their perimeter keep the interior pixels on a grid
+   at least PERIMETER_INTERIOR_SPACING pixels apart, wider if that keeps
+   more than PERIMETER_INTERIOR_RATIO interior pixels per perimeter pixel */
+#define PERIMETER_INTERIOR_SPACING 4
+#define PERIMETER_INTERIOR_RATIO 4
+
+/* Scene values shared by the shadow height searches of all the cloud
+   objects; none of them change during the searches */
+typedef struct
+{
+    Input_t *input;             /* input structure */
+    int nrows;                  /* number of rows */
+    int ncols;                  /* number of columns */
+    unsigned char **pixel_mask; /* pixel mask */
+    int16 *temp;                /* brightness temperature (whole scene) */
+    Cloud_objects_t *objects;   /* labeled cloud objects */
+    float t_templ;              /* percentile of low background temp */
+    float t_temph;              /* percentile of high background temp */
+    int boundary_counter;       /* boundary pixel counter */
+    int i_step;                 /* iteration step */
+    Shadow_geometry_t geometry; /* view and solar geometry */
+    Height_search_t height_search; /* cloud base height search method */
+    int perimeter_pixels;       /* objects of at least this many pixels are
+                                   scored on their perimeter, 0 for none */
+    int num_clouds;             /* number of cloud objects labeled; larger
+                                   object numbers are pieces of divided
+                                   clouds */
+    int max_cloud_pixels;       /* max cloud pixel number to divide cloud */
+} Shadow_match_t;
+
+/* Pixels of a cloud object scored by the height searches, either all of
+   them, a sample or its perimeter; the arrays hold npixels values.  Once
+   the shadow has been projected at one base height, score_height moves the
+   unrounded shadow positions to the next base height instead of projecting
+   again, and keeps the match counts up to date from the pixels whose
+   shadow moved to another pixel. */
+typedef struct
+{
+    int cloud_type;             /* cloud object number */
+    int npixels;                /* number of pixels */
+    int **orin_xys;             /* column and row of each pixel */
+    int16 *temp_obj;            /* temperature of each pixel */
+    float t_obj;                /* cloud base temperature */
+    double *h_offset;           /* cloud height of each pixel less the base
+                                   height */
+    float *h;                   /* cloud height of each pixel */
+    float **tmp_xys;            /* view angle corrected column and row */
+    int **xy_type;              /* projected shadow row and column */
+    double **move_xy;           /* change of the unrounded shadow column and
+                                   row per meter of height */
+    double **shadow_xy;         /* unrounded shadow column and row */
+    unsigned char *counted;     /* MATCH_COUNTED and TOTAL_COUNTED bits of
+                                   the shadow of each pixel */
+    int *weight;                /* object pixels each pixel is counted for,
+                                   or NULL when each counts once */
+    bool moving;                /* are shadow_xy and the counts set? */
+    int moving_base_h;          /* base height of shadow_xy (m) */
+    int match_all;              /* shadows counted as matched */
+    int total_all;              /* shadows counted in the total */
+    long projections;           /* pixels projected so far */
+} Object_pixels_t;
+
+/* Bits of Object_pixels_t counted */
+#define MATCH_COUNTED 1
+#define TOTAL_COUNTED 2
+
+/* How closely the coarse or perimeter height search agreed with the full
+   search */
+typedef struct
+{
+    int objects;                /* objects searched both ways */
+    int same_height;            /* objects given the same base height, or
+                                   no shadow by both searches */
+    int near_height;            /* objects given base heights less than
+                                   COARSE_STEP_FACTOR steps apart, or no
+                                   shadow by both searches */
+    int shadow_differs;         /* objects only one search found a shadow
+                                   for */
+    long pixels;                /* pixels of the objects both searches
+                                   found a shadow for */
+    long same_pixels;           /* of those, pixels whose shadow is in the
+                                   same place */
+    long coarse_projections;    /* pixels projected by the coarse or
+                                   perimeter search */
+    long full_projections;      /* pixels projected by the full search */
+} Height_search_stats_t;
+
+/* Work shared by the threads doing the shadow height searches */
+typedef struct
+{
+    const Shadow_match_t *match; /* I: scene values */
+    const int *order;       /* I: cloud object numbers, largest first */
+    int num_objects;        /* I: number of objects in order */
+    int *next_object;       /* I/O: index in order of the next object to
+                               search, shared by all the threads */
+    Bitplane_t *shadow_plane;   /* I/O: shadow pixels found, or NULL */
+    unsigned char **shadow_mask; /* I/O: mask whose SHADOW_BIT is set for
+                                    the shadow pixels found, when
+                                    shadow_plane is NULL */
+    Height_search_stats_t stats; /* O: agreement of the coarse and full
+                                    searches, for HEIGHT_SEARCH_COMPARE */
+    Scratch_arena_t arena;  /* I/O: arrays of the object being searched;
+                               the counts are kept after the blocks are
+                               freed */
+    int status;             /* O: return value */
+} Shadow_worker_t;
+
+/* Raster position and index of an object pixel, for ordering the pixels of
+   an object by position */
+typedef struct
+{
+    int pixel;              /* pixel index (row * ncols + col) */
+    int index;              /* index of the pixel in the object */
+} Pixel_position_t;
 
-typedef struct cloud_node_t
+/* Cloud object size and number, for ordering the height searches */
+typedef struct
 {
-    int value;
-    int16 row;
-    int16 col;
-    struct cloud_node_t *parent;
-    struct cloud_node_t *child;
-} cloud_node;
+    unsigned int size;      /* pixels in the object */
+    int number;             /* object number */
+} Object_size_t;
+
+/* Index of the next object for a height search thread; without an atomic
+   add the searches are done in one thread */
+#if defined(__GNUC__)
+#define NEXT_OBJECT(ptr) __sync_fetch_and_add ((ptr), 1)
+#endif
 
 /******************************************************************************
 MODULE:  viewgeo
@@ -92,535 +222,1105 @@ void viewgeo
 
 
 /******************************************************************************
-MODULE:  mat_truecloud
+MODULE:  allocate_object_pixels
 
-PURPOSE:  Calculate shadow pixel locations of a true cloud segment
+PURPOSE: Allocate the arrays of the pixels of a cloud object for the height
+         searches
 
-RETURN: None
+RETURN: SUCCESS
+        FAILURE
 
 HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
-3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Original Development
+10/17/2026  USGS EROS        Take the arrays from a scratch arena
 
 NOTES:
+1. The arrays are released by the next reset of the arena.
 ******************************************************************************/
-void mat_truecloud
+static int allocate_object_pixels
 (
-    int *x,           /*I: input pixel cloumn */
-    int *y,           /*I: input pixel row */
-    int array_length, /*I: number of input array */
-    float *h,         /*I: cloud pixel height */
-    float a,          /*I: coefficient */
-    float b,          /*I: coefficient */
-    float c,          /*I: coefficient */
-    float inv_a_b_distance, /*I: precalculated */
-    float inv_cos_omiga_per_minus_par,  /*I: precalculated */
-    float cos_omiga_par,  /*I: precalculated */
-    float sin_omiga_par,  /*I: precalculated */
-    float *x_new,     /*O: output pixel cloumn */
-    float *y_new      /*O: output pixel row */
+    Scratch_arena_t *arena, /* I/O: arena the arrays are taken from */
+    int cloud_type,         /* I: cloud object number */
+    int npixels,            /* I: number of pixels */
+    Object_pixels_t *obj    /* O: object pixels */
 )
 {
-    float dist;                 /* distance */
-    float dist_par;             /* distance in parallel direction */
-    float dist_move;            /* distance moved */
-    float delt_x;               /* change in column */
-    float delt_y;               /* change in row */
+    char errstr[MAX_STR_LEN];   /* error string */
 
-    float height = 705000.0;    /* average Landsat 4,5,&7 height (m) */
+    obj->cloud_type = cloud_type;
+    obj->npixels = npixels;
+    obj->moving = false;
+    obj->projections = 0;
+    obj->weight = NULL;
+
+    obj->orin_xys = (int **) scratch_alloc_2d (arena, 2, npixels,
+                                               sizeof (int));
+    obj->tmp_xys = (float **) scratch_alloc_2d (arena, 2, npixels,
+                                                sizeof (float));
+    obj->xy_type = (int **) scratch_alloc_2d (arena, 2, npixels,
+                                              sizeof (int));
+    obj->move_xy = (double **) scratch_alloc_2d (arena, 2, npixels,
+                                                 sizeof (double));
+    obj->shadow_xy = (double **) scratch_alloc_2d (arena, 2, npixels,
+                                                   sizeof (double));
+    obj->temp_obj = scratch_alloc (arena, npixels * sizeof (int16));
+    obj->h_offset = scratch_alloc (arena, npixels * sizeof (double));
+    obj->h = scratch_alloc (arena, npixels * sizeof (float));
+    obj->counted = scratch_alloc (arena, npixels * sizeof (unsigned char));
+    if (obj->orin_xys == NULL || obj->tmp_xys == NULL
+        || obj->xy_type == NULL || obj->move_xy == NULL
+        || obj->shadow_xy == NULL || obj->temp_obj == NULL
+        || obj->h_offset == NULL || obj->h == NULL || obj->counted == NULL)
+    {
+        sprintf (errstr, "Allocating cloud memory");
+        RETURN_ERROR (errstr, "allocate_object_pixels", FAILURE);
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  set_height_offsets
+
+PURPOSE: Calculate the cloud height of each pixel of an object above its
+         base height, from the pixel temperatures
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static void set_height_offsets
+(
+    Object_pixels_t *obj    /* I/O: object pixels; h_offset is set */
+)
+{
+    float inv_rate_elapse = 1.0/6.5; /* inverse wet air lapse rate */
     int i;
 
-    for (i = 0; i < array_length; i++)
+    for (i = 0; i < obj->npixels; i++)
     {
-        dist = (a * (float) x[i] + b * (float) y[i] + c) * inv_a_b_distance;
+        obj->h_offset[i] = (10.0 * (obj->t_obj - (float) obj->temp_obj[i]))
+                           * inv_rate_elapse;
+    }
+}
+
+/******************************************************************************
+MODULE:  object_heights
+
+PURPOSE: Calculate the cloud height of each pixel of an object for a cloud
+         base height
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Moved out of match_cloud_shadow
 
-        /* from the cetral perpendicular (unit: pixel) */
-        dist_par = dist * inv_cos_omiga_per_minus_par;
+NOTES:
+1. The offsets are kept in double precision, so the heights are rounded
+   once, as in the original code.
+******************************************************************************/
+static void object_heights
+(
+    Object_pixels_t *obj,   /* I/O: object pixels; h is set */
+    int base_h              /* I: cloud base height (m) */
+)
+{
+    int i;
 
-        /* cloud move distance (m) */
-        dist_move = (dist_par * h[i]) / height;
+    for (i = 0; i < obj->npixels; i++)
+        obj->h[i] = obj->h_offset[i] + (float) base_h;
+}
+
+/******************************************************************************
+MODULE:  count_shadow
 
-        delt_x = dist_move * cos_omiga_par;
-        delt_y = dist_move * sin_omiga_par;
+PURPOSE: Find whether the shadow of a cloud pixel counts as matched and in
+         the total of the similarity
 
-        x_new[i] = x[i] + delt_x;       /* new x, j */
-        y_new[i] = y[i] + delt_y;       /* new y, i */
+RETURN: MATCH_COUNTED and TOTAL_COUNTED bits
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Moved out of match_cloud_shadow
+
+NOTES:
+1. Shadows outside the image count in both.
+******************************************************************************/
+static unsigned char count_shadow
+(
+    const Shadow_match_t *match, /* I: scene values */
+    int cloud_type,              /* I: cloud object number */
+    int row,                     /* I: shadow row */
+    int col                      /* I: shadow column */
+)
+{
+    unsigned char **pixel_mask = match->pixel_mask; /* pixel mask */
+    int **cloud = match->objects->label; /* cloud object number of all
+                                            pixels */
+    unsigned char counted = 0;  /* bits counted */
+
+    /* the id that is out of the image */
+    if (row < 0 || row >= match->nrows || col < 0 || col >= match->ncols)
+        return MATCH_COUNTED | TOTAL_COUNTED;
+
+    if ((pixel_mask[row][col] & (1 << FILL_BIT))
+        || (cloud[row][col] != cloud_type
+            && (((pixel_mask[row][col] & (1 << CLOUD_BIT))
+                 || (pixel_mask[row][col] & (1 << FILL_BIT)))
+                || (pixel_mask[row][col] & (1 << SHADOW_BIT)))))
+    {
+        counted |= MATCH_COUNTED;
     }
+    if (cloud[row][col] != cloud_type)
+        counted |= TOTAL_COUNTED;
+
+    return counted;
 }
 
 /******************************************************************************
-MODULE:  Find
+MODULE:  score_height
 
-PURPOSE:  Find the parent node
+PURPOSE: Project the shadow of an object at a cloud base height and measure
+         how well it matches the potential shadow
 
-RETURN: parent node
+RETURN: Fraction of the projected pixels which are not on the object that
+        land on potential shadow, cloud or fill, or outside the image
 
 HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
-3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Moved out of match_cloud_shadow
+10/17/2026  USGS EROS        Move the shadows from the last height instead
+                             of projecting them again
 
 NOTES:
+1. The first call for an object projects every pixel.  Later calls add
+   the change of the base height times move_xy to the unrounded shadow
+   positions, one multiply and add per pixel and coordinate.  Only the
+   pixels whose position comes within SHADOW_MOTION_ERROR of halfway
+   between two pixels, where that could round another way than projecting
+   does, are projected again, so the shadow pixels are always those
+   project_cloud and project_shadow give.  The counts are then updated for
+   the pixels whose shadow moved to another pixel.
+2. Leaves the shadow pixels in obj->xy_type.
+3. With obj->weight each pixel counts for weight pixels of the object.
 ******************************************************************************/
-cloud_node *
-Find (cloud_node * node)
+static float score_height
+(
+    const Shadow_match_t *match, /* I: scene values */
+    Object_pixels_t *obj,        /* I/O: object pixels */
+    int base_h                   /* I: cloud base height (m) */
+)
 {
-    cloud_node *temp;
-    /* Find the root */
-    cloud_node *root = node;
+    int cloud_type = obj->cloud_type; /* cloud object number */
+    int **xy_type = obj->xy_type; /* projected shadow pixels */
+    double *shadow_x = obj->shadow_xy[0]; /* unrounded shadow columns */
+    double *shadow_y = obj->shadow_xy[1]; /* unrounded shadow rows */
+    double *move_x = obj->move_xy[0]; /* shadow column change per meter */
+    double *move_y = obj->move_xy[1]; /* shadow row change per meter */
+    double dh;                  /* change of the base height (m) */
+    double col_near;            /* nearest column */
+    double row_near;            /* nearest row */
+    int row, col;               /* shadow pixel */
+    unsigned char counted;      /* bits counted for the shadow */
+    int weight;                 /* object pixels the pixel is counted for */
+    int i;
 
-    if (node->parent == node)
-        return node;
+    obj->projections += obj->npixels;
 
-    while (root->parent != root)
+    if (!obj->moving)
     {
-        root = root->parent;
+        /* Get the true postion of the cloud
+           calculate cloud DEM with initial base height */
+        object_heights (obj, base_h);
+        project_cloud (&match->geometry, obj->orin_xys[0], obj->orin_xys[1],
+                       obj->h, obj->npixels, obj->tmp_xys[0],
+                       obj->tmp_xys[1]);
+        project_shadow (&match->geometry, obj->tmp_xys[0], obj->tmp_xys[1],
+                        obj->h, obj->npixels, xy_type[0], xy_type[1]);
+        shadow_motion (&match->geometry, obj->orin_xys[0], obj->orin_xys[1],
+                       obj->npixels, move_x, move_y);
+
+        obj->match_all = 0;
+        obj->total_all = 0;
+        for (i = 0; i < obj->npixels; i++)
+        {
+            shadow_x[i] = obj->orin_xys[0][i]
+                          + (obj->h_offset[i] + base_h) * move_x[i];
+            shadow_y[i] = obj->orin_xys[1][i]
+                          + (obj->h_offset[i] + base_h) * move_y[i];
+            obj->counted[i] = count_shadow (match, cloud_type, xy_type[0][i],
+                                            xy_type[1][i]);
+            weight = (obj->weight != NULL) ? obj->weight[i] : 1;
+            obj->match_all += weight * (obj->counted[i] & MATCH_COUNTED);
+            obj->total_all += weight * (obj->counted[i] >> 1);
+        }
+        obj->moving = true;
+        obj->moving_base_h = base_h;
+
+        return (float) obj->match_all / (float) obj->total_all;
     }
-    /* Update the parent pointers */
-    while (node->parent != node)
+
+    dh = base_h - obj->moving_base_h;
+    for (i = 0; i < obj->npixels; i++)
     {
-        temp = node->parent;
-        node->parent = root;
-        node = temp;
+        shadow_x[i] += dh * move_x[i];
+        shadow_y[i] += dh * move_y[i];
+        col_near = rint (shadow_x[i]);
+        row_near = rint (shadow_y[i]);
+        if (0.5 - fabs (shadow_x[i] - col_near) < SHADOW_MOTION_ERROR
+            || 0.5 - fabs (shadow_y[i] - row_near) < SHADOW_MOTION_ERROR)
+        {
+            obj->h[i] = obj->h_offset[i] + (float) base_h;
+            project_cloud (&match->geometry, &obj->orin_xys[0][i],
+                           &obj->orin_xys[1][i], &obj->h[i], 1,
+                           &obj->tmp_xys[0][i], &obj->tmp_xys[1][i]);
+            project_shadow (&match->geometry, &obj->tmp_xys[0][i],
+                            &obj->tmp_xys[1][i], &obj->h[i], 1, &row, &col);
+        }
+        else
+        {
+            row = (int) row_near;
+            col = (int) col_near;
+        }
+
+        if (row != xy_type[0][i] || col != xy_type[1][i])
+        {
+            xy_type[0][i] = row;
+            xy_type[1][i] = col;
+            counted = count_shadow (match, cloud_type, row, col);
+            weight = (obj->weight != NULL) ? obj->weight[i] : 1;
+            obj->match_all += weight * ((counted & MATCH_COUNTED)
+                                        - (obj->counted[i] & MATCH_COUNTED));
+            obj->total_all += weight * ((counted >> 1)
+                                        - (obj->counted[i] >> 1));
+            obj->counted[i] = counted;
+        }
     }
-    return root;
+    obj->moving_base_h = base_h;
+
+    return (float) obj->match_all / (float) obj->total_all;
 }
 
 /******************************************************************************
-MODULE:  Union_child
+MODULE:  full_height_search
 
-PURPOSE: Combine two cloud node child together
+PURPOSE: Step the cloud base height of an object up to the top of its
+         range, scoring its pixels, until the similarity stops increasing
 
-RETURN: None
+RETURN: true if a shadow was found, false otherwise
 
 HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
 3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Moved out of match_cloud_shadow
+10/17/2026  USGS EROS        Score the pixels of scored, which may be the
+                             perimeter of the object
 
 NOTES:
+1. The shadow found is cast from the true positions of the step which ended
+   the search, at the heights of the best step, as in the original code.
+   It is cast by all the pixels of obj, whichever pixels were scored.
+2. The search starts from the bottom of the range with record_thresh 0;
+   coarse_height_search starts it part way up with the best similarity it
+   found.
 ******************************************************************************/
-void
-Union_child (cloud_node * node1, cloud_node * node2)
+static bool full_height_search
+(
+    const Shadow_match_t *match, /* I: scene values */
+    Object_pixels_t *scored,     /* I/O: pixels scored at each height; obj
+                                        or its perimeter */
+    Object_pixels_t *obj,        /* I/O: object pixels */
+    float t_similar,             /* I: similarity threshold */
+    float t_buffer,              /* I: threshold for matching buffering */
+    int start_h,                 /* I: first cloud base height (m) */
+    int max_cl_height,           /* I: max cloud base height (m) */
+    float record_thresh,         /* I: best similarity so far */
+    int *record_base_h,          /* I/O: cloud base height of the best
+                                         similarity, and of the shadow */
+    int **shadow_xy              /* O: row and column of the shadow of each
+                                       pixel, when one was found */
+)
 {
-    node1->child = node2;
-    node2->value = node1->value;
-    while (node2->child != node2)
+    int i_step = match->i_step; /* iteration step */
+    float max_similar = 0.95;   /* max similarity threshold */
+    float thresh_match;         /* thresh match value */
+    int base_h;                 /* cloud base height */
+
+    for (base_h = start_h; base_h <= max_cl_height;
+         base_h += i_step)
     {
-        node2 = node2->child;
-        node2->value = node1->value;
+        thresh_match = score_height (match, scored, base_h);
+        if (((thresh_match - t_buffer * record_thresh) >=
+             MINSIGMA) && (base_h < max_cl_height - i_step)
+            && ((record_thresh - max_similar) < MINSIGMA))
+        {
+            if ((thresh_match - record_thresh) > MINSIGMA)
+            {
+                record_thresh = thresh_match;
+                *record_base_h = base_h;
+            }
+        }
+        else if ((record_thresh - t_similar) > MINSIGMA)
+        {
+            object_heights (obj, base_h);
+            project_cloud (&match->geometry, obj->orin_xys[0],
+                           obj->orin_xys[1], obj->h, obj->npixels,
+                           obj->tmp_xys[0], obj->tmp_xys[1]);
+            object_heights (obj, *record_base_h);
+            project_shadow (&match->geometry, obj->tmp_xys[0],
+                            obj->tmp_xys[1], obj->h, obj->npixels,
+                            shadow_xy[0], shadow_xy[1]);
+            return true;
+        }
+        else
+        {
+            record_thresh = 0.0;
+            continue;
+        }
     }
+
+    return false;
 }
 
 /******************************************************************************
-MODULE:  Find_child
+MODULE:  coarse_height_search
 
-PURPOSE: Find the child node
+PURPOSE: Search the cloud base height of an object on a sample of its pixels
+         at coarse steps, then on all its pixels around the best coarse
+         height
 
-RETURN: None
+RETURN: true if a shadow was found, false otherwise
 
 HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
-3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Original Development
 
 NOTES:
+1. The coarse pass is the full search with COARSE_STEP_FACTOR times the
+   step, scoring only the sample.  The fine pass scores the scored pixels at
+   each step less than COARSE_STEP_FACTOR steps from the coarse height the
+   coarse pass recorded, and takes the best of them.  The full search then
+   carries on from the step after the best one, so the search ends and the
+   shadow is cast the way the full search would from there.
 ******************************************************************************/
-cloud_node *
-Find_child (cloud_node * node)
+static bool coarse_height_search
+(
+    const Shadow_match_t *match, /* I: scene values */
+    Object_pixels_t *scored,     /* I/O: pixels scored by the fine pass;
+                                        obj or its perimeter */
+    Object_pixels_t *obj,        /* I/O: object pixels */
+    Object_pixels_t *sample,     /* I/O: sample of the object pixels */
+    float t_similar,             /* I: similarity threshold */
+    float t_buffer,              /* I: threshold for matching buffering */
+    int min_cl_height,           /* I: min cloud base height (m) */
+    int max_cl_height,           /* I: max cloud base height (m) */
+    int *record_base_h,          /* O: cloud base height of the shadow */
+    int **shadow_xy              /* O: row and column of the shadow of each
+                                       pixel, when one was found */
+)
 {
-    /* Find the root */
-    cloud_node *root = node;
-    if (node->child == node)
+    int i_step = match->i_step; /* iteration step */
+    int coarse_step = COARSE_STEP_FACTOR * i_step; /* coarse iteration
+                                                      step */
+    float max_similar = 0.95;   /* max similarity threshold */
+    float record_thresh;        /* record thresh value */
+    float thresh_match;         /* thresh match value */
+    int coarse_base_h = 0;      /* best coarse cloud base height */
+    int base_h;                 /* cloud base height */
+    bool found = false;         /* was a coarse height recorded? */
+    int k;
+
+    record_thresh = 0.0;
+    for (base_h = min_cl_height; base_h <= max_cl_height;
+         base_h += coarse_step)
     {
-        return node;
+        thresh_match = score_height (match, sample, base_h);
+        if (((thresh_match - t_buffer * record_thresh) >=
+             MINSIGMA) && (base_h < max_cl_height - coarse_step)
+            && ((record_thresh - max_similar) < MINSIGMA))
+        {
+            if ((thresh_match - record_thresh) > MINSIGMA)
+            {
+                record_thresh = thresh_match;
+                coarse_base_h = base_h;
+            }
+        }
+        else if ((record_thresh - t_similar) > MINSIGMA)
+        {
+            found = true;
+            break;
+        }
+        else
+            record_thresh = 0.0;
     }
-
-    while (root->child != root)
+    if (!found)
+        return false;
+
+    /* Refine at the full step around the coarse height, keeping to the
+       heights the full search could record */
+    record_thresh = 0.0;
+    *record_base_h = coarse_base_h;
+    for (k = 1 - COARSE_STEP_FACTOR; k < COARSE_STEP_FACTOR; k++)
     {
-        root = root->child;
+        base_h = coarse_base_h + k * i_step;
+        if (base_h < min_cl_height || base_h >= max_cl_height - i_step)
+            continue;
+        thresh_match = score_height (match, scored, base_h);
+        if ((thresh_match - record_thresh) > MINSIGMA)
+        {
+            record_thresh = thresh_match;
+            *record_base_h = base_h;
+        }
     }
+    if ((record_thresh - t_similar) <= MINSIGMA)
+        return false;
 
-    return root;
+    return full_height_search (match, scored, obj, t_similar, t_buffer,
+                               *record_base_h + i_step, max_cl_height,
+                               record_thresh, record_base_h, shadow_xy);
 }
 
 /******************************************************************************
-MODULE:  find_minimum
+MODULE:  perimeter_object_pixels
 
-PURPOSE: Find the minimum value and its location in an array
+PURPOSE: Select the pixels of a cloud object on its perimeter and a sample
+         of its interior pixels for the height searches
 
-RETURN: None
+RETURN: SUCCESS
+        FAILURE
 
 HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
-3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Original Development
 
 NOTES:
+1. A pixel is on the perimeter when one of its four neighbors is outside
+   the image or not labeled as the object.  The shadows of interior pixels
+   start on the object, and those still on it are not counted, so most of
+   the similarity comes from the perimeter and the pixels near it.
+2. The interior pixels kept are those whose row and column are multiples
+   of the grid spacing, each weighted by the spacing squared, so the
+   interior pixels whose shadows leave the object are still counted about
+   as often.  A grid rather than every n-th pixel keeps the sample even
+   across the columns.  The spacing grows with the object so the pixels
+   kept grow with the perimeter rather than the area.  The similarity is
+   an estimate; the shadow is still cast by every pixel.
+3. obj must have its height offsets set.
 ******************************************************************************/
-void find_minimum
+static int perimeter_object_pixels
 (
-    int *array,  /*I: input array */
-    int nums,    /*I: number of elements in input array */
-    int *min,    /*O: minimum value found */
-    int *index   /*O: minimum value location */
+    const Shadow_match_t *match, /* I: scene values */
+    Scratch_arena_t *arena,      /* I/O: arena the arrays are taken from */
+    const Object_pixels_t *obj,  /* I: object pixels */
+    Object_pixels_t *perimeter   /* O: perimeter and interior sample
+                                       pixels; allocated here */
 )
 {
-    int i;       /* loop index */
+    char errstr[MAX_STR_LEN];   /* error string */
+    int **cloud = match->objects->label; /* cloud object number of all
+                                            pixels */
+    int cloud_type = obj->cloud_type; /* cloud object number */
+    unsigned char *kept;        /* 1 for the perimeter pixels, 2 for the
+                                   interior pixels kept, else 0 */
+    int num_edge = 0;           /* pixels on the perimeter */
+    int num_interior;           /* pixels not on the perimeter */
+    int num_kept;               /* pixels kept */
+    int spacing;                /* grid spacing of the interior pixels
+                                   kept */
+    int row, col;               /* pixel location */
+    int status;                 /* return value */
+    int i, n;
 
-    *min = 0;
-    *index = 0;
-    for (i = 0; i < nums; i++)
+    kept = scratch_alloc (arena, obj->npixels * sizeof (unsigned char));
+    if (kept == NULL)
     {
-        if (array[i] > 0)
-        {
-            *min = array[i];
-            *index = i;
-            break;
-        }
+        sprintf (errstr, "Allocating perimeter memory");
+        RETURN_ERROR (errstr, "perimeter_object_pixels", FAILURE);
+    }
+    for (i = 0; i < obj->npixels; i++)
+    {
+        col = obj->orin_xys[0][i];
+        row = obj->orin_xys[1][i];
+        kept[i] = row == 0 || row == match->nrows - 1 || col == 0
+                  || col == match->ncols - 1
+                  || cloud[row - 1][col] != cloud_type
+                  || cloud[row + 1][col] != cloud_type
+                  || cloud[row][col - 1] != cloud_type
+                  || cloud[row][col + 1] != cloud_type;
+        num_edge += kept[i];
     }
-    for (i = 0; i < nums; i++)
+    num_interior = obj->npixels - num_edge;
+
+    spacing = PERIMETER_INTERIOR_SPACING;
+    while ((double) num_interior
+           > (double) PERIMETER_INTERIOR_RATIO * num_edge * spacing * spacing)
+        spacing++;
+
+    num_kept = num_edge;
+    for (i = 0; i < obj->npixels; i++)
     {
-        if (array[i] > 0 && array[i] < *min)
+        if (!kept[i] && obj->orin_xys[0][i] % spacing == 0
+            && obj->orin_xys[1][i] % spacing == 0)
         {
-            *min = array[i];
-            *index = i;
+            kept[i] = 2;
+            num_kept++;
         }
     }
+
+    status = allocate_object_pixels (arena, cloud_type, num_kept, perimeter);
+    if (status == SUCCESS)
+    {
+        perimeter->weight = scratch_alloc (arena, num_kept * sizeof (int));
+        if (perimeter->weight == NULL)
+            status = FAILURE;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errstr, "Allocating perimeter memory");
+        RETURN_ERROR (errstr, "perimeter_object_pixels", FAILURE);
+    }
+
+    perimeter->t_obj = obj->t_obj;
+    n = 0;
+    for (i = 0; i < obj->npixels; i++)
+    {
+        if (!kept[i])
+            continue;
+        perimeter->weight[n] = (kept[i] == 1) ? 1 : spacing * spacing;
+        perimeter->orin_xys[0][n] = obj->orin_xys[0][i];
+        perimeter->orin_xys[1][n] = obj->orin_xys[1][i];
+        perimeter->temp_obj[n] = obj->temp_obj[i];
+        perimeter->h_offset[n] = obj->h_offset[i];
+        n++;
+    }
+
+    return SUCCESS;
 }
 
 /******************************************************************************
-MODULE:  label
+MODULE:  compare_pixel_position
 
-PURPOSE: label each cloud pixel with a cloud number
+PURPOSE: qsort comparison putting object pixels in raster order
 
-RETURN: None
+RETURN: < 0, 0 or > 0 as the first pixel goes before, with or after the
+        second
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static int compare_pixel_position
+(
+    const void *p1,  /* I: first Pixel_position_t */
+    const void *p2   /* I: second Pixel_position_t */
+)
+{
+    const Pixel_position_t *pixel1 = (const Pixel_position_t *) p1;
+    const Pixel_position_t *pixel2 = (const Pixel_position_t *) p2;
+
+    if (pixel1->pixel != pixel2->pixel)
+        return (pixel1->pixel < pixel2->pixel) ? -1 : 1;
+    return 0;
+}
+
+/******************************************************************************
+MODULE:  sample_object_pixels
+
+PURPOSE: Select a sample of about COARSE_SAMPLE_PIXELS pixels of a cloud
+         object for the coarse height search
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The sample is every stride-th pixel of the object in raster order.  The
+   packed order of the object pixels depends on the number of labeling
+   threads (see label), so a sample taken in packed order would make the
+   coarse search depend on it.
+2. obj must have its height offsets set.
+******************************************************************************/
+static int sample_object_pixels
+(
+    const Shadow_match_t *match, /* I: scene values */
+    Scratch_arena_t *arena,      /* I/O: arena the arrays are taken from */
+    const Object_pixels_t *obj,  /* I: object pixels */
+    Object_pixels_t *sample      /* O: sample pixels; allocated here */
+)
+{
+    char errstr[MAX_STR_LEN];   /* error string */
+    Pixel_position_t *position; /* object pixels in raster order */
+    int stride;                 /* object pixels per sample pixel */
+    int status;                 /* return value */
+    int i, n;
+
+    stride = obj->npixels / COARSE_SAMPLE_PIXELS;
+    if (stride < 1)
+        stride = 1;
+    position = scratch_alloc (arena,
+                              obj->npixels * sizeof (Pixel_position_t));
+    if (position == NULL)
+        status = FAILURE;
+    else
+    {
+        status = allocate_object_pixels (arena, obj->cloud_type,
+                                         (obj->npixels + stride - 1) / stride,
+                                         sample);
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errstr, "Allocating sample memory");
+        RETURN_ERROR (errstr, "sample_object_pixels", FAILURE);
+    }
+
+    for (i = 0; i < obj->npixels; i++)
+    {
+        position[i].pixel = obj->orin_xys[1][i] * match->ncols
+                            + obj->orin_xys[0][i];
+        position[i].index = i;
+    }
+    qsort (position, obj->npixels, sizeof (Pixel_position_t),
+           compare_pixel_position);
+
+    sample->t_obj = obj->t_obj;
+    for (n = 0; n < sample->npixels; n++)
+    {
+        i = position[n * stride].index;
+        sample->orin_xys[0][n] = obj->orin_xys[0][i];
+        sample->orin_xys[1][n] = obj->orin_xys[1][i];
+        sample->temp_obj[n] = obj->temp_obj[i];
+        sample->h_offset[n] = obj->h_offset[i];
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  match_cloud_shadow
+
+PURPOSE: Find the cloud base height whose projected shadow best matches the
+         potential shadow for one cloud object, and mark that shadow
+
+RETURN: SUCCESS
+        FAILURE
 
 HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
 3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Moved out of object_cloud_shadow_match so the
+                             objects can be searched in parallel
+10/17/2026  USGS EROS        Project the cloud and shadow pixels with
+                             shadow_project
+10/17/2026  USGS EROS        Added the coarse height search
+10/17/2026  USGS EROS        Score large objects on their perimeter
+10/17/2026  USGS EROS        Find the cloud base temperature by selection
+                             in a scratch buffer kept between objects
+10/17/2026  USGS EROS        Take all the arrays from the thread's scratch
+                             arena
 
 NOTES:
+1. Only the shadow pixels are written, so different objects may be
+   searched at the same time as long as each thread has its own
+   shadow_plane or shadow_mask.
+2. Objects of at least COARSE_MIN_PIXELS pixels use coarse_height_search
+   unless the height search is HEIGHT_SEARCH_FULL; smaller objects always
+   use full_height_search.  With stats, such objects are searched both ways
+   and the agreement is added to stats, but the coarse search is used.
+3. Objects of at least match->perimeter_pixels pixels are scored on the
+   pixels perimeter_object_pixels selects, by whichever search is used.
+   With stats, the full search they are compared against scores every
+   pixel.
 ******************************************************************************/
-void label
+static int match_cloud_shadow
 (
-    unsigned char **pixel_mask,     /*I: cloud pixel mask */
-    int nrows,                      /*I: number of rows */
-    int ncols,                      /*I: number of columns */
-    cloud_node ** cloud,            /*O: cloud pixel node */
-    unsigned int *obj_num,          /*O: cloud number */
-    unsigned int **first_cloud_node /*O: first cloud pixel node */
+    const Shadow_match_t *match, /* I: scene values */
+    int cloud_type,              /* I: cloud object number */
+    Bitplane_t *shadow_plane,    /* I/O: shadow pixels found, or NULL */
+    unsigned char **shadow_mask, /* I/O: mask whose SHADOW_BIT is set for the
+                                       shadow pixels found, when
+                                       shadow_plane is NULL */
+    Height_search_stats_t *stats, /* I/O: agreement of the coarse and full
+                                        searches, or NULL */
+    Scratch_arena_t *arena       /* I/O: scratch arena of the thread; reset
+                                       for this object */
 )
 {
-    int row, col;    /* loop indices */
-    int array[4];    /* array of 4 elements */
-    int min;         /* minimum value */
-    int index;       /* minimum value location */
+    char errstr[MAX_STR_LEN];   /* error string */
+    int nrows = match->nrows;   /* number of rows */
+    int ncols = match->ncols;   /* number of columns */
+    int16 *temp = match->temp;  /* brightness temperature */
+    Cloud_objects_t *objects = match->objects; /* labeled cloud objects */
+    unsigned int *obj_num = objects->obj_num; /* pixels in each object */
+    float t_templ = match->t_templ; /* percentile of low background temp */
+    float t_temph = match->t_temph; /* percentile of high background temp */
+    int boundary_counter = match->boundary_counter; /* boundary pixels */
+    int row, col;               /* pixel location */
+    int status;                 /* return value */
+    float t_similar;            /* similarity threshold */
+    float t_buffer;             /* threshold for matching buffering */
+    int num_pix = 3;            /* number of inward pixes (240m) for cloud base
+                                   temperature */
+    Object_pixels_t obj;        /* pixels of the object */
+    Object_pixels_t sample;     /* sample of the pixels of the object */
+    Object_pixels_t perimeter;  /* perimeter pixels of the object */
+    Object_pixels_t *scored;    /* pixels scored by the height searches */
+    int **tmp_xy_type;          /* intermediate variables */
+    int16 *temp_scratch;        /* copy of the temperatures to select the
+                                   base temperature from */
+    int **full_xy_type = NULL;  /* shadow of the full search, with stats */
+    int16 temp_obj_max = 0;     /* maximum temperature for each cloud */
+    int16 temp_obj_min = 0;     /* minimum temperature for each cloud */
+    int index;                  /* loop index */
+    int first_pos;              /* packed index of the first object pixel */
+    unsigned int num_pixels;    /* object pixels, as the original code
+                                   counted them */
+    float r_obj;                /* cloud radius */
+    float r_sqrd_obj;           /* cloud radius squared */
+    float pct_obj;              /* percent of edge pixels */
+    float inv_rate_dlapse = 1.0/9.8; /* inverse dry air lapse rate */
+    int max_cl_height;          /* Max cloud base height (m) */
+    int min_cl_height;          /* Min cloud base height (m) */
+    int max_height;             /* refined maximum height (m) */
+    int min_height;             /* refined minimum height (m) */
+    int base_h = 0;             /* cloud base height of the shadow */
+    int full_base_h = 0;        /* cloud base height of the full search */
+    bool coarse;                /* use the coarse search? */
+    bool on_perimeter;          /* score the perimeter of the object? */
+    bool found;                 /* was a shadow found? */
+    bool full_found;            /* did the full search find a shadow? */
+    int i;
 
-    for (row = 0; row < nrows; row++)
+    /* Update in Fmask v3.3, for larger (> 10% scene area), use
+       another set of t_similar and t_buffer to address some
+       missing cloud shadow at edge area */
+    num_pixels = obj_num[cloud_type];
+    if ((match->max_cloud_pixels > 0)
+        && ((cloud_type > match->num_clouds)
+            || (num_pixels > match->max_cloud_pixels)))
     {
-        for (col = 0; col < ncols; col++)
+        /* The original code counted max_cloud_pixels pixels for every piece
+           of a divided cloud, though the first piece has one pixel more and
+           the others may have fewer */
+        num_pixels = match->max_cloud_pixels;
+    }
+    if (num_pixels <= (int) (0.1 * boundary_counter))
+    {
+        t_similar = 0.3;
+        t_buffer = 0.95;
+    }
+    else
+    {
+        t_similar = 0.1;
+        t_buffer = 0.98;
+    }
+
+    /* Note: matlab array index starts with 1 and C starts with 0,
+       array(3,1) in matlab is equal to array[2][0] in C */
+    min_cl_height = 200;
+    max_cl_height = 12000;
+
+    first_pos = objects->obj_first[cloud_type];
+    status = reset_scratch_arena (arena);
+    if (status == SUCCESS)
+    {
+        status = allocate_object_pixels (arena, cloud_type,
+                                         obj_num[cloud_type], &obj);
+    }
+    tmp_xy_type = (int **) scratch_alloc_2d (arena, 2, obj.npixels,
+                                             sizeof (int));
+    if (status != SUCCESS || tmp_xy_type == NULL)
+    {
+        sprintf (errstr, "Allocating cloud memory");
+        RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+    }
+
+    temp_obj_max = SHRT_MIN;
+    temp_obj_min = SHRT_MAX;
+    for (index = 0; index < obj.npixels; index++)
+    {
+        row = CLOUD_PIXEL_ROW (*objects, first_pos + index);
+        col = CLOUD_PIXEL_COL (*objects, first_pos + index);
+        obj.temp_obj[index] = temp[row * ncols + col];
+        if (obj.temp_obj[index] > temp_obj_max)
+            temp_obj_max = obj.temp_obj[index];
+        if (obj.temp_obj[index] < temp_obj_min)
+            temp_obj_min = obj.temp_obj[index];
+        obj.orin_xys[0][index] = col;
+        obj.orin_xys[1][index] = row;
+    }
+
+    /* the base temperature for cloud
+       assume object is round r_obj is radium of object */
+    r_sqrd_obj = ((float) obj.npixels / (2.0 * PI));
+    r_obj = sqrt (r_sqrd_obj);
+
+    /* number of inward pixels for correct temperature */
+    pct_obj = ((r_obj - (float) num_pix)
+               * (r_obj - (float) num_pix)) / r_sqrd_obj;
+    if ((pct_obj - 1.0) >= MINSIGMA)
+    {
+        /* Use the minimum temperature instead */
+        obj.t_obj = temp_obj_min;
+    }
+    else
+    {
+        /* Select the percentile from a copy, as the pixel order of
+           temp_obj is kept */
+        temp_scratch = scratch_alloc (arena, obj.npixels * sizeof (int16));
+        if (temp_scratch == NULL)
         {
-            if (pixel_mask[row][col] & (1 << CLOUD_BIT))
-            {
-                if (row > 0 && col > 0
-                    && (pixel_mask[row - 1][col - 1] & (1 << CLOUD_BIT)))
-                {
-                    array[0] = cloud[row - 1][col - 1].value;
-                }
-                else
-                {
-                    array[0] = 0;
-                }
+            sprintf (errstr, "Allocating temperature scratch memory");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+        }
+        memcpy (temp_scratch, obj.temp_obj, obj.npixels * sizeof (int16));
+        select_prctile (temp_scratch, obj.npixels, temp_obj_min,
+                        temp_obj_max, 100.0 * pct_obj, &obj.t_obj);
+    }
 
-                if (row > 0 && (pixel_mask[row - 1][col] & (1 << CLOUD_BIT)))
-                {
-                    array[1] = cloud[row - 1][col].value;
-                }
-                else
-                {
-                    array[1] = 0;
-                }
+    /* refine cloud height range (m) */
+    min_height =
+        (int) rint (10.0 * (t_templ - obj.t_obj) * inv_rate_dlapse);
+    max_height = (int) rint (10.0 * (t_temph - obj.t_obj));
+    if (min_cl_height < min_height)
+        min_cl_height = min_height;
+    if (max_cl_height > max_height)
+        max_cl_height = max_height;
+
+    /* put the edge of the cloud the same value as t_obj */
+    for (i = 0; i < obj.npixels; i++)
+    {
+        if (obj.temp_obj[i] > rint (obj.t_obj))
+            obj.temp_obj[i] = rint (obj.t_obj);
+    }
 
-                if (row > 0 && (col < ncols - 1)
-                    && (pixel_mask[row - 1][col + 1] & (1 << CLOUD_BIT)))
-                {
-                    array[2] = cloud[row - 1][col + 1].value;
-                }
-                else
-                {
-                    array[2] = 0;
-                }
+    set_height_offsets (&obj);
 
-                if (col > 0 && (pixel_mask[row][col - 1] & (1 << CLOUD_BIT)))
-                {
-                    array[3] = cloud[row][col - 1].value;
-                }
-                else
-                {
-                    array[3] = 0;
-                }
+    /* Score only the perimeter and some interior pixels of very large
+       objects, if asked to */
+    on_perimeter = match->perimeter_pixels > 0
+                   && obj.npixels >= match->perimeter_pixels;
+    scored = &obj;
+    if (on_perimeter)
+    {
+        status = perimeter_object_pixels (match, arena, &obj, &perimeter);
+        if (status != SUCCESS)
+        {
+            sprintf (errstr, "Selecting the object perimeter");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+        }
+        scored = &perimeter;
+    }
 
-                /* The cloud pixel will be labeled as a new cloud if
-                   neighboring pixels before it are not cloud pixels,
-                   otherwise it will be labeled as lowest cloud number
-                   neighboring it */
-                find_minimum (array, 4, &min, &index);
-                if (min == 0)
-                {
-                    num_clouds++;
-                    cloud[row][col].value = num_clouds;
-                    cloud[row][col].row = row;
-                    cloud[row][col].col = col;
-                    first_cloud_node[0][num_clouds] = row;
-                    first_cloud_node[1][num_clouds] = col;
-                }
-                else
-                {
-                    cloud[row][col].value = min;
-                    cloud[row][col].row = row;
-                    cloud[row][col].col = col;
-                    if (index == 0)
-                    {
-                        cloud[row][col].parent =
-                            Find (&cloud[row - 1][col - 1]);
-                        Find_child (&cloud[row - 1][col - 1])->child =
-                            &cloud[row][col];
-                    }
-                    else if (index == 1)
-                    {
-                        cloud[row][col].parent = Find (&cloud[row - 1][col]);
-                        Find_child (&cloud[row - 1][col])->child =
-                            &cloud[row][col];
-                    }
-                    else if (index == 2)
-                    {
-                        cloud[row][col].parent =
-                            Find (&cloud[row - 1][col + 1]);
-                        Find_child (&cloud[row - 1][col + 1])->child =
-                            &cloud[row][col];
-                    }
-                    else if (index == 3)
-                    {
-                        cloud[row][col].parent = Find (&cloud[row][col - 1]);
-                        Find_child (&cloud[row][col - 1])->child =
-                            &cloud[row][col];
-                    }
-                    else
-                        continue;
+    /* Sample the pixels of large objects for the coarse search */
+    coarse = match->height_search != HEIGHT_SEARCH_FULL
+             && obj.npixels >= COARSE_MIN_PIXELS;
+    if (coarse)
+    {
+        status = sample_object_pixels (match, arena, &obj, &sample);
+        if (status != SUCCESS)
+        {
+            sprintf (errstr, "Sampling the object pixels");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+        }
+    }
 
-                    /* If two neighboring pixels are labeled as different
-                       cloud numbers, the two cloud pixels are relabeled as
-                       the same cloud */
-                    if (row > 0 && col > 0
-                        && (pixel_mask[row - 1][col - 1] & (1 << CLOUD_BIT))
-                        && (cloud[row - 1][col - 1].value != min))
-                    {
-                        if (index == 1)
-                        {
-                            Union_child (Find_child (&cloud[row - 1][col]),
-                                         Find (&cloud[row - 1][col - 1]));
-                            Find (&cloud[row - 1][col - 1])->parent =
-                                Find (&cloud[row - 1][col]);
-                        }
-                        else if (index == 2)
-                        {
-                            Union_child (Find_child
-                                         (&cloud[row - 1][col + 1]),
-                                         Find (&cloud[row - 1][col - 1]));
-                            Find (&cloud[row - 1][col - 1])->parent =
-                                Find (&cloud[row - 1][col + 1]);
-                        }
-                        else if (index == 3)
-                        {
-                            Union_child (Find_child (&cloud[row][col - 1]),
-                                         Find (&cloud[row - 1][col - 1]));
-                            Find (&cloud[row - 1][col - 1])->parent =
-                                Find (&cloud[row][col - 1]);
-                        }
-                        else
-                            continue;
-                    }
-                    if (row > 0
-                        && (pixel_mask[row - 1][col] & (1 << CLOUD_BIT))
-                        && (cloud[row - 1][col].value != min))
-                    {
-                        if (index == 0)
-                        {
-                            Union_child (Find_child
-                                         (&cloud[row - 1][col - 1]),
-                                         Find (&cloud[row - 1][col]));
-                            Find (&cloud[row - 1][col])->parent =
-                                Find (&cloud[row - 1][col - 1]);
-                        }
-                        else if (index == 2)
-                        {
-                            Union_child (Find_child
-                                         (&cloud[row - 1][col + 1]),
-                                         Find (&cloud[row - 1][col]));
-                            Find (&cloud[row - 1][col])->parent =
-                                Find (&cloud[row - 1][col + 1]);
-                        }
-                        else if (index == 3)
-                        {
-                            Union_child (Find_child (&cloud[row][col - 1]),
-                                         Find (&cloud[row - 1][col]));
-                            Find (&cloud[row - 1][col])->parent =
-                                Find (&cloud[row][col - 1]);
-                        }
-                        else
-                            continue;
-                    }
-                    if (row > 0 && (col < ncols - 1)
-                        && (pixel_mask[row - 1][col + 1] & (1 << CLOUD_BIT))
-                        && (cloud[row - 1][col + 1].value != min))
-                    {
-                        if (index == 0)
-                        {
-                            Union_child (Find_child
-                                         (&cloud[row - 1][col - 1]),
-                                         Find (&cloud[row - 1][col + 1]));
-                            Find (&cloud[row - 1][col + 1])->parent =
-                                Find (&cloud[row - 1][col - 1]);
-                        }
-                        else if (index == 1)
-                        {
-                            Union_child (Find_child (&cloud[row - 1][col]),
-                                         Find (&cloud[row - 1][col + 1]));
-                            Find (&cloud[row - 1][col + 1])->parent =
-                                Find (&cloud[row - 1][col]);
-                        }
-                        else if (index == 3)
-                        {
-                            Union_child (Find_child (&cloud[row][col - 1]),
-                                         Find (&cloud[row - 1][col + 1]));
-                            Find (&cloud[row - 1][col + 1])->parent =
-                                Find (&cloud[row][col - 1]);
-                        }
-                        else
-                            continue;
-                    }
-                    if (col > 0
-                        && (pixel_mask[row][col - 1] & (1 << CLOUD_BIT))
-                        && (cloud[row][col - 1].value != min))
-                    {
-                        if (index == 0)
-                        {
-                            Union_child (Find_child
-                                         (&cloud[row - 1][col - 1]),
-                                         Find (&cloud[row][col - 1]));
-                            Find (&cloud[row][col - 1])->parent =
-                                Find (&cloud[row - 1][col - 1]);
-                        }
-                        else if (index == 1)
-                        {
-                            Union_child (Find_child (&cloud[row - 1][col]),
-                                         Find (&cloud[row][col - 1]));
-                            Find (&cloud[row][col - 1])->parent =
-                                Find (&cloud[row - 1][col]);
-                        }
-                        else if (index == 2)
-                        {
-                            Union_child (Find_child
-                                         (&cloud[row - 1][col + 1]),
-                                         Find (&cloud[row][col - 1]));
-                            Find (&cloud[row][col - 1])->parent =
-                                Find (&cloud[row - 1][col + 1]);
-                        }
-                        else
-                            continue;
-                    }
+    /* With stats, search every pixel the full way first to compare */
+    full_found = false;
+    if (stats != NULL && (coarse || on_perimeter))
+    {
+        full_xy_type = (int **) scratch_alloc_2d (arena, 2, obj.npixels,
+                                                  sizeof (int));
+        if (full_xy_type == NULL)
+        {
+            sprintf (errstr, "Allocating full_xy_type memory");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+        }
+        full_found = full_height_search (match, &obj, &obj, t_similar,
+                                         t_buffer, min_cl_height,
+                                         max_cl_height, 0.0, &full_base_h,
+                                         full_xy_type);
+        stats->full_projections += obj.projections;
+        obj.projections = 0;
+    }
+
+    if (coarse)
+    {
+        found = coarse_height_search (match, scored, &obj, &sample,
+                                      t_similar, t_buffer, min_cl_height,
+                                      max_cl_height, &base_h, tmp_xy_type);
+    }
+    else
+    {
+        found = full_height_search (match, scored, &obj, t_similar,
+                                    t_buffer, min_cl_height, max_cl_height,
+                                    0.0, &base_h, tmp_xy_type);
+    }
+
+    if (full_xy_type != NULL)
+    {
+        stats->objects++;
+        stats->coarse_projections += obj.projections;
+        if (coarse)
+            stats->coarse_projections += sample.projections;
+        if (on_perimeter)
+            stats->coarse_projections += perimeter.projections;
+        if (found != full_found)
+            stats->shadow_differs++;
+        else if (found)
+        {
+            if (base_h == full_base_h)
+                stats->same_height++;
+            if (abs (base_h - full_base_h)
+                < COARSE_STEP_FACTOR * match->i_step)
+            {
+                stats->near_height++;
+            }
+            stats->pixels += obj.npixels;
+            for (i = 0; i < obj.npixels; i++)
+            {
+                if (tmp_xy_type[0][i] == full_xy_type[0][i]
+                    && tmp_xy_type[1][i] == full_xy_type[1][i])
+                {
+                    stats->same_pixels++;
                 }
             }
         }
+        else
+        {
+            stats->same_height++;
+            stats->near_height++;
+        }
     }
-    printf ("First pass in labeling algorithm done\n");
 
-    /* The second pass labels all cloud pixels according two their root
-       parent cloud pixel values */
-    for (row = 0; row < nrows; row++)
+    if (found)
     {
-        for (col = 0; col < ncols; col++)
+        for (i = 0; i < obj.npixels; i++)
         {
-            if (pixel_mask[row][col] & (1 << CLOUD_BIT))
+            /* put data within range */
+            if (tmp_xy_type[0][i] < 0)
+                tmp_xy_type[0][i] = 0;
+            if (tmp_xy_type[0][i] >= nrows)
+                tmp_xy_type[0][i] = nrows - 1;
+            if (tmp_xy_type[1][i] < 0)
+                tmp_xy_type[1][i] = 0;
+            if (tmp_xy_type[1][i] >= ncols)
+                tmp_xy_type[1][i] = ncols - 1;
+            if (shadow_plane != NULL)
+            {
+                SET_BITPLANE_PIXEL (shadow_plane, tmp_xy_type[0][i],
+                                    tmp_xy_type[1][i]);
+            }
+            else
             {
-                cloud[row][col].value = Find (&cloud[row][col])->value;
-                obj_num[cloud[row][col].value]++;
+                shadow_mask[tmp_xy_type[0][i]][tmp_xy_type[1][i]]
+                    |= 1 << SHADOW_BIT;
             }
         }
     }
-    printf ("Second pass in labeling algorithm done\n");
+
+    /* The arrays are released by the next reset of the arena */
+    return SUCCESS;
 }
 
 /******************************************************************************
-MODULE:  image_dilate
+MODULE:  shadow_worker_thread
 
-PURPOSE: Dilate the image with a n x n rectangular buffer
+PURPOSE: Thread start routine which does the shadow height searches of the
+         cloud objects, taking the next object in order until none are left
 
-RETURN: None
+RETURN: NULL; the return value is stored in the worker status
 
 HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
-11/18/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Original Development
 
 NOTES:
 ******************************************************************************/
-void image_dilate
+static void *shadow_worker_thread
 (
-    unsigned char **in_mask, /* I: Mask to be dilated */
-    int nrows,               /* I: Number of rows in the mask */
-    int ncols,               /* I: Number of columns in the mask */
-    int idx,                 /* I: pixel buffer 2 * idx + 1 */
-    int bit,                 /* I: type of image to dilute */
-    unsigned char **out_mask /* O: Mask after dilate */
+    void *args  /* I/O: pointer to the Shadow_worker_t of the thread */
 )
 {
-    int row, col, ir, ic;  /* loop indices */
-    unsigned char mask;    /* temporarily output pixel mask value */
+    Shadow_worker_t *worker = (Shadow_worker_t *) args;
+    int next;                   /* index in order of the object to search */
 
-    for (row = 0; row < nrows; row++)
+    worker->status = SUCCESS;
+    while (true)
     {
-        for (col = 0; col < ncols; col++)
+#ifdef NEXT_OBJECT
+        next = NEXT_OBJECT (worker->next_object);
+#else
+        next = (*worker->next_object)++;
+#endif
+        if (next >= worker->num_objects)
+            break;
+        if (match_cloud_shadow (worker->match, worker->order[next],
+                                worker->shadow_plane, worker->shadow_mask,
+                                (worker->match->height_search
+                                 == HEIGHT_SEARCH_COMPARE)
+                                ? &worker->stats : NULL, &worker->arena)
+            != SUCCESS)
         {
-            mask = 0;
-            for (ir = 0; ir < idx + 1; ir++)
-            {
-                for (ic = 0; ic < idx + 1; ic++)
-                {
-                    if (((row - ir) > 0) && ((col - ic) > 0) && mask != 1)
-                    {
-                        if (in_mask[row - ir][col - ic] & (1 << bit))
-                            mask = 1;
-                    }
-                    if (((row - ir) > 0) && ((col + ic) < (ncols - 1))
-                        && mask != 1)
-                    {
-                        if (in_mask[row - ir][col + ic] & (1 << bit))
-                            mask = 1;
-                    }
-                    if (((row + ir) < (nrows - 1)) && ((col - ic) > 0)
-                        && mask != 1)
-                    {
-                        if (in_mask[row + ir][col - ic] & (1 << bit))
-                            mask = 1;
-                    }
-                    if (((row + ir) < (nrows - 1))
-                        && ((col + ic) < (ncols - 1)) && mask != 1)
-                    {
-                        if (in_mask[row + ir][col + ic] & (1 << bit))
-                            mask = 1;
-                    }
-                }
-            }
-            if (mask == 1)
-                out_mask[row][col] |= 1 << bit;
-            else
-                out_mask[row][col] &= ~(1 << bit);
+            worker->status = FAILURE;
+            break;
         }
     }
+    free_scratch_arena (&worker->arena);
+
+    return NULL;
+}
+
+/******************************************************************************
+MODULE:  compare_object_size
+
+PURPOSE: qsort comparison putting larger cloud objects first, and objects of
+         the same size in object number order
+
+RETURN: < 0, 0 or > 0 as the first object goes before, with or after the
+        second
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static int compare_object_size
+(
+    const void *p1,  /* I: first Object_size_t */
+    const void *p2   /* I: second Object_size_t */
+)
+{
+    const Object_size_t *obj1 = (const Object_size_t *) p1;
+    const Object_size_t *obj2 = (const Object_size_t *) p2;
+
+    if (obj1->size != obj2->size)
+        return (obj1->size > obj2->size) ? -1 : 1;
+    return obj1->number - obj2->number;
 }
 
 /******************************************************************************
@@ -636,8 +1336,48 @@ HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
 3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Added the packed bit plane masks option
+10/17/2026  USGS EROS        Added the compat_dilate option
+10/17/2026  USGS EROS        Dilate the cloud and shadow bits in one pass
+10/17/2026  USGS EROS        Use the label raster and packed object pixels
+                             of cloud_label instead of cloud nodes
+10/17/2026  USGS EROS        Label the cloud pixels with num_threads threads
+10/17/2026  USGS EROS        Size the object tables from the number of
+                             objects instead of MAX_CLOUD_TYPE
+10/17/2026  USGS EROS        Search the cloud object heights with
+                             num_threads threads
+10/17/2026  USGS EROS        Set up the shadow projection geometry once
+                             per scene
+10/17/2026  USGS EROS        Added the height_search option
+10/17/2026  USGS EROS        Added the perimeter_pixels option
+10/17/2026  USGS EROS        Give each height search thread a scratch
+                             arena for the object arrays
+10/17/2026  USGS EROS        Run the whole mask passes on restrict rows of
+                             a flat view of the pixel mask so they vectorize
+10/17/2026  USGS EROS        Use the fill bit plane of the input instead of
+                             packing the fill bits again
 
 NOTES: All variable names are same as in matlab code
+1. With bitplane_masks the cloud bits are packed into a bit plane and
+   counted with the fill bit plane of the input, and the calibration cloud
+   and shadow masks are bit planes instead of the byte cal_mask.  The
+   results are identical.
+2. The cloud labeling and the shadow height searches use up to num_threads
+   threads.  The results don't depend on the number of threads.
+3. height_search HEIGHT_SEARCH_COARSE searches the heights of large
+   objects on a sample of their pixels first, see coarse_height_search and
+   sample_object_pixels; it may give other shadows than the default
+   HEIGHT_SEARCH_FULL.
+   HEIGHT_SEARCH_COMPARE gives the same masks as HEIGHT_SEARCH_COARSE and
+   with verbose reports how closely the two searches agree.
+4. Objects of at least perimeter_pixels pixels are scored on their
+   perimeter and a sample of their interior, see perimeter_object_pixels,
+   which may also give other shadows.  0 scores every pixel of every
+   object.
+5. The arrays of each object are taken from a scratch arena of the thread
+   searching it, which is reset between objects.  The objects are searched
+   largest first, so the allocator is only called for the first objects of
+   each thread; with verbose the counts are reported.
 ******************************************************************************/
 int object_cloud_shadow_match
 (
@@ -648,7 +1388,14 @@ int object_cloud_shadow_match
     int cldpix,      /*I: cloud buffer size */
     int sdpix,       /*I: shadow buffer size */
     int max_cloud_pixels,       /*I: max cloud pixel number to divide cloud */
+    int num_threads,            /*I: maximum number of threads to use */
+    Height_search_t height_search, /*I: cloud base height search method */
+    int perimeter_pixels, /*I: min pixels of the objects scored on their
+                               perimeter, 0 for none */
     unsigned char **pixel_mask, /*I/O: pixel mask */
+    bool bitplane_masks, /*I: use packed bit planes for the matching masks */
+    bool compat_dilate,  /*I: keep the original border handling of the
+                              cloud and shadow dilation */
     bool verbose     /*I: value to indicate if intermediate messages
                           be printed */
 )
@@ -667,18 +1414,9 @@ int object_cloud_shadow_match
     int cloud_counter = 0;      /* cloud pixel counter */
     int boundary_counter = 0;   /* boundary pixel counter */
     float revised_ptm = 0.0;    /* revised percent of cloud */
-    float t_similar;            /* similarity threshold */
-    float t_buffer;             /* threshold for matching buffering */
-    float max_similar = 0.95;   /* max similarity threshold */
     int num_cldoj = 9;          /* minimum matched cloud object (pixels) */
-    int num_pix = 3;            /* number of inward pixes (240m) for cloud base
-                                   temperature */
     float a, b, c, omiga_par, omiga_per;  /* variables used for viewgeo
                                              routine, see it for detail */
-    float inv_a_b_distance;            /* Inverse of... */
-    float inv_cos_omiga_per_minus_par; /* Inverse of... */
-    float cos_omiga_par;
-    float sin_omiga_par;
     int i_step;                 /* ietration step */
     int x_ul = 0;               /* upper left column */
     int y_ul = 0;               /* upper left row */
@@ -689,41 +1427,31 @@ int object_cloud_shadow_match
     int x_ur = 0;               /* upper right column */
     int y_ur = 0;               /* upper right row */
     unsigned int *obj_num = NULL;       /* cloud object number */
-    cloud_node **cloud = NULL;  /* cloud node for all pixels */
-    unsigned int **cloud_first_node;    /* first cloud node */
+    Cloud_objects_t objects;    /* labeled cloud objects */
+    int **cloud = NULL;         /* cloud object number of all pixels */
+    unsigned int *cloud_first_pixel = NULL; /* packed index of the first
+                                               pixel of each object */
+    int num_clouds;             /* number of cloud objects labeled */
     int num;                    /* number */
     int counter = 0;            /* counter */
-    int16 **temp = NULL;        /* brightness temperature */
+    int16 *temp = NULL;         /* brightness temperature (whole scene,
+                                   shared with the input structure) */
     int cloud_type;             /* cloud type iterator */
-    int **xy_type;              /* intermediate variables */
-    int **tmp_xy_type;          /* intermediate variables */
-    float **tmp_xys;            /* intermediate variables */
-    int **orin_xys;             /* intermediate variables */
-    int16 *temp_obj;            /* temperature for each cloud */
-    int16 temp_obj_max = 0;     /* maximum temperature for each cloud */
-    int16 temp_obj_min = 0;     /* minimum temperature for each cloud */
-    int index;                  /* loop index */
-    float r_obj;                /* cloud radius */
-    float r_sqrd_obj;           /* cloud radius squared */
-    float pct_obj;              /* percent of edge pixels */
-    float t_obj;                /* cloud percentile value */
-    float inv_rate_elapse = 1.0/6.5; /* inverse wet air lapse rate */
-    float inv_rate_dlapse = 1.0/9.8; /* inverse dry air lapse rate */
-    int max_cl_height;          /* Max cloud base height (m) */
-    int min_cl_height;          /* Min cloud base height (m) */
-    int max_height;             /* refined maximum height (m) */
-    int min_height;             /* refined minimum height (m) */
-    float record_thresh;        /* record thresh value */
-    float *record_h;            /* record height value */
-    int base_h;                 /* cloud base height */
-    float *h;                   /* cloud height */
-    float i_xy;                 /* intermediate cloud height */
-    int out_all;                /* total number of pixels outdside boundary */
-    int match_all;              /* total number of matched pixels */
-    int total_all;              /* total number of pixels */
-    float thresh_match;         /* thresh match value */
     int i;
-    cloud_node *node;           /* temporary cloud node */
+    int pos;                    /* packed cloud pixel index */
+    Shadow_match_t match;       /* scene values for the height searches */
+    int num_objects;            /* cloud objects to search */
+    Object_size_t *object_sizes; /* size of each object to search */
+    int *order;                 /* objects in search order */
+    int next_object;            /* index in order of the next object */
+    int num_workers;            /* number of height search threads */
+    Shadow_worker_t *workers;   /* height search thread work */
+    Height_search_stats_t search_stats; /* agreement of the coarse and
+                                           full height searches */
+    Scratch_arena_t arena_totals; /* scratch arena counts of all the
+                                     height search threads */
+    pthread_t *threads;         /* height search threads */
+    bool *threaded;             /* was the search run in its own thread */
     int cloud_count = 0;        /* cloud counter */
     int shadow_count = 0;       /* shadow counter */
     float cloud_shadow_percent; /* cloud shadow percent */
@@ -732,22 +1460,58 @@ int object_cloud_shadow_match
     int number;                 /* loop variable */
     int total_num_clouds;       /* total number of clouds after
                                    large clouds division */
-    cloud_node *temp_node;      /* temporary cloud node */
+    int next_pos;               /* packed index of the next piece of a
+                                   divided cloud */
+    int piece_end;              /* packed index of the last pixel of the
+                                   last piece */
+    int last_pos;               /* packed index of the last pixel of the
+                                   divided cloud */
+    int iword;                  /* bit plane word index */
+    int ibit;                   /* bit index within a bit plane word */
+    uint64_t *cloud_row;        /* bit plane words of a cloud row */
+    const uint64_t *fill_row;   /* bit plane words of a fill row */
+    Raster_view_t mask_view;    /* flat view of the pixel mask */
 
     /* Dynamic memory allocation */
     unsigned char **cal_mask = NULL;    /* calibration pixel mask */
+    const Bitplane_t *fill_plane = input->fill_plane; /* packed fill
+                                           pixels, shared with the input */
+    Bitplane_t *cloud_plane = NULL;     /* packed cloud pixels, then the
+                                           calibration cloud pixels */
+    Bitplane_t *cal_shadow = NULL;      /* calibration shadow pixels */
+    Bitplane_t *dilated = NULL;         /* dilated calibration pixels */
+    int dilate_radius[DILATE_MAX_BITS] = {0}; /* buffer of each mask bit */
 
     printf("CURRENT TIME %ld\n", time(NULL));
 
-    cal_mask = (unsigned char **) allocate_2d_array (input->size.l,
-                                                     input->size.s,
-                                                     sizeof (unsigned char));
-    if (cal_mask == NULL)
+    if (get_2d_array_view ((void **) pixel_mask, &mask_view) != SUCCESS)
     {
-        sprintf (errstr, "Allocating cal_mask memory");
+        sprintf (errstr, "Getting the pixel mask view");
         RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
     }
 
+    if (bitplane_masks)
+    {
+        cloud_plane = create_bitplane (nrows, ncols);
+        cal_shadow = create_bitplane (nrows, ncols);
+        dilated = create_bitplane (nrows, ncols);
+        if (cloud_plane == NULL || cal_shadow == NULL || dilated == NULL)
+        {
+            sprintf (errstr, "Allocating bit plane memory");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+        }
+    }
+    else
+    {
+        cal_mask = (unsigned char **) allocate_2d_array (nrows, ncols,
+            sizeof (unsigned char));
+        if (cal_mask == NULL)
+        {
+            sprintf (errstr, "Allocating cal_mask memory");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+        }
+    }
+
     /* Read in potential mask ... */
     /* Solar elevation angle */
     sun_ele = 90 - input->meta.sun_zen;
@@ -757,16 +1521,27 @@ int object_cloud_shadow_match
     sun_tazi = input->meta.sun_az - 90;
     sun_tazi_rad = (PI / 180.0) * sun_tazi;
 
-    for (row = 0; row < nrows; row++)
+    if (bitplane_masks)
     {
-        for (col = 0; col < ncols; col++)
+        pack_bitplane (pixel_mask, CLOUD_BIT, cloud_plane);
+        cloud_counter = count_bitplane (cloud_plane);
+
+        /* Boundary layer includes both cloud_mask equals 0 and 1 */
+        boundary_counter = nrows * ncols - count_bitplane (fill_plane);
+    }
+    else
+    {
+        for (row = 0; row < nrows; row++)
         {
-            if (pixel_mask[row][col] & (1 << CLOUD_BIT))
-                cloud_counter++;
+            const unsigned char *restrict mask_row =
+                RASTER_ROW (&mask_view, unsigned char, row);
+            for (col = 0; col < ncols; col++)
+            {
+                cloud_counter += (mask_row[col] & (1 << CLOUD_BIT)) != 0;
 
-            /* Boundary layer includes both cloud_mask equals 0 and 1 */
-            if (!(pixel_mask[row][col] & (1 << FILL_BIT)))
-                boundary_counter++;
+                /* Boundary layer includes both cloud_mask equals 0 and 1 */
+                boundary_counter += (mask_row[col] & (1 << FILL_BIT)) == 0;
+            }
         }
     }
 
@@ -789,13 +1564,15 @@ int object_cloud_shadow_match
     {
         for (row = 0; row < nrows; row++)
         {
+            unsigned char *restrict mask_row =
+                RASTER_ROW (&mask_view, unsigned char, row);
             for (col = 0; col < ncols; col++)
             {
                 /* No Shadow Match due to too much cloud (>90 percent)
                    non-cloud pixels are just shadow pixels */
-                if (!(pixel_mask[row][col] & (1 << CLOUD_BIT)) &&
-                    (!(pixel_mask[row][col] & (1 << FILL_BIT))))
-                    pixel_mask[row][col] |= 1 << SHADOW_BIT;
+                mask_row[col] |= (mask_row[col]
+                                  & ((1 << CLOUD_BIT) | (1 << FILL_BIT)))
+                                 ? 0 : 1 << SHADOW_BIT;
             }
         }
     }
@@ -878,44 +1655,21 @@ int object_cloud_shadow_match
         viewgeo (x_ul, y_ul, x_ur, y_ur, x_ll, y_ll, x_lr, y_lr, &a, &b, &c,
                  &omiga_par, &omiga_per);
 
-        /* These don't change so calculate them here */
-        inv_a_b_distance = 1 / sqrt (a * a + b * b);
-        inv_cos_omiga_per_minus_par = 1 / cos (omiga_per - omiga_par);
-        cos_omiga_par = cos (omiga_par);
-        sin_omiga_par = sin (omiga_par);
-
-        /* Allocate memory for segment cloud portion */
-        obj_num =
-            (unsigned int *) calloc (MAX_CLOUD_TYPE, sizeof (unsigned int));
-        cloud =
-            (cloud_node **) allocate_2d_array (nrows, ncols,
-                                               sizeof (cloud_node));
-        cloud_first_node =
-            (unsigned int **) allocate_2d_array (2, MAX_CLOUD_TYPE,
-                                                 sizeof (unsigned int));
-        if (obj_num == NULL || cloud == NULL || cloud_first_node == NULL)
-        {
-            sprintf (errstr, "Allocating memory");
-            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
-        }
+        printf("CURRENT TIME %ld\n", time(NULL));
 
-        /* Initialize the cloud nodes */
-        for (row = 0; row < nrows; row++)
+        /* Labeling the cloud pixels; dividing large clouds needs the pixel
+           order of the serial labeling */
+        status = label (pixel_mask, nrows, ncols,
+                        (max_cloud_pixels > 0) ? 1 : num_threads, &objects);
+        if (status != SUCCESS)
         {
-            for (col = 0; col < ncols; col++)
-            {
-                cloud[row][col].value = 0;
-                cloud[row][col].row = 0;
-                cloud[row][col].col = 0;
-                cloud[row][col].parent = &cloud[row][col];
-                cloud[row][col].child = &cloud[row][col];
-            }
+            sprintf (errstr, "Labeling cloud pixels");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
         }
-
-        printf("CURRENT TIME %ld\n", time(NULL));
-
-        /* Labeling the cloud pixels */
-        label (pixel_mask, nrows, ncols, cloud, obj_num, cloud_first_node);
+        cloud = objects.label;
+        num_clouds = objects.num_clouds;
+        obj_num = objects.obj_num;
+        cloud_first_pixel = objects.obj_first;
 
         printf("CURRENT TIME %ld\n", time(NULL));
 
@@ -931,47 +1685,45 @@ int object_cloud_shadow_match
 
             if ((max_cloud_pixels > 0) && (obj_num[num] > max_cloud_pixels))
             {
+                /* The pieces are runs of the packed pixels of the cloud.
+                   As in the original code, the first piece keeps
+                   max_cloud_pixels + 1 pixels, and a piece which reaches
+                   the end of the piece before it or of the cloud with
+                   fewer than max_cloud_pixels pixels is taken again by the
+                   next piece. */
                 extra_clouds = (int) (obj_num[num] / max_cloud_pixels);
-                node =
-                    &cloud[cloud_first_node[0][num]][cloud_first_node[1]
-                                                     [num]];
-                obj_num[num] = max_cloud_pixels;
-                int i;
-                for (i = 0; i < max_cloud_pixels; i++)
-                    node = node->child;
-                temp_node = node->child;
-                node->child = node;
+                last_pos = cloud_first_pixel[num] + obj_num[num] - 1;
+                piece_end = cloud_first_pixel[num] + max_cloud_pixels;
+                obj_num[num] = max_cloud_pixels + 1;
+                next_pos = (piece_end < last_pos) ? piece_end + 1 : piece_end;
                 for (number = 1; number <= extra_clouds; number++)
                 {
                     total_num_clouds++;
-                    node = temp_node;
-                    cloud_first_node[0][total_num_clouds] = node->row;
-                    cloud_first_node[1][total_num_clouds] = node->col;
-                    for (i = 0; i < max_cloud_pixels; i++)
+                    if (grow_cloud_objects (&objects, total_num_clouds + 1)
+                        != SUCCESS)
                     {
-                        if (node->child != node)
-                        {
-                            node->value = total_num_clouds;
-                            node->parent =
-                                &cloud[cloud_first_node[0][total_num_clouds]]
-                                [cloud_first_node[1][total_num_clouds]];
-                            obj_num[total_num_clouds]++;
-                            if (i == max_cloud_pixels - 1)
-                            {
-                                temp_node = node->child;
-                                node->child = node;
-                            }
-                            else
-                                node = node->child;
-                        }
-                        else
-                        {
-                            node->value = total_num_clouds;
-                            node->parent =
-                                &cloud[cloud_first_node[0][total_num_clouds]]
-                                [cloud_first_node[1][total_num_clouds]];
-                            obj_num[total_num_clouds]++;
-                        }
+                        sprintf (errstr, "Growing cloud object tables");
+                        RETURN_ERROR (errstr, "cloud/shadow match",
+                                      FAILURE);
+                    }
+                    obj_num = objects.obj_num;
+                    cloud_first_pixel = objects.obj_first;
+
+                    pos = next_pos;
+                    if (pos > piece_end)
+                        piece_end = last_pos;
+                    if (piece_end - pos >= max_cloud_pixels)
+                    {
+                        piece_end = pos + max_cloud_pixels - 1;
+                        next_pos = piece_end + 1;
+                    }
+                    cloud_first_pixel[total_num_clouds] = pos;
+                    obj_num[total_num_clouds] = piece_end - pos + 1;
+                    for (; pos <= piece_end; pos++)
+                    {
+                        cloud[CLOUD_PIXEL_ROW (objects, pos)]
+                            [CLOUD_PIXEL_COL (objects, pos)] =
+                            total_num_clouds;
                     }
                 }
             }
@@ -981,424 +1733,303 @@ int object_cloud_shadow_match
             printf ("Num of real clouds = %d\n", counter);
 
         /* Cloud_cal pixels are cloud_mask pixels with < 9 pixels removed */
-        for (row = 0; row < nrows; row++)
+        if (bitplane_masks)
         {
-            for (col = 0; col < ncols; col++)
+            /* Only the words holding non-fill cloud pixels are looked at */
+            for (row = 0; row < nrows; row++)
             {
-                /* Has not been used yet, so initialize it first */
-                cal_mask[row][col] = MASK_CLEAR_LAND;
-                if ((pixel_mask[row][col] & (1 << CLOUD_BIT))
-                    && (!(pixel_mask[row][col] & (1 << FILL_BIT)))
-                    && (obj_num[cloud[row][col].value] != 0))
+                cloud_row = BITPLANE_ROW (cloud_plane, row);
+                fill_row = BITPLANE_ROW (fill_plane, row);
+                for (iword = 0; iword < cloud_plane->words_per_row; iword++)
                 {
-                    cal_mask[row][col] |= 1 << CLOUD_BIT;
+                    cloud_row[iword] &= ~fill_row[iword];
+                    if (cloud_row[iword] == 0)
+                        continue;
+                    for (ibit = 0; ibit < BITPLANE_WORD_BITS; ibit++)
+                    {
+                        col = iword * BITPLANE_WORD_BITS + ibit;
+                        if (((cloud_row[iword] >> ibit) & 1)
+                            && obj_num[cloud[row][col]] == 0)
+                        {
+                            cloud_row[iword] &= ~((uint64_t) 1 << ibit);
+                        }
+                    }
                 }
             }
         }
-
-        /* Need to read out whole image brightness temperature for band 6 */
-        temp = (int16 **) allocate_2d_array (input->size.l,
-                                             input->size.s, sizeof (int16));
-        if (temp == NULL)
-        {
-            sprintf (errstr, "Allocating temp memory");
-            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
-        }
-
-        /* Read out thermal band in 2d */
-        for (row = 0; row < nrows; row++)
+        else
         {
-            if (!GetInputThermLine (input, row))
+            for (row = 0; row < nrows; row++)
             {
-                sprintf (errstr, "Reading input thermal data for line %d",
-                         row);
-                RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+                for (col = 0; col < ncols; col++)
+                {
+                    /* Has not been used yet, so initialize it first */
+                    cal_mask[row][col] = MASK_CLEAR_LAND;
+                    if ((pixel_mask[row][col] & (1 << CLOUD_BIT))
+                        && (!(pixel_mask[row][col] & (1 << FILL_BIT)))
+                        && (obj_num[cloud[row][col]] != 0))
+                    {
+                        cal_mask[row][col] |= 1 << CLOUD_BIT;
+                    }
+                }
             }
-            memcpy (&temp[row][0], &input->therm_buf[0],
-                    input->size.s * sizeof (int16));
         }
 
+        /* Use the whole image brightness temperature for band 6, which was
+           converted to Celsius when the input was opened */
+        temp = input->therm_scene_buf;
+
         /* Use iteration to get the optimal move distance, Calulate the
-           moving cloud shadow */
+           moving cloud shadow.  The objects are independent, so they are
+           searched by up to num_threads threads, largest first so a large
+           object taken late doesn't keep one thread busy after the rest
+           are done.  Each thread marks its shadow pixels in its own bit
+           plane, which are ORed into the calibration shadow at the end. */
+        match.input = input;
+        match.nrows = nrows;
+        match.ncols = ncols;
+        match.pixel_mask = pixel_mask;
+        match.temp = temp;
+        match.objects = &objects;
+        match.t_templ = t_templ;
+        match.t_temph = t_temph;
+        match.boundary_counter = boundary_counter;
+        match.i_step = i_step;
+        init_shadow_geometry (a, b, c, omiga_par, omiga_per, sub_size,
+                              sun_ele_rad, sun_tazi_rad, input->meta.sun_az,
+                              &match.geometry);
+        match.height_search = height_search;
+        match.perimeter_pixels = perimeter_pixels;
+        match.num_clouds = num_clouds;
+        match.max_cloud_pixels = max_cloud_pixels;
+
+        num_objects = 0;
+        for (cloud_type = 1; cloud_type <= total_num_clouds; cloud_type++)
+        {
+            if (obj_num[cloud_type] != 0)
+                num_objects++;
+        }
+        num_workers = (num_threads < num_objects) ? num_threads : num_objects;
+#ifndef NEXT_OBJECT
+        num_workers = 1;
+#endif
+        if (num_workers < 1)
+            num_workers = 1;
+
+        object_sizes = malloc ((num_objects + 1) * sizeof (Object_size_t));
+        order = malloc ((num_objects + 1) * sizeof (int));
+        workers = calloc (num_workers, sizeof (Shadow_worker_t));
+        threads = malloc (num_workers * sizeof (pthread_t));
+        threaded = calloc (num_workers, sizeof (bool));
+        if (object_sizes == NULL || order == NULL || workers == NULL
+            || threads == NULL || threaded == NULL)
+        {
+            sprintf (errstr, "Allocating height search memory");
+            RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+        }
+
+        num_objects = 0;
         for (cloud_type = 1; cloud_type <= total_num_clouds; cloud_type++)
         {
             if (obj_num[cloud_type] == 0)
                 continue;
+            object_sizes[num_objects].size = obj_num[cloud_type];
+            object_sizes[num_objects].number = cloud_type;
+            num_objects++;
+        }
+        qsort (object_sizes, num_objects, sizeof (Object_size_t),
+               compare_object_size);
+        for (i = 0; i < num_objects; i++)
+            order[i] = object_sizes[i].number;
+        free (object_sizes);
+
+        next_object = 0;
+        for (i = 0; i < num_workers; i++)
+        {
+            workers[i].match = &match;
+            workers[i].order = order;
+            workers[i].num_objects = num_objects;
+            workers[i].next_object = &next_object;
+            init_scratch_arena (&workers[i].arena);
+            if (num_workers == 1)
+            {
+                workers[i].shadow_plane = cal_shadow;
+                workers[i].shadow_mask = cal_mask;
+            }
             else
             {
-                /* Update in Fmask v3.3, for larger (> 10% scene area), use
-                   another set of t_similar and t_buffer to address some
-                   missing cloud shadow at edge area */
-                if (obj_num[cloud_type] <= (int) (0.1 * boundary_counter))
-                {
-                    t_similar = 0.3;
-                    t_buffer = 0.95;
-                }
-                else
-                {
-                    t_similar = 0.1;
-                    t_buffer = 0.98;
-                }
-
-                /* Note: matlab array index starts with 1 and C starts with 0,
-                   array(3,1) in matlab is equal to array[2][0] in C */
-                min_cl_height = 200;
-                max_cl_height = 12000;
-                xy_type = (int **) allocate_2d_array (2,
-                                                      obj_num[cloud_type],
-                                                      sizeof (int));
-                tmp_xy_type =
-                    (int **) allocate_2d_array (2, obj_num[cloud_type],
-                                                sizeof (int));
-                /* corrected for view angle xys */
-                tmp_xys = (float **) allocate_2d_array (2,
-                                                        obj_num[cloud_type],
-                                                        sizeof (float));
-                /* record the original xys */
-                orin_xys = (int **) allocate_2d_array (2,
-                                                       obj_num[cloud_type],
-                                                       sizeof (int));
-                if (xy_type == NULL || tmp_xy_type == NULL || tmp_xys == NULL
-                    || orin_xys == NULL)
-                {
-                    sprintf (errstr, "Allocating cloud memory");
-                    RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
-                }
-
-                /* Temperature of the cloud object */
-                temp_obj = malloc (obj_num[cloud_type] * sizeof (int16));
-                if (temp_obj == NULL)
-                {
-                    sprintf (errstr, "Allocating temp_obj memory");
-                    RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
-                }
-
-                temp_obj_max = SHRT_MIN;
-                temp_obj_min = SHRT_MAX;
-                index = 0;
-                node = &cloud[cloud_first_node[0][cloud_type]]
-                    [cloud_first_node[1][cloud_type]];
-                while (node->child != node)
-                {
-                    temp_obj[index] = temp[node->row][node->col];
-                    if (temp_obj[index] > temp_obj_max)
-                        temp_obj_max = temp_obj[index];
-                    if (temp_obj[index] < temp_obj_min)
-                        temp_obj_min = temp_obj[index];
-                    orin_xys[0][index] = node->col;
-                    orin_xys[1][index] = node->row;
-                    index++;
-                    node = node->child;
-                }
-                temp_obj[index] = temp[node->row][node->col];
-                if (temp_obj[index] > temp_obj_max)
-                    temp_obj_max = temp_obj[index];
-                if (temp_obj[index] < temp_obj_min)
-                    temp_obj_min = temp_obj[index];
-                orin_xys[0][index] = node->col;
-                orin_xys[1][index] = node->row;
-                index++;
-                obj_num[cloud_type] = index;
-
-                /* the base temperature for cloud
-                   assume object is round r_obj is radium of object */
-                r_sqrd_obj = ((float) obj_num[cloud_type] / (2.0 * PI));
-                r_obj = sqrt (r_sqrd_obj);
-
-                /* number of inward pixels for correct temperature */
-                pct_obj = ((r_obj - (float) num_pix)
-                           * (r_obj - (float) num_pix)) / r_sqrd_obj;
-                if ((pct_obj - 1.0) >= MINSIGMA)
-                {
-                    /* Use the minimum temperature instead */
-                    t_obj = temp_obj_min;
-                }
-                else
-                {
-                    status = prctile (temp_obj, obj_num[cloud_type],
-                                      temp_obj_min, temp_obj_max,
-                                      100.0 * pct_obj, &t_obj);
-                    if (status != SUCCESS)
-                    {
-                        RETURN_ERROR ("Error calling prctile",
-                                      "cloud/shadow match", FAILURE);
-                    }
-                }
-
-                /* refine cloud height range (m) */
-                min_height =
-                    (int) rint (10.0 * (t_templ - t_obj) * inv_rate_dlapse);
-                max_height = (int) rint (10.0 * (t_temph - t_obj));
-                if (min_cl_height < min_height)
-                    min_cl_height = min_height;
-                if (max_cl_height > max_height)
-                    max_cl_height = max_height;
-
-                /* put the edge of the cloud the same value as t_obj */
-                for (i = 0; i < obj_num[cloud_type]; i++)
-                {
-                    if (temp_obj[i] > rint (t_obj))
-                        temp_obj[i] = rint (t_obj);
-                }
-
-                /* Allocate memory for h and record_h */
-                h = malloc (obj_num[cloud_type] * sizeof (float));
-                record_h = calloc (obj_num[cloud_type], sizeof (float));
-                if (h == NULL || record_h == NULL)
+                workers[i].shadow_plane = create_bitplane (nrows, ncols);
+                if (workers[i].shadow_plane == NULL)
                 {
-                    sprintf (errstr, "Allocating h memory");
+                    sprintf (errstr, "Allocating shadow bit plane");
                     RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
                 }
+            }
+        }
 
-                /* initialize height and similarity info */
-                record_thresh = 0.0;
-                for (base_h = min_cl_height; base_h <= max_cl_height;
-                     base_h += i_step)
-                {
-                    for (i = 0; i < obj_num[cloud_type]; i++)
-                    {
-                        h[i] = (10.0 * (t_obj - (float) temp_obj[i]))
-                               * inv_rate_elapse + (float) base_h;
-                    }
-
-                    /* Get the true postion of the cloud
-                       calculate cloud DEM with initial base height */
-                    mat_truecloud (orin_xys[0], orin_xys[1],
-                                   obj_num[cloud_type], h, a, b, c,
-                                   inv_a_b_distance,
-                                   inv_cos_omiga_per_minus_par,
-                                   cos_omiga_par, sin_omiga_par,
-                                   tmp_xys[0], tmp_xys[1]);
-
-                    out_all = 0;
-                    match_all = 0;
-                    total_all = 0;
-                    for (i = 0; i < obj_num[cloud_type]; i++)
-                    {
-                        i_xy = h[i] / ((float) sub_size * tan (sun_ele_rad));
-                        /* The check here can assume to handle the south up
-                           north down scene case correctly as azimuth angle
-                           needs to be added by 180.0 degree */
-                        if ((input->meta.sun_az - 180.0) < MINSIGMA)
-                        {
-                            xy_type[1][i] =
-                                rint (tmp_xys[0][i] -
-                                      i_xy * cos (sun_tazi_rad));
-                            xy_type[0][i] =
-                                rint (tmp_xys[1][i] -
-                                      i_xy * sin (sun_tazi_rad));
-                        }
-                        else
-                        {
-                            xy_type[1][i] =
-                                rint (tmp_xys[0][i] +
-                                      i_xy * cos (sun_tazi_rad));
-                            xy_type[0][i] =
-                                rint (tmp_xys[1][i] +
-                                      i_xy * sin (sun_tazi_rad));
-                        }
-
-                        /* the id that is out of the image */
-                        if (xy_type[0][i] < 0 || xy_type[0][i] >= nrows
-                            || xy_type[1][i] < 0 || xy_type[1][i] >= ncols)
-                        {
-                            out_all++;
-                        }
-                        else
-                        {
-                            if ((pixel_mask[xy_type[0][i]][xy_type[1][i]] &
-                                 (1 << FILL_BIT))
-                                || (cloud[xy_type[0][i]][xy_type[1][i]].
-                                    value != cloud_type
-                                    &&
-                                    (((pixel_mask[xy_type[0][i]]
-                                       [xy_type[1][i]] & (1 << CLOUD_BIT))
-                                      ||
-                                      (pixel_mask[xy_type[0][i]]
-                                       [xy_type[1][i]] & (1 << FILL_BIT)))
-                                     ||
-                                     (pixel_mask[xy_type[0][i]][xy_type[1][i]]
-                                      & (1 << SHADOW_BIT)))))
-                            {
-                                match_all++;
-                            }
-                            if (cloud[xy_type[0][i]][xy_type[1][i]].value !=
-                                cloud_type)
-                            {
-                                total_all++;
-                            }
-                        }
-                    }
-                    match_all += out_all;
-                    total_all += out_all;
+        for (i = 1; i < num_workers; i++)
+        {
+            if (pthread_create (&threads[i], NULL, shadow_worker_thread,
+                                &workers[i]) == 0)
+                threaded[i] = true;
+            else if (verbose)
+                printf ("Unable to start height search thread %d\n", i);
+        }
+        shadow_worker_thread (&workers[0]);
+        for (i = 1; i < num_workers; i++)
+        {
+            if (!threaded[i])
+                shadow_worker_thread (&workers[i]);
+            else if (pthread_join (threads[i], NULL) != 0)
+            {
+                sprintf (errstr, "Joining height search thread\n");
+                RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
+            }
+        }
 
-                    thresh_match = (float) match_all / (float) total_all;
-                    if (((thresh_match - t_buffer * record_thresh) >=
-                         MINSIGMA) && (base_h < max_cl_height - i_step)
-                        && ((record_thresh - max_similar) < MINSIGMA))
-                    {
-                        if ((thresh_match - record_thresh) > MINSIGMA)
-                        {
-                            record_thresh = thresh_match;
-                            for (i = 0; i < obj_num[cloud_type]; i++)
-                                record_h[i] = h[i];
-                        }
-                    }
-                    else if ((record_thresh - t_similar) > MINSIGMA)
-                    {
-                        float i_vir;
-                        for (i = 0; i < obj_num[cloud_type]; i++)
-                        {
-                            i_vir = record_h[i] /
-                                ((float) sub_size * tan (sun_ele_rad));
-                            /* The check here can assume to handle the south
-                               up north down scene case correctly as azimuth
-                               angle needs to be added by 180.0 degree */
-                            if ((input->meta.sun_az - 180.0) < MINSIGMA)
-                            {
-                                tmp_xy_type[1][i] = rint (tmp_xys[0][i] -
-                                                          i_vir *
-                                                          cos (sun_tazi_rad));
-                                tmp_xy_type[0][i] =
-                                    rint (tmp_xys[1][i] -
-                                          i_vir * sin (sun_tazi_rad));
-                            }
-                            else
-                            {
-                                tmp_xy_type[1][i] = rint (tmp_xys[0][i] +
-                                                          i_vir *
-                                                          cos (sun_tazi_rad));
-                                tmp_xy_type[0][i] =
-                                    rint (tmp_xys[1][i] +
-                                          i_vir * sin (sun_tazi_rad));
-                            }
-
-                            /* put data within range */
-                            if (tmp_xy_type[0][i] < 0)
-                                tmp_xy_type[0][i] = 0;
-                            if (tmp_xy_type[0][i] >= nrows)
-                                tmp_xy_type[0][i] = nrows - 1;
-                            if (tmp_xy_type[1][i] < 0)
-                                tmp_xy_type[1][i] = 0;
-                            if (tmp_xy_type[1][i] >= ncols)
-                                tmp_xy_type[1][i] = ncols - 1;
-                            {
-                                cal_mask[tmp_xy_type[0][i]][tmp_xy_type[1][i]]
-                                    |= 1 << SHADOW_BIT;
-                            }
-                        }
-                        break;
-                    }
-                    else
-                    {
-                        record_thresh = 0.0;
-                        continue;
-                    }
-                }
-                free (h);
-                free (record_h);
-                h = NULL;
-                record_h = NULL;
-
-                /* Free all the memory */
-                status = free_2d_array ((void **) xy_type);
-                if (status != SUCCESS)
-                {
-                    sprintf (errstr, "Freeing memory: xy_type\n");
-                    RETURN_ERROR (errstr, "pcloud", FAILURE);
-                }
-                status = free_2d_array ((void **) tmp_xys);
-                if (status != SUCCESS)
-                {
-                    sprintf (errstr, "Freeing memory: tmp_xys\n");
-                    RETURN_ERROR (errstr, "pcloud", FAILURE);
-                }
-                status = free_2d_array ((void **) tmp_xy_type);
-                if (status != SUCCESS)
-                {
-                    sprintf (errstr, "Freeing memory: tmp_xy_type\n");
-                    RETURN_ERROR (errstr, "pcloud", FAILURE);
-                }
-                status = free_2d_array ((void **) orin_xys);
-                if (status != SUCCESS)
-                {
-                    sprintf (errstr, "Freeing memory: orin_xys\n");
-                    RETURN_ERROR (errstr, "pcloud", FAILURE);
-                }
-                free (temp_obj);
-                temp_obj = NULL;
+        memset (&search_stats, 0, sizeof (Height_search_stats_t));
+        init_scratch_arena (&arena_totals);
+        for (i = 0; i < num_workers; i++)
+        {
+            if (workers[i].status != SUCCESS)
+            {
+                sprintf (errstr, "Searching cloud heights");
+                RETURN_ERROR (errstr, "cloud/shadow match", FAILURE);
             }
+            search_stats.objects += workers[i].stats.objects;
+            search_stats.same_height += workers[i].stats.same_height;
+            search_stats.near_height += workers[i].stats.near_height;
+            search_stats.shadow_differs += workers[i].stats.shadow_differs;
+            search_stats.pixels += workers[i].stats.pixels;
+            search_stats.same_pixels += workers[i].stats.same_pixels;
+            search_stats.coarse_projections +=
+                workers[i].stats.coarse_projections;
+            search_stats.full_projections +=
+                workers[i].stats.full_projections;
+            arena_totals.allocs += workers[i].arena.allocs;
+            arena_totals.system_allocs += workers[i].arena.system_allocs;
+            arena_totals.system_seconds += workers[i].arena.system_seconds;
+            if (num_workers == 1)
+                continue;
+            if (bitplane_masks)
+                or_bitplane (workers[i].shadow_plane, cal_shadow);
+            else
+                or_unpack_bitplane (workers[i].shadow_plane, SHADOW_BIT,
+                                    cal_mask);
+            free_bitplane (workers[i].shadow_plane);
         }
-        free (obj_num);
-        obj_num = NULL;
-        status = free_2d_array ((void **) temp);
-        if (status != SUCCESS)
+        if (verbose && height_search == HEIGHT_SEARCH_COMPARE)
         {
-            sprintf (errstr, "Freeing memory: temp\n");
-            RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
+            printf ("Coarse height search of %d objects: %d at the same"
+                    " base height, %d within %d steps, %d with a shadow"
+                    " from only one search\n", search_stats.objects,
+                    search_stats.same_height, search_stats.near_height,
+                    COARSE_STEP_FACTOR, search_stats.shadow_differs);
+            printf ("Coarse height search: %ld of %ld shadow pixels in the"
+                    " same place, %ld pixel projections against %ld for"
+                    " the full search\n", search_stats.same_pixels,
+                    search_stats.pixels, search_stats.coarse_projections,
+                    search_stats.full_projections);
         }
-        status = free_2d_array ((void **) cloud);
-        if (status != SUCCESS)
+        if (verbose)
         {
-            sprintf (errstr, "Freeing memory: cloud\n");
-            RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
+            printf ("Height search arrays: %ld taken from the scratch"
+                    " arenas, %ld allocator calls taking %.6f seconds\n",
+                    arena_totals.allocs, arena_totals.system_allocs,
+                    arena_totals.system_seconds);
         }
-        status = free_2d_array ((void **) cloud_first_node);
+        free (order);
+        free (workers);
+        free (threads);
+        free (threaded);
+        status = free_cloud_objects (&objects);
         if (status != SUCCESS)
         {
-            sprintf (errstr, "Freeing memory: cloud_first_node\n");
+            sprintf (errstr, "Freeing memory: cloud objects\n");
             RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
         }
+        cloud = NULL;
+        obj_num = NULL;
+        cloud_first_pixel = NULL;
 
         /* Do image dilate for cloud, shadow, snow */
-        image_dilate (cal_mask, nrows, ncols, cldpix, CLOUD_BIT, pixel_mask);
+        if (bitplane_masks)
+        {
+            status = dilate_bitplane (cloud_plane, cldpix, compat_dilate,
+                                      dilated);
+            if (status != SUCCESS)
+            {
+                sprintf (errstr, "Dilating the cloud bit plane");
+                RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
+            }
+            unpack_bitplane (dilated, CLOUD_BIT, pixel_mask);
 
-        image_dilate (cal_mask, nrows, ncols, sdpix, SHADOW_BIT, pixel_mask);
+            status = dilate_bitplane (cal_shadow, sdpix, compat_dilate,
+                                      dilated);
+            if (status != SUCCESS)
+            {
+                sprintf (errstr, "Dilating the shadow bit plane");
+                RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
+            }
+            unpack_bitplane (dilated, SHADOW_BIT, pixel_mask);
+        }
+        else
+        {
+            /* Both bits are dilated in one pass over cal_mask */
+            dilate_radius[CLOUD_BIT] = cldpix;
+            dilate_radius[SHADOW_BIT] = sdpix;
+            status = image_dilate (cal_mask, nrows, ncols,
+                                   (1 << CLOUD_BIT) | (1 << SHADOW_BIT),
+                                   dilate_radius, compat_dilate, pixel_mask);
+            if (status != SUCCESS)
+            {
+                sprintf (errstr, "Dilating the cloud and shadow masks");
+                RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
+            }
+        }
     }
 
     /* Use cal_mask as the output mask, and cal_mask is changed to be a value
-       mask */
+       mask.  The value is chosen from the lowest priority bit up so each
+       pixel is a chain of selects rather than branches. */
     for (row = 0; row < nrows; row++)
     {
+        unsigned char *restrict mask_row =
+            RASTER_ROW (&mask_view, unsigned char, row);
         for (col = 0; col < ncols; col++)
         {
-            if (pixel_mask[row][col] & (1 << FILL_BIT))
-            {
-                pixel_mask[row][col] = FILL_VALUE;
-            }
-            else if (pixel_mask[row][col] & (1 << CLOUD_BIT))
-            {
-                pixel_mask[row][col] = MASK_CLOUD;
-                cloud_count++;
-            }
-            else if (pixel_mask[row][col] & (1 << SHADOW_BIT))
-            {
-                pixel_mask[row][col] = MASK_CLOUD_SHADOW;
-                shadow_count++;
-            }
-            else if (pixel_mask[row][col] & (1 << SNOW_BIT))
-            {
-                pixel_mask[row][col] = MASK_CLEAR_SNOW;
-            }
-            else if (pixel_mask[row][col] & (1 << WATER_BIT))
-            {
-                pixel_mask[row][col] = MASK_CLEAR_WATER;
-            }
-            else
-            {
-                pixel_mask[row][col] = MASK_CLEAR_LAND;
-            }
+            unsigned char bits = mask_row[col];
+            unsigned char value = MASK_CLEAR_LAND;
+
+            value = (bits & (1 << WATER_BIT)) ? MASK_CLEAR_WATER : value;
+            value = (bits & (1 << SNOW_BIT)) ? MASK_CLEAR_SNOW : value;
+            value = (bits & (1 << SHADOW_BIT)) ? MASK_CLOUD_SHADOW : value;
+            value = (bits & (1 << CLOUD_BIT)) ? MASK_CLOUD : value;
+            value = (bits & (1 << FILL_BIT)) ? FILL_VALUE : value;
+            mask_row[col] = value;
+
+            cloud_count += value == MASK_CLOUD;
+            shadow_count += value == MASK_CLOUD_SHADOW;
         }
     }
 
     printf("CURRENT TIME %ld\n", time(NULL));
 
     /* Release the memory */
-    status = free_2d_array ((void **) cal_mask);
-    if (status != SUCCESS)
+    if (bitplane_masks)
+    {
+        free_bitplane (cloud_plane);
+        free_bitplane (cal_shadow);
+        free_bitplane (dilated);
+    }
+    else
     {
-        sprintf (errstr, "Freeing memory: cal_mask\n");
-        RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
+        status = free_2d_array ((void **) cal_mask);
+        if (status != SUCCESS)
+        {
+            sprintf (errstr, "Freeing memory: cal_mask\n");
+            RETURN_ERROR (errstr, "object_cloud_shadow_match", FAILURE);
+        }
     }
 
     if (verbose)
@@ -1,6 +1,8 @@
 
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #include "espa_geoloc.h"
 
@@ -9,7 +11,241 @@
 #include "cfmask.h"
 #include "2d_array.h"
 #include "input.h"
+#include "fill_minima.h"
+#include "spectral_tests.h"
+#include "histogram.h"
 
+/* Quantized probabilities are the probability times PROB_QUANTUM_SCALE
+   rounded to an int16, so they are within half a quantum of it */
+#define PROB_QUANTUM_SCALE 64.0
+
+/* Probability level of a pixel which can't be told from its quantized
+   probability */
+#define PROB_LEVEL_UNKNOWN -1
+
+/******************************************************************************
+MODULE:  cloud_probability
+
+PURPOSE: Calculate the cloud probability of a pixel over water or land
+
+RETURN: Cloud probability
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Moved out of potential_cloud_shadow_snow_mask
+                             so the pass comparing the probabilities can
+                             calculate them again
+10/17/2026  USGS EROS        Take the fill test result from the caller
+
+NOTES:
+1. The saturated values of the lines read are set to the maximum values by
+   GetInputLine and GetInputThermLine.
+******************************************************************************/
+static float cloud_probability
+(
+    const Input_t *input,  /* I: input structure with the lines read */
+    int col,               /* I: column of the pixel */
+    bool fill,             /* I: is the pixel fill? */
+    bool water,            /* I: is the pixel water? */
+    float t_wtemp,         /* I: high percentile water temperature */
+    float t_temph,         /* I: percentile of high background temp */
+    float temp_l           /* I: difference of low/high tempearture
+                                 percentiles */
+)
+{
+    float ndvi, ndsi;           /* NDVI and NDSI values */
+    float visi_mean;            /* mean of visible bands */
+    float whiteness = 0.0;      /* whiteness value */
+    float wtemp_prob;           /* water temperature probability value */
+    int t_bright;               /* brightness test value for water */
+    float brightness_prob;      /* brightness probability value */
+    float temp_prob;            /* temperature probability */
+    float vari_prob;            /* probability from NDVI, NDSI, and whiteness */
+    float max_value;            /* maximum value */
+    unsigned char mask;         /* mask used for 1 pixel */
+
+    if (water)
+    {
+        /* Get cloud prob over water */
+        /* Temperature test over water */
+        wtemp_prob = (t_wtemp - (float) input->therm_buf[col]) /
+            400.0;
+        if (wtemp_prob < MINSIGMA)
+            wtemp_prob = 0.0;
+
+        /* Brightness test (over water) */
+        t_bright = 1100;
+        brightness_prob = (float) input->buf[BI_SWIR_1][col] /
+            (float) t_bright;
+        if ((brightness_prob - 1.0) > MINSIGMA)
+            brightness_prob = 1.0;
+        if (brightness_prob < MINSIGMA)
+            brightness_prob = 0.0;
+
+        /*Final prob mask (water), cloud over water probability */
+        return 100.0 * wtemp_prob * brightness_prob;
+    }
+    else
+    {
+        temp_prob =
+            (t_temph - (float) input->therm_buf[col]) / temp_l;
+        /* Temperature can have prob > 1 */
+        if (temp_prob < MINSIGMA)
+            temp_prob = 0.0;
+
+        /* label the non-fill pixels */
+        mask = !fill;
+
+        if ((input->buf[BI_RED][col]
+             + input->buf[BI_NIR][col]) != 0
+            && mask == 1)
+        {
+            ndvi = (float) (input->buf[BI_NIR][col]
+                            - input->buf[BI_RED][col])
+                   / (float) (input->buf[BI_NIR][col]
+                              + input->buf[BI_RED][col]);
+        }
+        else
+            ndvi = 0.01;
+
+        if ((input->buf[BI_GREEN][col]
+             + input->buf[BI_SWIR_1][col]) != 0
+            && mask == 1)
+        {
+            ndsi = (float) (input->buf[BI_GREEN][col]
+                            - input->buf[BI_SWIR_1][col])
+                   / (float) (input->buf[BI_GREEN][col]
+                              + input->buf[BI_SWIR_1][col]);
+        }
+        else
+            ndsi = 0.01;
+
+        /* NDVI and NDSI should not be negative */
+        if (ndsi < MINSIGMA)
+            ndsi = 0.0;
+        if (ndvi < MINSIGMA)
+            ndvi = 0.0;
+
+        visi_mean = (input->buf[BI_BLUE][col]
+                     + input->buf[BI_GREEN][col]
+                     + input->buf[BI_RED][col]) / 3.0;
+        if (visi_mean != 0)
+        {
+            whiteness =
+                ((fabs ((float) input->buf[BI_BLUE][col]
+                        - visi_mean)
+                  + fabs ((float) input->buf[BI_GREEN][col]
+                          - visi_mean)
+                  + fabs ((float) input->buf[BI_RED][col]
+                          - visi_mean))) / visi_mean;
+        }
+        else
+            whiteness = 0.0;
+
+        /* If one visible band is saturated, whiteness = 0 */
+        if ((input->buf[BI_BLUE][col]
+             >= (input->meta.satu_value_max[BI_BLUE] - 1))
+            ||
+            (input->buf[BI_GREEN][col]
+             >= (input->meta.satu_value_max[BI_GREEN] - 1))
+            ||
+            (input->buf[BI_RED][col]
+             >= (input->meta.satu_value_max[BI_RED] - 1)))
+        {
+            whiteness = 0.0;
+        }
+
+        /* Vari_prob=1-max(max(abs(NDSI),abs(NDVI)),whiteness); */
+        if ((ndsi - ndvi) > MINSIGMA)
+            max_value = ndsi;
+        else
+            max_value = ndvi;
+        if ((whiteness - max_value) > MINSIGMA)
+            max_value = whiteness;
+        vari_prob = 1.0 - max_value;
+
+        /*Final prob mask (land) */
+        return 100.0 * (temp_prob * vari_prob);
+    }
+}
+
+/******************************************************************************
+MODULE:  quantize_prob
+
+PURPOSE: Quantize a cloud probability to 16 bits
+
+RETURN: Probability times PROB_QUANTUM_SCALE rounded to the nearest int16
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Probabilities outside the int16 range are set to the nearest end of it.
+******************************************************************************/
+static int16 quantize_prob
+(
+    float prob  /* I: cloud probability */
+)
+{
+    double quantized = rint (prob * PROB_QUANTUM_SCALE); /* scaled value */
+
+    if (quantized < SHRT_MIN)
+        return SHRT_MIN;
+    if (quantized > SHRT_MAX)
+        return SHRT_MAX;
+    return (int16) quantized;
+}
+
+/******************************************************************************
+MODULE:  quantized_prob_level
+
+PURPOSE: Tell from a quantized cloud probability how the probability
+         compares to a threshold
+
+RETURN: 2 if the probability is above thresh, 1 if it is above thresh less
+        10, 0 if not, or PROB_LEVEL_UNKNOWN if that can't be told
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The probability is within half a quantum of the quantized value, and
+   the ends of that range are exact in double precision, so the level
+   returned is the one the probability itself gives.  The ends of the
+   int16 range stand for any probability beyond them.
+******************************************************************************/
+static int quantized_prob_level
+(
+    int16 quantized,  /* I: quantized cloud probability */
+    float thresh      /* I: probability threshold */
+)
+{
+    double low;                 /* lowest probability it stands for */
+    double high;                /* highest probability it stands for */
+
+    low = (quantized - 0.5) / PROB_QUANTUM_SCALE;
+    high = (quantized + 0.5) / PROB_QUANTUM_SCALE;
+    if (quantized == SHRT_MIN)
+        low = -HUGE_VAL;
+    if (quantized == SHRT_MAX)
+        high = HUGE_VAL;
+
+    if (low > thresh)
+        return 2;
+    if (high > thresh)
+        return PROB_LEVEL_UNKNOWN;
+    if (low > thresh - 10.0)
+        return 1;
+    if (high > thresh - 10.0)
+        return PROB_LEVEL_UNKNOWN;
+    return 0;
+}
 
 /******************************************************************************
 MODULE:  potential_cloud_shadow_snow_mask
@@ -24,6 +260,20 @@ HISTORY:
 Date        Programmer       Reason
 --------    ---------------  -------------------------------------
 3/15/2013   Song Guo         Original Development
+10/17/2026  USGS EROS        Find the temperature and band 4 and 5
+                             percentiles from histograms filled during the
+                             passes instead of copies of the clear pixels
+10/17/2026  USGS EROS        Find the dynamic probability thresholds from
+                             histograms filled as the probabilities are
+                             calculated
+10/17/2026  USGS EROS        Keep one probability raster for land and
+                             water, optionally quantized or calculated
+                             again, see prob_storage
+10/17/2026  USGS EROS        Set the all cloud shadow bits through a flat
+                             view of the pixel mask so the loop vectorizes
+10/17/2026  USGS EROS        Take the fill pixels from the fill bit plane
+                             and the saturated values from the input
+                             instead of redoing both in every pass
 
 NOTES: 
 1. Thermal buffer is expected to be in degrees Celsius with a factor applied
@@ -39,6 +289,9 @@ int potential_cloud_shadow_snow_mask
     float *t_temph,             /*O: percentile of high background temp */
     unsigned char **pixel_mask, /*I/O: pixel mask */
     unsigned char **conf_mask,  /*I/O: confidence mask */
+    int num_threads,            /*I: maximum number of threads to use */
+    Prob_storage_t prob_storage,/*I: how the cloud probabilities are kept
+                                     between the passes */
     bool verbose                /*I: value to indicate if intermediate
                                      messages should be printed */
 )
@@ -53,12 +306,8 @@ int potential_cloud_shadow_snow_mask
     int clear_pixel_counter = 0;       /* clear sky pixel counter */
     int clear_land_pixel_counter = 0;  /* clear land pixel counter */
     int clear_water_pixel_counter = 0; /* clear water pixel counter */
-    float ndvi, ndsi;           /* NDVI and NDSI values */
-    int16 *f_temp = NULL;       /* clear land temperature */
-    int16 *f_wtemp = NULL;      /* clear water temperature */
-    float visi_mean;            /* mean of visible bands */
-    float whiteness = 0.0;      /* whiteness value */
-    float hot;                  /* hot value for hot test */
+    Histogram16_t *f_temp = NULL;  /* clear land temperatures */
+    Histogram16_t *f_wtemp = NULL; /* clear water temperatures */
     float land_ptm;             /* clear land pixel percentage */
     float water_ptm;            /* clear water pixel percentage */
     Clear_Bits_t land_bit;      /* Which clear bit to test all or just land */
@@ -66,29 +315,47 @@ int potential_cloud_shadow_snow_mask
     float l_pt;                 /* low percentile threshold */
     float h_pt;                 /* high percentile threshold */
     float t_wtemp;              /* high percentile water temperature */
-    float **wfinal_prob = NULL; /* final water pixel probabilty value */
-    float **final_prob = NULL;  /* final land pixel probability value */
-    float wtemp_prob;           /* water temperature probability value */
-    int t_bright;               /* brightness test value for water */
-    float brightness_prob;      /* brightness probability value */
     int t_buffer;               /* temperature test buffer */
     float temp_l;               /* difference of low/high tempearture
                                    percentiles */
-    float temp_prob;            /* temperature probability */
-    float vari_prob;            /* probability from NDVI, NDSI, and whiteness */
-    float max_value;            /* maximum value */
-    float *prob = NULL;         /* probability value */
-    float *wprob = NULL;        /* probability value */
+    float **cloud_prob = NULL;  /* pixel cloud probabilities */
+    int16 **quantized_prob = NULL; /* quantized pixel cloud probabilities */
+    float pixel_prob;           /* cloud probability of a pixel */
+    float land_prob;            /* land cloud probability of a pixel */
+    float water_prob;           /* water cloud probability of a pixel */
+    float thresh;               /* probability threshold of a pixel */
+    bool water;                 /* is the pixel water? */
+    bool bands_read;            /* have the bands of the row been read? */
+    int prob_level;             /* how the probability compares to thresh */
+    long recomputed = 0;        /* number of probabilities calculated
+                                   again */
+    Binned_histogram_t *prob = NULL;  /* clear land probabilities */
+    Binned_histogram_t *wprob = NULL; /* clear water probabilities */
+    float prob_max = 0.0;       /* maximum clear land probability */
+    float prob_min = 0.0;       /* minimum clear land probability */
+    float wprob_max = 0.0;      /* maximum clear water probability */
+    float wprob_min = 0.0;      /* minimum clear water probability */
     float clr_mask = 0.0;       /* clear sky pixel threshold */
     float wclr_mask = 0.0;      /* water pixel threshold */
-    int16 *nir = NULL;          /* near infrared band (band 4) data */
-    int16 *swir = NULL;         /* short wavelength infrared (band 5) data */
+    Histogram16_t *nir = NULL;  /* clear land band 4 values */
+    Histogram16_t *swir = NULL; /* clear land band 5 values */
+    int16 *nir_data = NULL;     /* whole image band 4 data */
+    int16 *swir_data = NULL;    /* whole image band 5 data */
+    int16 *new_nir = NULL;      /* filled band 4 data */
+    int16 *new_swir = NULL;     /* filled band 5 data */
+    int pixel_index;            /* pixel index in the whole image data */
+    Fill_minima_args_t nir_fill;  /* band 4 fill arguments */
+    Fill_minima_args_t swir_fill; /* band 5 fill arguments */
+    pthread_t swir_thread;      /* thread for the band 5 fill */
+    bool swir_threaded;         /* was the band 5 fill run in a thread */
     float backg_b4;             /* background band 4 value */
     float backg_b5;             /* background band 5 value */
     int16 shadow_prob;          /* shadow probability */
     int status;                 /* return value */
-    int satu_bv;                /* sum of saturated bands 1, 2, 3 value */
     unsigned char mask;         /* mask used for 1 pixel */
+    Spectral_tests_t spectral_tests; /* first pass counters and state */
+    unsigned char *pixel_state = NULL; /* first pass scratch line */
+    Raster_view_t mask_view;    /* flat view of the pixel mask */
 
     /* Dynamic memory allocation */
     unsigned char **clear_mask = NULL;
@@ -99,6 +366,14 @@ int potential_cloud_shadow_snow_mask
     if (clear_mask == NULL)
         RETURN_ERROR ("Allocating mask memory", "pcloud", FAILURE);
 
+    pixel_state = malloc (ncols * sizeof (unsigned char));
+    if (pixel_state == NULL)
+        RETURN_ERROR ("Allocating pixel state memory", "pcloud", FAILURE);
+    init_spectral_tests (&spectral_tests);
+
+    /* The first pass takes the fill pixels from the fill bits */
+    or_unpack_bitplane (input->fill_plane, FILL_BIT, pixel_mask);
+
     if (verbose)
         printf ("The first pass\n");
 
@@ -136,200 +411,17 @@ int potential_cloud_shadow_snow_mask
             RETURN_ERROR (errstr, "pcloud", FAILURE);
         }
 
-        for (col = 0; col < ncols; col++)
-        {
-            int ib;
-            for (ib = 0; ib < BI_REFL_BAND_COUNT; ib++)
-            {
-                if (input->buf[ib][col] == input->meta.satu_value_ref[ib])
-                    input->buf[ib][col] = input->meta.satu_value_max[ib];
-            }
-            if (input->therm_buf[col] == input->meta.therm_satu_value_ref)
-                input->therm_buf[col] = input->meta.therm_satu_value_max;
-
-            /* process non-fill pixels only
-               Due to a problem with the input LPGS data, the thermal band
-               may have values less than -9999 after scaling so exclude those
-               as well */
-            if (input->therm_buf[col] <= -9999
-                || input->buf[BI_BLUE][col] == -9999
-                || input->buf[BI_GREEN][col] == -9999
-                || input->buf[BI_RED][col] == -9999
-                || input->buf[BI_NIR][col] == -9999
-                || input->buf[BI_SWIR_1][col] == -9999
-                || input->buf[BI_SWIR_2][col] == -9999)
-            {
-                mask = 0;
-            }
-            else
-            {
-                mask = 1;
-                mask_counter++;
-            }
-
-            if ((input->buf[BI_RED][col] + input->buf[BI_NIR][col]) != 0
-                && mask == 1)
-            {
-                ndvi = (float) (input->buf[BI_NIR][col]
-                                - input->buf[BI_RED][col])
-                       / (float) (input->buf[BI_NIR][col]
-                                  + input->buf[BI_RED][col]);
-            }
-            else
-                ndvi = 0.01;
-
-            if ((input->buf[BI_GREEN][col] + input->buf[BI_SWIR_1][col]) != 0
-                && mask == 1)
-            {
-                ndsi = (float) (input->buf[BI_GREEN][col]
-                                - input->buf[BI_SWIR_1][col])
-                       / (float) (input->buf[BI_GREEN][col]
-                                  + input->buf[BI_SWIR_1][col]);
-            }
-            else
-                ndsi = 0.01;
-
-            /* Basic cloud test, equation 1 */
-            if (((ndsi - 0.8) < MINSIGMA)
-                && ((ndvi - 0.8) < MINSIGMA)
-                && (input->buf[BI_SWIR_2][col] > 300)
-                && (input->therm_buf[col] < 2700))
-            {
-                pixel_mask[row][col] |= 1 << CLOUD_BIT;
-            }
-            else
-                pixel_mask[row][col] &= ~(1 << CLOUD_BIT);
-
-            /* It takes every snow pixels including snow pixel under thin 
-               clouds or icy clouds, equation 20 */
-            if (((ndsi - 0.15) > MINSIGMA)
-                && (input->therm_buf[col] < 1000)
-                && (input->buf[BI_NIR][col] > 1100)
-                && (input->buf[BI_GREEN][col] > 1000))
-            {
-                pixel_mask[row][col] |= 1 << SNOW_BIT;
-            }
-            else
-                pixel_mask[row][col] &= ~(1 << SNOW_BIT);
-
-            /* Zhe's water test (works over thin cloud), equation 5 */
-            if (((((ndvi - 0.01) < MINSIGMA)
-                  && (input->buf[BI_NIR][col] < 1100))
-                 || (((ndvi - 0.1) < MINSIGMA)
-                     && (ndvi > MINSIGMA)
-                     && (input->buf[BI_NIR][col] < 500)))
-                && (mask == 1))
-            {
-                pixel_mask[row][col] |= 1 << WATER_BIT;
-            }
-            else
-                pixel_mask[row][col] &= ~(1 << WATER_BIT);
-            if (mask == 0)
-                pixel_mask[row][col] |= 1 << FILL_BIT;
-
-            /* visible bands flatness (sum(abs)/mean < 0.6 => brigt and dark 
-               cloud), equation 2 */
-            if ((pixel_mask[row][col] & (1 << CLOUD_BIT)) && mask == 1)
-            {
-                visi_mean = (float) (input->buf[BI_BLUE][col]
-                                     + input->buf[BI_GREEN][col]
-                                     + input->buf[BI_RED][col]) / 3.0;
-                if (visi_mean != 0)
-                {
-                    whiteness =
-                        ((fabs ((float) input->buf[BI_BLUE][col] - visi_mean)
-                          + fabs ((float) input->buf[BI_GREEN][col] - visi_mean)
-                          + fabs ((float) input->buf[BI_RED][col]
-                                  - visi_mean))) / visi_mean;
-                }
-                else
-                {
-                    /* Just put a large value to remove them from cloud pixel
-                       identification */
-                    whiteness = 100.0;
-                }
-            }
-
-            /* Update cloud_mask,  if one visible band is saturated,
-               whiteness = 0, due to data type conversion, pixel value
-               difference of 1 is possible */
-            if ((input->buf[BI_BLUE][col]
-                 >= (input->meta.satu_value_max[BI_BLUE] - 1))
-                ||
-                (input->buf[BI_GREEN][col]
-                 >= (input->meta.satu_value_max[BI_GREEN] - 1))
-                ||
-                (input->buf[BI_RED][col]
-                 >= (input->meta.satu_value_max[BI_RED] - 1)))
-            {
-                whiteness = 0.0;
-                satu_bv = 1;
-            }
-            else
-            {
-                satu_bv = 0;
-            }
-
-            if ((pixel_mask[row][col] & (1 << CLOUD_BIT)) &&
-                (whiteness - 0.7) < MINSIGMA)
-                pixel_mask[row][col] |= 1 << CLOUD_BIT;
-            else
-                pixel_mask[row][col] &= ~(1 << CLOUD_BIT);
-
-            /* Haze test, equation 3 */
-            hot =
-                (float) input->buf[BI_BLUE][col] -
-                0.5 * (float) input->buf[BI_RED][col] - 800.0;
-            if ((pixel_mask[row][col] & (1 << CLOUD_BIT))
-                && (hot > MINSIGMA || satu_bv == 1))
-                pixel_mask[row][col] |= 1 << CLOUD_BIT;
-            else
-                pixel_mask[row][col] &= ~(1 << CLOUD_BIT);
-
-            /* Ratio 4/5 > 0.75 test, equation 4 */
-            if ((pixel_mask[row][col] & (1 << CLOUD_BIT)) &&
-                input->buf[BI_SWIR_1][col] != 0)
-            {
-                if ((float) input->buf[BI_NIR][col] /
-                    (float) (input->buf[BI_SWIR_1][col]) - 0.75 > MINSIGMA)
-                    pixel_mask[row][col] |= 1 << CLOUD_BIT;
-                else
-                    pixel_mask[row][col] &= ~(1 << CLOUD_BIT);
-            }
-            else
-                pixel_mask[row][col] &= ~(1 << CLOUD_BIT);
-
-            /* Test whether use thermal band or not */
-            if ((!(pixel_mask[row][col] & (1 << CLOUD_BIT))) && mask == 1)
-            {
-                clear_mask[row][col] |= 1 << CLEAR_BIT;
-                clear_pixel_counter++;
-            }
-            else
-                clear_mask[row][col] &= ~(1 << CLEAR_BIT);
-
-            if ((!(pixel_mask[row][col] & (1 << WATER_BIT))) &&
-                clear_mask[row][col] & (1 << CLEAR_BIT))
-            {
-                clear_mask[row][col] |= 1 << CLEAR_LAND_BIT;
-                clear_land_pixel_counter++;
-                clear_mask[row][col] &= ~(1 << CLEAR_WATER_BIT);
-            }
-            else if ((pixel_mask[row][col] & (1 << WATER_BIT)) &&
-                     clear_mask[row][col] & (1 << CLEAR_BIT))
-            {
-                clear_mask[row][col] |= 1 << CLEAR_WATER_BIT;
-                clear_water_pixel_counter++;
-                clear_mask[row][col] &= ~(1 << CLEAR_LAND_BIT);
-            }
-            else
-            {
-                clear_mask[row][col] &= ~(1 << CLEAR_WATER_BIT);
-                clear_mask[row][col] &= ~(1 << CLEAR_LAND_BIT);
-            }
-        }
+        /* Cloud, snow, water and clear tests, equations 1-5 and 20 */
+        spectral_tests_row (input->buf, input->therm_buf, ncols,
+                            input->meta.satu_value_max, pixel_mask[row],
+                            clear_mask[row], pixel_state, &spectral_tests);
     }
     printf ("\n");
+    free (pixel_state);
+    mask_counter = spectral_tests.mask_counter;
+    clear_pixel_counter = spectral_tests.clear_pixel_counter;
+    clear_land_pixel_counter = spectral_tests.clear_land_pixel_counter;
+    clear_water_pixel_counter = spectral_tests.clear_water_pixel_counter;
 
     *clear_ptm = 100.0 * ((float) clear_pixel_counter
                           / (float) mask_counter);
@@ -353,22 +445,27 @@ int potential_cloud_shadow_snow_mask
         /* No thermal test is needed, all clouds */
         *t_templ = -1.0;
         *t_temph = -1.0;
+        if (get_2d_array_view ((void **) pixel_mask, &mask_view) != SUCCESS)
+        {
+            sprintf (errstr, "Getting the pixel mask view");
+            RETURN_ERROR (errstr, "pcloud", FAILURE);
+        }
         for (row = 0; row < nrows; row++)
         {
+            unsigned char *restrict mask_row =
+                RASTER_ROW (&mask_view, unsigned char, row);
             for (col = 0; col < ncols; col++)
             {
-                /* All cloud */
-                if (!(pixel_mask[row][col] & (1 << CLOUD_BIT)))
-                    pixel_mask[row][col] |= 1 << SHADOW_BIT;
-                else
-                    pixel_mask[row][col] &= ~(1 << SHADOW_BIT);
+                /* All cloud: shadow is set exactly where cloud isn't */
+                mask_row[col] = (mask_row[col] & ~(1 << SHADOW_BIT))
+                    | ((~mask_row[col] >> CLOUD_BIT & 1) << SHADOW_BIT);
             }
         }
     }
     else
     {
-        f_temp = malloc (input->size.l * input->size.s * sizeof (int16));
-        f_wtemp = malloc (input->size.l * input->size.s * sizeof (int16));
+        f_temp = create_histogram16 ();
+        f_wtemp = create_histogram16 ();
         if (f_temp == NULL || f_wtemp == NULL)
         {
             sprintf (errstr, "Allocating temp memory");
@@ -406,8 +503,7 @@ int potential_cloud_shadow_snow_mask
         int16 f_temp_min = SHRT_MAX;
         int16 f_wtemp_max = SHRT_MIN;
         int16 f_wtemp_min = SHRT_MAX;
-        int land_count = 0;
-        int water_count = 0;
+        int16 value;
         /* Loop through each line in the image */
         for (row = 0; row < nrows; row++)
         {
@@ -431,29 +527,26 @@ int potential_cloud_shadow_snow_mask
 
             for (col = 0; col < ncols; col++)
             {
-                if (input->therm_buf[col] == input->meta.therm_satu_value_ref)
-                    input->therm_buf[col] = input->meta.therm_satu_value_max;
+                value = input->therm_buf[col];
 
                 /* get clear land temperature */
                 if (clear_mask[row][col] & land_bit)
                 {
-                    f_temp[land_count] = input->therm_buf[col];
-                    if (f_temp_max < f_temp[land_count])
-                        f_temp_max = f_temp[land_count];
-                    if (f_temp_min > f_temp[land_count])
-                        f_temp_min = f_temp[land_count];
-                    land_count++;
+                    ADD_HISTOGRAM16_VALUE (f_temp, value);
+                    if (f_temp_max < value)
+                        f_temp_max = value;
+                    if (f_temp_min > value)
+                        f_temp_min = value;
                 }
 
                 /* get clear water temperature */
                 if (clear_mask[row][col] & water_bit)
                 {
-                    f_wtemp[water_count] = input->therm_buf[col];
-                    if (f_wtemp_max < f_wtemp[water_count])
-                        f_wtemp_max = f_wtemp[water_count];
-                    if (f_wtemp_min > f_wtemp[water_count])
-                        f_wtemp_min = f_wtemp[water_count];
-                    water_count++;
+                    ADD_HISTOGRAM16_VALUE (f_wtemp, value);
+                    if (f_wtemp_max < value)
+                        f_wtemp_max = value;
+                    if (f_wtemp_min > value)
+                        f_wtemp_min = value;
                 }
             }
         }
@@ -475,30 +568,15 @@ int potential_cloud_shadow_snow_mask
         h_pt = 1.0 - l_pt;
 
         /* 0.175 percentile background temperature (low) */
-        status = prctile (f_temp, land_count, f_temp_min, f_temp_max,
-                          100.0 * l_pt, t_templ);
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Error calling prctile routine");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
+        histogram16_prctile (f_temp, f_temp_min, f_temp_max, 100.0 * l_pt,
+                             t_templ);
 
         /* 0.825 percentile background temperature (high) */
-        status = prctile (f_temp, land_count, f_temp_min, f_temp_max,
-                          100.0 * h_pt, t_temph);
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Error calling prctile routine");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
+        histogram16_prctile (f_temp, f_temp_min, f_temp_max, 100.0 * h_pt,
+                             t_temph);
 
-        status = prctile (f_wtemp, water_count, f_wtemp_min, f_wtemp_max,
-                          100.0 * h_pt, &t_wtemp);
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Error calling prctile routine");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
+        histogram16_prctile (f_wtemp, f_wtemp_min, f_wtemp_max, 100.0 * h_pt,
+                             &t_wtemp);
 
         /* Temperature test */
         t_buffer = 4 * 100;
@@ -507,18 +585,36 @@ int potential_cloud_shadow_snow_mask
         temp_l = *t_temph - *t_templ;
 
         /* Release f_temp memory */
-        free (f_wtemp);
-        free (f_temp);
+        free_histogram16 (f_wtemp);
+        free_histogram16 (f_temp);
         f_wtemp = NULL;
         f_temp = NULL;
 
-        wfinal_prob = (float **) allocate_2d_array (input->size.l,
-                                                    input->size.s,
-                                                    sizeof (float));
-        final_prob =
-            (float **) allocate_2d_array (input->size.l, input->size.s,
-                                          sizeof (float));
-        if (wfinal_prob == NULL || final_prob == NULL)
+        /* Land and water pixels only have a probability of one kind, so
+           they share one raster */
+        if (prob_storage == PROB_STORAGE_FLOAT)
+        {
+            cloud_prob = (float **) allocate_2d_array (nrows, ncols,
+                                                       sizeof (float));
+            if (cloud_prob == NULL)
+            {
+                sprintf (errstr, "Allocating prob memory");
+                RETURN_ERROR (errstr, "pcloud", FAILURE);
+            }
+        }
+        else if (prob_storage == PROB_STORAGE_QUANTIZED)
+        {
+            quantized_prob = (int16 **) allocate_2d_array (nrows, ncols,
+                                                           sizeof (int16));
+            if (quantized_prob == NULL)
+            {
+                sprintf (errstr, "Allocating prob memory");
+                RETURN_ERROR (errstr, "pcloud", FAILURE);
+            }
+        }
+        prob = create_binned_histogram ();
+        wprob = create_binned_histogram ();
+        if (prob == NULL || wprob == NULL)
         {
             sprintf (errstr, "Allocating prob memory");
             RETURN_ERROR (errstr, "pcloud", FAILURE);
@@ -564,218 +660,61 @@ int potential_cloud_shadow_snow_mask
             /* Loop through each line in the image */
             for (col = 0; col < ncols; col++)
             {
-                for (ib = 0; ib < BI_REFL_BAND_COUNT - 1; ib++)
-                {
-                    if (input->buf[ib][col] == input->meta.satu_value_ref[ib])
-                        input->buf[ib][col] = input->meta.satu_value_max[ib];
-                }
-                if (input->therm_buf[col] == input->meta.therm_satu_value_ref)
-                    input->therm_buf[col] = input->meta.therm_satu_value_max;
-
-                if (pixel_mask[row][col] & (1 << WATER_BIT))
-                {
-                    /* Get cloud prob over water */
-                    /* Temperature test over water */
-                    wtemp_prob = (t_wtemp - (float) input->therm_buf[col]) /
-                        400.0;
-                    if (wtemp_prob < MINSIGMA)
-                        wtemp_prob = 0.0;
-
-                    /* Brightness test (over water) */
-                    t_bright = 1100;
-                    brightness_prob = (float) input->buf[BI_SWIR_1][col] /
-                        (float) t_bright;
-                    if ((brightness_prob - 1.0) > MINSIGMA)
-                        brightness_prob = 1.0;
-                    if (brightness_prob < MINSIGMA)
-                        brightness_prob = 0.0;
-
-                    /*Final prob mask (water), cloud over water probability */
-                    wfinal_prob[row][col] =
-                        100.0 * wtemp_prob * brightness_prob;
-                    final_prob[row][col] = 0.0;
-                }
-                else
+                water = (pixel_mask[row][col] & (1 << WATER_BIT)) != 0;
+                pixel_prob = cloud_probability (input, col,
+                    TEST_BITPLANE_PIXEL (input->fill_plane, row, col),
+                    water, t_wtemp, *t_temph, temp_l);
+                if (prob_storage == PROB_STORAGE_FLOAT)
+                    cloud_prob[row][col] = pixel_prob;
+                else if (prob_storage == PROB_STORAGE_QUANTIZED)
+                    quantized_prob[row][col] = quantize_prob (pixel_prob);
+
+                /* Count the clear pixel probabilities for the dynamic
+                   thresholds; water pixels have no land probability and
+                   land pixels no water probability */
+                if (clear_mask[row][col] & land_bit)
                 {
-                    temp_prob =
-                        (*t_temph - (float) input->therm_buf[col]) / temp_l;
-                    /* Temperature can have prob > 1 */
-                    if (temp_prob < MINSIGMA)
-                        temp_prob = 0.0;
-
-                    /* label the non-fill pixels
-                       Due to a problem with the input LPGS data, the thermal
-                       band may have values less than -9999 after scaling so
-                       exclude those as well */
-                    if (input->therm_buf[col] <= -9999
-                        || input->buf[BI_BLUE][col] == -9999
-                        || input->buf[BI_GREEN][col] == -9999
-                        || input->buf[BI_RED][col] == -9999
-                        || input->buf[BI_NIR][col] == -9999
-                        || input->buf[BI_SWIR_1][col] == -9999
-                        || input->buf[BI_SWIR_2][col] == -9999)
-                    {
-                        mask = 0;
-                    }
-                    else
-                        mask = 1;
-
-                    if ((input->buf[BI_RED][col]
-                         + input->buf[BI_NIR][col]) != 0
-                        && mask == 1)
+                    land_prob = water ? 0.0 : pixel_prob;
+                    if (add_binned_value (prob, land_prob) != SUCCESS)
                     {
-                        ndvi = (float) (input->buf[BI_NIR][col]
-                                        - input->buf[BI_RED][col])
-                               / (float) (input->buf[BI_NIR][col]
-                                          + input->buf[BI_RED][col]);
+                        sprintf (errstr, "Adding to the prob histogram");
+                        RETURN_ERROR (errstr, "pcloud", FAILURE);
                     }
-                    else
-                        ndvi = 0.01;
-
-                    if ((input->buf[BI_GREEN][col]
-                         + input->buf[BI_SWIR_1][col]) != 0
-                        && mask == 1)
-                    {
-                        ndsi = (float) (input->buf[BI_GREEN][col]
-                                        - input->buf[BI_SWIR_1][col])
-                               / (float) (input->buf[BI_GREEN][col]
-                                          + input->buf[BI_SWIR_1][col]);
-                    }
-                    else
-                        ndsi = 0.01;
-
-                    /* NDVI and NDSI should not be negative */
-                    if (ndsi < MINSIGMA)
-                        ndsi = 0.0;
-                    if (ndvi < MINSIGMA)
-                        ndvi = 0.0;
-
-                    visi_mean = (input->buf[BI_BLUE][col]
-                                 + input->buf[BI_GREEN][col]
-                                 + input->buf[BI_RED][col]) / 3.0;
-                    if (visi_mean != 0)
-                    {
-                        whiteness =
-                            ((fabs ((float) input->buf[BI_BLUE][col]
-                                    - visi_mean)
-                              + fabs ((float) input->buf[BI_GREEN][col]
-                                      - visi_mean)
-                              + fabs ((float) input->buf[BI_RED][col]
-                                      - visi_mean))) / visi_mean;
-                    }
-                    else
-                        whiteness = 0.0;
-
-                    /* If one visible band is saturated, whiteness = 0 */
-                    if ((input->buf[BI_BLUE][col]
-                         >= (input->meta.satu_value_max[BI_BLUE] - 1))
-                        ||
-                        (input->buf[BI_GREEN][col]
-                         >= (input->meta.satu_value_max[BI_GREEN] - 1))
-                        ||
-                        (input->buf[BI_RED][col]
-                         >= (input->meta.satu_value_max[BI_RED] - 1)))
+                    if ((land_prob - prob_max) > MINSIGMA)
+                        prob_max = land_prob;
+                    if ((prob_min - land_prob) > MINSIGMA)
+                        prob_min = land_prob;
+                }
+                if (clear_mask[row][col] & water_bit)
+                {
+                    water_prob = water ? pixel_prob : 0.0;
+                    if (add_binned_value (wprob, water_prob) != SUCCESS)
                     {
-                        whiteness = 0.0;
+                        sprintf (errstr, "Adding to the wprob histogram");
+                        RETURN_ERROR (errstr, "pcloud", FAILURE);
                     }
-
-                    /* Vari_prob=1-max(max(abs(NDSI),abs(NDVI)),whiteness); */
-                    if ((ndsi - ndvi) > MINSIGMA)
-                        max_value = ndsi;
-                    else
-                        max_value = ndvi;
-                    if ((whiteness - max_value) > MINSIGMA)
-                        max_value = whiteness;
-                    vari_prob = 1.0 - max_value;
-
-                    /*Final prob mask (land) */
-                    final_prob[row][col] = 100.0 * (temp_prob * vari_prob);
-                    wfinal_prob[row][col] = 0.0;
+                    if ((water_prob - wprob_max) > MINSIGMA)
+                        wprob_max = water_prob;
+                    if ((wprob_min - water_prob) > MINSIGMA)
+                        wprob_min = water_prob;
                 }
             }
         }
         printf ("\n");
 
-        /* Allocate memory for prob */
-        prob = malloc (input->size.l * input->size.s * sizeof (float));
-        if (prob == NULL)
-        {
-            sprintf (errstr, "Allocating prob memory");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-
-        float prob_max = 0.0;
-        float prob_min = 0.0;
-        land_count = 0;
-        for (row = 0; row < nrows; row++)
-        {
-            for (col = 0; col < ncols; col++)
-            {
-                if (clear_mask[row][col] & land_bit)
-                {
-                    prob[land_count] = final_prob[row][col];
-                    if ((prob[land_count] - prob_max) > MINSIGMA)
-                        prob_max = prob[land_count];
-                    if ((prob_min - prob[land_count]) > MINSIGMA)
-                        prob_min = prob[land_count];
-                    land_count++;
-                }
-            }
-        }
-
         /* Dynamic threshold for land */
-        status = prctile2 (prob, land_count, prob_min, prob_max,
-                           100.0 * h_pt, &clr_mask);
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Error calling prctile2 routine");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
+        binned_prctile (prob, prob_min, prob_max, 100.0 * h_pt, &clr_mask);
         clr_mask += cloud_prob_threshold;
 
-        /* Release memory for prob */
-        free (prob);
-        prob = NULL;
-
-        /* Allocate memory for wprob */
-        wprob = malloc (input->size.l * input->size.s * sizeof (float));
-        if (wprob == NULL)
-        {
-            sprintf (errstr, "Allocating wprob memory");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-
-        float wprob_max = 0.0;
-        float wprob_min = 0.0;
-        water_count = 0;
-        for (row = 0; row < nrows; row++)
-        {
-            for (col = 0; col < ncols; col++)
-            {
-                if (clear_mask[row][col] & water_bit)
-                {
-                    wprob[water_count] = wfinal_prob[row][col];
-                    if ((wprob[water_count] - wprob_max) > MINSIGMA)
-                        wprob_max = wprob[water_count];
-                    if ((wprob_min - wprob[water_count]) > MINSIGMA)
-                        wprob_min = wprob[water_count];
-                    water_count++;
-                }
-            }
-        }
-
         /* Dynamic threshold for water */
-        status = prctile2 (wprob, water_count, wprob_min, wprob_max,
-                           100.0 * h_pt, &wclr_mask);
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Error calling prctile2 routine");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
+        binned_prctile (wprob, wprob_min, wprob_max, 100.0 * h_pt,
+                        &wclr_mask);
         wclr_mask += cloud_prob_threshold;
 
-        /* Release memory for wprob */
-        free (wprob);
+        /* Release memory for prob and wprob */
+        free_binned_histogram (prob);
+        free_binned_histogram (wprob);
+        prob = NULL;
         wprob = NULL;
 
         if (verbose)
@@ -788,6 +727,7 @@ int potential_cloud_shadow_snow_mask
         }
 
         /* Loop through each line in the image */
+        recomputed = 0;
         for (row = 0; row < nrows; row++)
         {
             if (verbose)
@@ -807,27 +747,63 @@ int potential_cloud_shadow_snow_mask
                          row);
                 RETURN_ERROR (errstr, "pcloud", FAILURE);
             }
+            bands_read = false;
 
             for (col = 0; col < ncols; col++)
             {
-                if (input->therm_buf[col] == input->meta.therm_satu_value_ref)
+                /* How the probability of a potential cloud pixel compares
+                   to the thresholds: 2 above the threshold, 1 above the
+                   threshold less 10, else 0 */
+                prob_level = 0;
+                if (pixel_mask[row][col] & (1 << CLOUD_BIT))
                 {
-                    input->therm_buf[col] = input->meta.therm_satu_value_max;
+                    water = (pixel_mask[row][col] & (1 << WATER_BIT)) != 0;
+                    thresh = water ? wclr_mask : clr_mask;
+                    if (prob_storage == PROB_STORAGE_QUANTIZED)
+                        prob_level = quantized_prob_level (
+                            quantized_prob[row][col], thresh);
+                    else
+                        prob_level = PROB_LEVEL_UNKNOWN;
+
+                    if (prob_storage == PROB_STORAGE_FLOAT)
+                        pixel_prob = cloud_prob[row][col];
+                    else if (prob_level == PROB_LEVEL_UNKNOWN)
+                    {
+                        /* Calculate the probability again from the bands */
+                        if (!bands_read)
+                        {
+                            for (ib = 0; ib < input->nband; ib++)
+                            {
+                                if (!GetInputLine (input, ib, row))
+                                {
+                                    sprintf (errstr, "Reading input image "
+                                             "data for line %d, band %d",
+                                             row, ib);
+                                    RETURN_ERROR (errstr, "pcloud",
+                                                  FAILURE);
+                                }
+                            }
+                            bands_read = true;
+                        }
+                        pixel_prob = cloud_probability (input, col,
+                            TEST_BITPLANE_PIXEL (input->fill_plane, row, col),
+                            water, t_wtemp, *t_temph, temp_l);
+                        recomputed++;
+                    }
+
+                    if (prob_level == PROB_LEVEL_UNKNOWN)
+                    {
+                        if (pixel_prob > thresh)
+                            prob_level = 2;
+                        else if (pixel_prob > thresh - 10.0)
+                            prob_level = 1;
+                        else
+                            prob_level = 0;
+                    }
                 }
 
-                if (((pixel_mask[row][col] & (1 << CLOUD_BIT))
-                     &&
-                     (final_prob[row][col] > clr_mask)
-                     &&
-                     (!(pixel_mask[row][col] & (1 << WATER_BIT))))
-                    ||
-                    ((pixel_mask[row][col] & (1 << CLOUD_BIT))
-                     &&
-                     (wfinal_prob[row][col] > wclr_mask)
-                     &&
-                     (pixel_mask[row][col] & (1 << WATER_BIT)))
-                    ||
-                    (input->therm_buf[col] < *t_templ + t_buffer - 3500))
+                if (prob_level == 2
+                    || (input->therm_buf[col] < *t_templ + t_buffer - 3500))
                 {
                     /* This test indicates a high confidence */
                     conf_mask[row][col] = CLOUD_CONFIDENCE_HIGH;
@@ -836,17 +812,7 @@ int potential_cloud_shadow_snow_mask
                        cloud bit or not */
                     pixel_mask[row][col] |= 1 << CLOUD_BIT;
                 }
-                else if (((pixel_mask[row][col] & (1 << CLOUD_BIT))
-                          &&
-                          (final_prob[row][col] > clr_mask-10.0)
-                          &&
-                          (!(pixel_mask[row][col] & (1 << WATER_BIT))))
-                         ||
-                         ((pixel_mask[row][col] & (1 << CLOUD_BIT))
-                          &&
-                          (wfinal_prob[row][col] > wclr_mask-10.0)
-                          &&
-                          (pixel_mask[row][col] & (1 << WATER_BIT))))
+                else if (prob_level == 1)
                 {
                     /* This test indicates a medium confidence */
                     conf_mask[row][col] = CLOUD_CONFIDENCE_MED;
@@ -865,43 +831,47 @@ int potential_cloud_shadow_snow_mask
             }
         }
         printf ("\n");
+        if (verbose && prob_storage != PROB_STORAGE_FLOAT)
+        {
+            printf ("Cloud probabilities calculated again for %ld"
+                    " pixels\n", recomputed);
+        }
 
         /* Free the memory */
-        status = free_2d_array ((void **) wfinal_prob);
-        if (status != SUCCESS)
+        if (cloud_prob != NULL)
         {
-            sprintf (errstr, "Freeing memory: wfinal_prob\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
+            status = free_2d_array ((void **) cloud_prob);
+            if (status != SUCCESS)
+            {
+                sprintf (errstr, "Freeing memory: cloud_prob\n");
+                RETURN_ERROR (errstr, "pcloud", FAILURE);
+            }
         }
-        status = free_2d_array ((void **) final_prob);
-        if (status != SUCCESS)
+        if (quantized_prob != NULL)
         {
-            sprintf (errstr, "Freeing memory: final_prob\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
+            status = free_2d_array ((void **) quantized_prob);
+            if (status != SUCCESS)
+            {
+                sprintf (errstr, "Freeing memory: quantized_prob\n");
+                RETURN_ERROR (errstr, "pcloud", FAILURE);
+            }
         }
 
         /* Band 4 & 5 flood fill */
-        nir = calloc (input->size.l * input->size.s, sizeof (int16));
-        swir = calloc (input->size.l * input->size.s, sizeof (int16));
+        nir = create_histogram16 ();
+        swir = create_histogram16 ();
         if (nir == NULL || swir == NULL)
         {
             sprintf (errstr, "Allocating nir and swir memory");
             RETURN_ERROR (errstr, "pcloud", FAILURE);
         }
 
-        /* Open the intermediate file for writing */
-        FILE *fd1;
-        FILE *fd2;
-        fd1 = fopen ("b4.bin", "wb");
-        if (fd1 == NULL)
-        {
-            sprintf (errstr, "Opening file: b4.bin\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        fd2 = fopen ("b5.bin", "wb");
-        if (fd2 == NULL)
+        /* Whole image band 4 & 5 data for the flood fill */
+        nir_data = malloc (input->size.l * input->size.s * sizeof (int16));
+        swir_data = malloc (input->size.l * input->size.s * sizeof (int16));
+        if (nir_data == NULL || swir_data == NULL)
         {
-            sprintf (errstr, "Opening file: b5.bin\n");
+            sprintf (errstr, "Allocating nir_data and swir_data memory");
             RETURN_ERROR (errstr, "pcloud", FAILURE);
         }
 
@@ -912,8 +882,6 @@ int potential_cloud_shadow_snow_mask
         int16 nir_min = 0;
         int16 swir_max = 0;
         int16 swir_min = 0;
-        int nir_count = 0;
-        int swir_count = 0;
         /* Loop through each line in the image */
         for (row = 0; row < nrows; row++)
         {
@@ -942,147 +910,105 @@ int potential_cloud_shadow_snow_mask
 
             for (col = 0; col < ncols; col++)
             {
-                if (input->buf[BI_NIR][col]
-                    == input->meta.satu_value_ref[BI_NIR])
-                {
-                    input->buf[BI_NIR][col] =
-                        input->meta.satu_value_max[BI_NIR];
-                }
-                if (input->buf[BI_SWIR_1][col]
-                    == input->meta.satu_value_ref[BI_SWIR_1])
-                {
-                    input->buf[BI_SWIR_1][col] =
-                        input->meta.satu_value_max[BI_SWIR_1];
-                }
-
                 if (clear_mask[row][col] & land_bit)
                 {
-                    nir[nir_count] = input->buf[BI_NIR][col];
-                    if (nir[nir_count] > nir_max)
-                        nir_max = nir[nir_count];
-                    if (nir[nir_count] < nir_min)
-                        nir_min = nir[nir_count];
-                    nir_count++;
-
-                    swir[swir_count] = input->buf[BI_SWIR_1][col];
-                    if (swir[swir_count] > swir_max)
-                        swir_max = swir[swir_count];
-                    if (swir[swir_count] < swir_min)
-                        swir_min = swir[swir_count];
-                    swir_count++;
+                    value = input->buf[BI_NIR][col];
+                    ADD_HISTOGRAM16_VALUE (nir, value);
+                    if (value > nir_max)
+                        nir_max = value;
+                    if (value < nir_min)
+                        nir_min = value;
+
+                    value = input->buf[BI_SWIR_1][col];
+                    ADD_HISTOGRAM16_VALUE (swir, value);
+                    if (value > swir_max)
+                        swir_max = value;
+                    if (value < swir_min)
+                        swir_min = value;
                 }
             }
 
-            /* Write out the intermediate file */
-            status = fwrite (&input->buf[BI_NIR][0], sizeof (int16),
-                             input->size.s, fd1);
-            if (status != input->size.s)
-            {
-                sprintf (errstr, "Writing file: b4.bin\n");
-                RETURN_ERROR (errstr, "pcloud", FAILURE);
-            }
-            status = fwrite (&input->buf[BI_SWIR_1][0], sizeof (int16),
-                             input->size.s, fd2);
-            if (status != input->size.s)
-            {
-                sprintf (errstr, "Writing file: b5.bin\n");
-                RETURN_ERROR (errstr, "pcloud", FAILURE);
-            }
+            /* Keep the line for the flood fill */
+            memcpy (&nir_data[row * ncols], &input->buf[BI_NIR][0],
+                    ncols * sizeof (int16));
+            memcpy (&swir_data[row * ncols], &input->buf[BI_SWIR_1][0],
+                    ncols * sizeof (int16));
         }
         printf ("\n");
 
-        /* Close the intermediate file */
-        status = fclose (fd1);
-        if (status)
-        {
-            sprintf (errstr, "Closing file: b4.bin\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        status = fclose (fd2);
-        if (status)
-        {
-            sprintf (errstr, "Closing file: b5.bin\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-
         /* Estimating background (land) Band 4 Ref */
-        status = prctile (nir, nir_count, nir_min, nir_max,
-                          100.0 * l_pt, &backg_b4);
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Calling prctile function\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        status = prctile (swir, swir_count, swir_min, swir_max,
-                          100.0 * l_pt, &backg_b5);
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Calling prctile function\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
+        histogram16_prctile (nir, nir_min, nir_max, 100.0 * l_pt, &backg_b4);
+        histogram16_prctile (swir, swir_min, swir_max, 100.0 * l_pt,
+                             &backg_b5);
 
         /* Release the memory */
-        free (nir);
-        free (swir);
+        free_histogram16 (nir);
+        free_histogram16 (swir);
         nir = NULL;
         swir = NULL;
 
-        /* Write out the intermediate values */
-        fd1 = fopen ("b4_b5.txt", "w");
-        if (fd1 == NULL)
+        /* Allocate memory for the filled band 4 and 5 */
+        new_nir = malloc (input->size.l * input->size.s * sizeof (int16));
+        new_swir = malloc (input->size.l * input->size.s * sizeof (int16));
+        if (new_nir == NULL || new_swir == NULL)
         {
-            sprintf (errstr, "Opening file: b4_b5.txt\n");
+            sprintf (errstr, "Allocating new_nir/new_swir memory");
             RETURN_ERROR (errstr, "pcloud", FAILURE);
         }
 
-        /* Write out the intermediate file */
-        fprintf (fd1, "%f\n", backg_b4);
-        fprintf (fd1, "%f\n", backg_b5);
-        fprintf (fd1, "%d\n", input->size.l);
-        fprintf (fd1, "%d\n", input->size.s);
-
-        /* Close the intermediate file */
-        status = fclose (fd1);
-        if (status)
+        /* Call the fill minima routine to do image fill.  The band 4 and 5
+           fills are independent, so if more than one thread is allowed the
+           band 5 fill is run in its own thread. */
+        if (verbose)
+            printf ("Filling local minima of band 4 and 5\n");
+        nir_fill.in_img = nir_data;
+        nir_fill.boundary_value = backg_b4;
+        nir_fill.out_img = new_nir;
+        swir_fill.in_img = swir_data;
+        swir_fill.boundary_value = backg_b5;
+        swir_fill.out_img = new_swir;
+        nir_fill.nrows = swir_fill.nrows = nrows;
+        nir_fill.ncols = swir_fill.ncols = ncols;
+        nir_fill.null_value = swir_fill.null_value = -9999;
+
+        swir_threaded = false;
+        if (num_threads > 1)
         {
-            sprintf (errstr, "Closing file: b4_b5.txt\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
+            if (pthread_create (&swir_thread, NULL, fill_minima_thread,
+                                &swir_fill) == 0)
+                swir_threaded = true;
+            else if (verbose)
+                printf ("Unable to start band 5 fill thread, filling "
+                        "serially\n");
         }
-
-        /* Call the fill minima routine to do image fill */
-        status = system ("run_fillminima.py");
-        if (status != SUCCESS)
+        fill_minima_thread (&nir_fill);
+        if (swir_threaded)
         {
-            sprintf (errstr, "Running run_fillminima.py routine\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
+            if (pthread_join (swir_thread, NULL) != 0)
+            {
+                sprintf (errstr, "Joining band 5 fill thread\n");
+                RETURN_ERROR (errstr, "pcloud", FAILURE);
+            }
         }
+        else
+            fill_minima_thread (&swir_fill);
 
-        /* Open the intermediate file for reading */
-        fd1 = fopen ("filled_b4.bin", "rb");
-        if (fd1 == NULL)
+        if (nir_fill.status != SUCCESS)
         {
-            sprintf (errstr, "Opening file: filled_b4.bin\n");
+            sprintf (errstr, "Filling minima of band 4\n");
             RETURN_ERROR (errstr, "pcloud", FAILURE);
         }
-
-        fd2 = fopen ("filled_b5.bin", "rb");
-        if (fd2 == NULL)
+        if (swir_fill.status != SUCCESS)
         {
-            sprintf (errstr, "Opening file: filled_b5.bin\n");
+            sprintf (errstr, "Filling minima of band 5\n");
             RETURN_ERROR (errstr, "pcloud", FAILURE);
         }
 
-        /* May need allocate two memory for new band 4 and 5 */
-        int16 *new_nir;
-        int16 *new_swir;
-
-        new_nir = (int16 *) malloc (input->size.s * sizeof (int16));
-        new_swir = (int16 *) malloc (input->size.s * sizeof (int16));
-        if (new_nir == NULL || new_swir == NULL)
-        {
-            sprintf (errstr, "Allocating new_nir/new_swir memory");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
+        /* Release the memory */
+        free (nir_data);
+        free (swir_data);
+        nir_data = NULL;
+        swir_data = NULL;
 
         if (verbose)
             printf ("The sixth pass\n");
@@ -1099,11 +1025,10 @@ int potential_cloud_shadow_snow_mask
                 }
             }
 
-            /* For each of the image bands */
-            for (ib = 0; ib < input->nband; ib++)
+            /* Only bands 4 and 5 are used; the fill pixels come from the
+               fill bit plane -- data is read into input->buf[ib] */
+            for (ib = BI_NIR; ib <= BI_SWIR_1; ib++)
             {
-                /* Read each input reflective band -- data is read into
-                   input->buf[ib] */
                 if (!GetInputLine (input, ib, row))
                 {
                     sprintf (errstr, "Reading input image data for line %d, "
@@ -1112,59 +1037,22 @@ int potential_cloud_shadow_snow_mask
                 }
             }
 
-            /* For the thermal band, data is read into input->therm_buf */
-            if (!GetInputThermLine (input, row))
-            {
-                sprintf (errstr, "Reading input thermal data for line %d",
-                         row);
-                RETURN_ERROR (errstr, "pcloud", FAILURE);
-            }
-
-            /* Read out the intermediate file */
-            fread (&new_nir[0], sizeof (int16), input->size.s, fd1);
-            fread (&new_swir[0], sizeof (int16), input->size.s, fd2);
-
             for (col = 0; col < ncols; col++)
             {
-                if (input->buf[BI_NIR][col]
-                    == input->meta.satu_value_ref[BI_NIR])
-                {
-                    input->buf[BI_NIR][col] =
-                        input->meta.satu_value_max[BI_NIR];
-                }
-                if (input->buf[BI_SWIR_1][col]
-                    == input->meta.satu_value_ref[BI_SWIR_1])
-                {
-                    input->buf[BI_SWIR_1][col] =
-                        input->meta.satu_value_max[BI_SWIR_1];
-                }
+                pixel_index = row * ncols + col;
 
-                /* process non-fill pixels only
-                   Due to a problem with the input LPGS data, the thermal
-                   band may have values less than -9999 after scaling so
-                   exclude those as well */
-                if (input->therm_buf[col] <= -9999
-                    || input->buf[BI_BLUE][col] == -9999
-                    || input->buf[BI_GREEN][col] == -9999
-                    || input->buf[BI_RED][col] == -9999
-                    || input->buf[BI_NIR][col] == -9999
-                    || input->buf[BI_SWIR_1][col] == -9999
-                    || input->buf[BI_SWIR_2][col] == -9999)
-                {
-                    mask = 0;
-                }
-                else
-                    mask = 1;
+                /* process non-fill pixels only */
+                mask = !TEST_BITPLANE_PIXEL (input->fill_plane, row, col);
 
                 if (mask == 1)
                 {
-                    new_nir[col] -= input->buf[BI_NIR][col];
-                    new_swir[col] -= input->buf[BI_SWIR_1][col];
+                    new_nir[pixel_index] -= input->buf[BI_NIR][col];
+                    new_swir[pixel_index] -= input->buf[BI_SWIR_1][col];
 
-                    if (new_nir[col] < new_swir[col])
-                        shadow_prob = new_nir[col];
+                    if (new_nir[pixel_index] < new_swir[pixel_index])
+                        shadow_prob = new_nir[pixel_index];
                     else
-                        shadow_prob = new_swir[col];
+                        shadow_prob = new_swir[pixel_index];
 
                     if (shadow_prob > 200)
                         pixel_mask[row][col] |= 1 << SHADOW_BIT;
@@ -1195,52 +1083,6 @@ int potential_cloud_shadow_snow_mask
         free (new_swir);
         new_nir = NULL;
         new_swir = NULL;
-
-        /* Close the intermediate file */
-        status = fclose (fd1);
-        if (status)
-        {
-            sprintf (errstr, "Closing file: filled_b4.bin\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        status = fclose (fd2);
-        if (status)
-        {
-            sprintf (errstr, "Closing file: filled_b5.bin\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-
-        /* Remove the intermediate files */
-        status = system ("rm b4_b5.txt");
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Removing b4_b5.txt file\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        status = system ("rm b4.bin");
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Removing b4.bin file\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        status = system ("rm b5.bin");
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Removing b5.bin file\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        status = system ("rm filled_b4.bin");
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Removing filled_b4.bin file\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
-        status = system ("rm filled_b5.bin");
-        if (status != SUCCESS)
-        {
-            sprintf (errstr, "Removing filled_b5.bin file\n");
-            RETURN_ERROR (errstr, "pcloud", FAILURE);
-        }
     }
 
     status = free_2d_array ((void **) clear_mask);
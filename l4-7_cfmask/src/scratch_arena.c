@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "const.h"
+#include "error.h"
+#include "scratch_arena.h"
+
+/* Bytes each array handed out is rounded up to, so the next one is aligned
+   for any element type */
+#define SCRATCH_ALIGN 16
+
+/* Smallest block allocated */
+#define SCRATCH_MIN_BLOCK 65536
+
+/******************************************************************************
+MODULE:  seconds_now
+
+PURPOSE: Read a monotonic clock for timing the allocator calls
+
+RETURN: Time in seconds from an unspecified start
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+static double seconds_now (void)
+{
+    struct timespec now;        /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+/******************************************************************************
+MODULE:  add_scratch_block
+
+PURPOSE: Allocate a new block for a scratch arena to hand out memory from
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The blocks filled are kept until the arena is reset, as the memory
+   handed out from them is still in use.
+******************************************************************************/
+static int add_scratch_block
+(
+    Scratch_arena_t *arena, /* I/O: arena */
+    size_t size             /* I: bytes the block needs at least */
+)
+{
+    Scratch_block_t *block;     /* new block */
+    double start;               /* time the allocator was called */
+
+    if (arena->block != NULL && size < 2 * arena->block->size)
+        size = 2 * arena->block->size;
+    if (size < SCRATCH_MIN_BLOCK)
+        size = SCRATCH_MIN_BLOCK;
+
+    start = seconds_now ();
+    block = malloc (sizeof (Scratch_block_t) + size);
+    arena->system_seconds += seconds_now () - start;
+    arena->system_allocs++;
+    if (block == NULL)
+        RETURN_ERROR ("Allocating a scratch block", "add_scratch_block",
+                      FAILURE);
+
+    block->prev = arena->block;
+    block->size = size;
+    arena->block = block;
+    arena->used = 0;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  init_scratch_arena
+
+PURPOSE: Set up a scratch arena with no memory
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void init_scratch_arena
+(
+    Scratch_arena_t *arena  /* O: arena with no memory */
+)
+{
+    arena->block = NULL;
+    arena->used = 0;
+    arena->allocs = 0;
+    arena->system_allocs = 0;
+    arena->system_seconds = 0.0;
+}
+
+/******************************************************************************
+MODULE:  scratch_alloc
+
+PURPOSE: Hand out memory from a scratch arena
+
+RETURN: Pointer to the memory, NULL on error
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The memory is not cleared, and is released by the next reset of the
+   arena; it is not freed by itself.
+******************************************************************************/
+void *scratch_alloc
+(
+    Scratch_arena_t *arena, /* I/O: arena */
+    size_t size             /* I: bytes needed */
+)
+{
+    void *ptr;                  /* memory handed out */
+
+    size = (size + SCRATCH_ALIGN - 1) / SCRATCH_ALIGN * SCRATCH_ALIGN;
+    if (arena->block == NULL || arena->used + size > arena->block->size)
+    {
+        if (add_scratch_block (arena, size) != SUCCESS)
+            RETURN_ERROR ("Allocating scratch memory", "scratch_alloc",
+                          NULL);
+    }
+
+    ptr = (char *) arena->block->data + arena->used;
+    arena->used += size;
+    arena->allocs++;
+
+    return ptr;
+}
+
+/******************************************************************************
+MODULE:  scratch_alloc_2d
+
+PURPOSE: Hand out a 2D array from a scratch arena
+
+RETURN: Pointer to the row pointers of the array, NULL on error
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The array is indexed as one from allocate_2d_array, but is released by
+   the next reset of the arena and must not be passed to free_2d_array.
+******************************************************************************/
+void **scratch_alloc_2d
+(
+    Scratch_arena_t *arena, /* I/O: arena */
+    int rows,               /* I: number of rows */
+    int columns,            /* I: number of columns */
+    size_t member_size      /* I: size of each element */
+)
+{
+    void **row_ptrs;            /* pointers to the rows */
+    char *data;                 /* array data */
+    size_t ptr_size;            /* bytes of the row pointers, aligned */
+    int row;                    /* row number */
+
+    ptr_size = (rows * sizeof (void *) + SCRATCH_ALIGN - 1)
+               / SCRATCH_ALIGN * SCRATCH_ALIGN;
+    row_ptrs = scratch_alloc (arena, ptr_size
+                                     + (size_t) rows * columns * member_size);
+    if (row_ptrs == NULL)
+        RETURN_ERROR ("Allocating a scratch 2D array", "scratch_alloc_2d",
+                      NULL);
+
+    data = (char *) row_ptrs + ptr_size;
+    for (row = 0; row < rows; row++)
+        row_ptrs[row] = data + (size_t) row * columns * member_size;
+
+    return row_ptrs;
+}
+
+/******************************************************************************
+MODULE:  reset_scratch_arena
+
+PURPOSE: Release all the memory handed out by a scratch arena
+
+RETURN: SUCCESS
+        FAILURE
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. If more than one block was filled they are replaced by one block as
+   large as all of them, so the same work needs no more allocator calls.
+******************************************************************************/
+int reset_scratch_arena
+(
+    Scratch_arena_t *arena  /* I/O: arena; all its memory is released */
+)
+{
+    size_t size;                /* bytes of all the blocks */
+    Scratch_block_t *prev;      /* block filled before the one freed */
+    double start;               /* time the allocator was called */
+
+    arena->used = 0;
+    if (arena->block == NULL || arena->block->prev == NULL)
+        return SUCCESS;
+
+    size = 0;
+    start = seconds_now ();
+    while (arena->block != NULL)
+    {
+        size += arena->block->size;
+        prev = arena->block->prev;
+        free (arena->block);
+        arena->block = prev;
+    }
+    arena->system_seconds += seconds_now () - start;
+
+    if (add_scratch_block (arena, size) != SUCCESS)
+        RETURN_ERROR ("Joining the scratch blocks", "reset_scratch_arena",
+                      FAILURE);
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+MODULE:  free_scratch_arena
+
+PURPOSE: Free the blocks of a scratch arena
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The counts and times are kept, and the arena can be used again.
+******************************************************************************/
+void free_scratch_arena
+(
+    Scratch_arena_t *arena  /* I/O: arena; its blocks are freed */
+)
+{
+    Scratch_block_t *prev;      /* block filled before the one freed */
+
+    while (arena->block != NULL)
+    {
+        prev = arena->block->prev;
+        free (arena->block);
+        arena->block = prev;
+    }
+    arena->used = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <stddef.h>
+
+/* Block of memory handed out by a scratch arena */
+typedef struct Scratch_block
+{
+    struct Scratch_block *prev; /* block filled before this one, or NULL */
+    size_t size;                /* bytes in data */
+    double data[];              /* memory handed out; double for the
+                                   alignment */
+} Scratch_block_t;
+
+/* Memory for the arrays of one piece of work at a time, such as one cloud
+   object, handed out in order from blocks and all released together by
+   reset_scratch_arena.  A reset joins the blocks used into one, so once the
+   arena has held the largest piece of work the allocator is not called
+   again.  An arena is used by one thread at a time. */
+typedef struct
+{
+    Scratch_block_t *block;     /* block memory is handed out from, or NULL */
+    size_t used;                /* bytes of block handed out */
+    long allocs;                /* arrays handed out */
+    long system_allocs;         /* allocator calls for blocks */
+    double system_seconds;      /* time in the allocator for blocks */
+} Scratch_arena_t;
+
+void init_scratch_arena
+(
+    Scratch_arena_t *arena  /* O: arena with no memory */
+);
+
+void *scratch_alloc
+(
+    Scratch_arena_t *arena, /* I/O: arena */
+    size_t size             /* I: bytes needed */
+);
+
+void **scratch_alloc_2d
+(
+    Scratch_arena_t *arena, /* I/O: arena */
+    int rows,               /* I: number of rows */
+    int columns,            /* I: number of columns */
+    size_t member_size      /* I: size of each element */
+);
+
+int reset_scratch_arena
+(
+    Scratch_arena_t *arena  /* I/O: arena; all its memory is released */
+);
+
+void free_scratch_arena
+(
+    Scratch_arena_t *arena  /* I/O: arena; its blocks are freed */
+);
+
+#endif
@@ -0,0 +1,381 @@
+
+#include <math.h>
+
+/* The AVX2 kernels are built for AVX2 with the target attribute whatever
+   the compile flags, and are used when the CPU running cfmask has AVX2 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(NO_AVX2_KERNELS)
+#define AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+#include "const.h"
+#include "shadow_project.h"
+
+/* Average Landsat 4, 5 & 7 height (m) */
+#define SATELLITE_HEIGHT 705000.0f
+
+/* Whether the AVX2 kernels may be used, see use_shadow_project_simd */
+static bool simd_allowed = true;
+
+/******************************************************************************
+MODULE:  use_shadow_project_simd
+
+PURPOSE: Allow or stop the use of the AVX2 kernels by project_cloud and
+         project_shadow
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The AVX2 kernels are allowed by default.  This is for timing and checking
+   the scalar kernels on CPUs which have AVX2; it is not thread safe, so call
+   it before any projection.
+******************************************************************************/
+void use_shadow_project_simd
+(
+    bool use_simd         /* I: true to allow the AVX2 kernels */
+)
+{
+    simd_allowed = use_simd;
+}
+
+#if defined(AVX2_KERNELS)
+/******************************************************************************
+MODULE:  have_avx2
+
+PURPOSE: Find whether the AVX2 kernels may be used on this CPU
+
+RETURN: true if they may be used
+******************************************************************************/
+static bool have_avx2 (void)
+{
+    return simd_allowed && __builtin_cpu_supports ("avx2");
+}
+
+/******************************************************************************
+MODULE:  project_cloud_avx2
+
+PURPOSE: AVX2 kernel of project_cloud, for the pixels in whole groups of 8
+
+RETURN: Number of pixels projected
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static int project_cloud_avx2
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const int *x,         /* I: pixel columns */
+    const int *y,         /* I: pixel rows */
+    const float *h,       /* I: cloud pixel heights (m) */
+    int npixels,          /* I: number of pixels */
+    float *x_new,         /* O: true pixel columns */
+    float *y_new          /* O: true pixel rows */
+)
+{
+    __m256 va = _mm256_set1_ps (geometry->a);
+    __m256 vb = _mm256_set1_ps (geometry->b);
+    __m256 vc = _mm256_set1_ps (geometry->c);
+    __m256 v_inv_ab = _mm256_set1_ps (geometry->inv_a_b_distance);
+    __m256 v_inv_cos =
+        _mm256_set1_ps (geometry->inv_cos_omiga_per_minus_par);
+    __m256 v_cos_par = _mm256_set1_ps (geometry->cos_omiga_par);
+    __m256 v_sin_par = _mm256_set1_ps (geometry->sin_omiga_par);
+    __m256 v_height = _mm256_set1_ps (SATELLITE_HEIGHT);
+    __m256 vx, vy, vmove;
+    int i;
+
+    for (i = 0; i + 8 <= npixels; i += 8)
+    {
+        vx = _mm256_cvtepi32_ps (_mm256_loadu_si256 ((const __m256i *)
+                                                     (x + i)));
+        vy = _mm256_cvtepi32_ps (_mm256_loadu_si256 ((const __m256i *)
+                                                     (y + i)));
+        vmove = _mm256_add_ps (_mm256_add_ps (_mm256_mul_ps (va, vx),
+                                              _mm256_mul_ps (vb, vy)), vc);
+        vmove = _mm256_mul_ps (_mm256_mul_ps (vmove, v_inv_ab), v_inv_cos);
+        vmove = _mm256_div_ps (_mm256_mul_ps (vmove,
+                                              _mm256_loadu_ps (h + i)),
+                               v_height);
+        _mm256_storeu_ps (x_new + i,
+                          _mm256_add_ps (vx,
+                                         _mm256_mul_ps (vmove, v_cos_par)));
+        _mm256_storeu_ps (y_new + i,
+                          _mm256_add_ps (vy,
+                                         _mm256_mul_ps (vmove, v_sin_par)));
+    }
+
+    return i;
+}
+
+/******************************************************************************
+MODULE:  project_shadow_avx2
+
+PURPOSE: AVX2 kernel of project_shadow, for the pixels in whole groups of 4
+
+RETURN: Number of pixels projected
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static int project_shadow_avx2
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const float *x,       /* I: true pixel columns */
+    const float *y,       /* I: true pixel rows */
+    const float *h,       /* I: cloud pixel heights (m) */
+    int npixels,          /* I: number of pixels */
+    int *shadow_row,      /* O: shadow pixel rows */
+    int *shadow_col       /* O: shadow pixel columns */
+)
+{
+    __m256d per_pixel = _mm256_set1_pd (geometry->height_per_pixel);
+    __m256d dx = _mm256_set1_pd (geometry->shadow_dx);
+    __m256d dy = _mm256_set1_pd (geometry->shadow_dy);
+    __m256d length;
+    int i;
+
+    for (i = 0; i + 4 <= npixels; i += 4)
+    {
+        length = _mm256_div_pd (_mm256_cvtps_pd (_mm_loadu_ps (h + i)),
+                                per_pixel);
+        length = _mm256_cvtps_pd (_mm256_cvtpd_ps (length));
+        _mm_storeu_si128 ((__m128i *) (shadow_col + i),
+            _mm256_cvtpd_epi32 (_mm256_round_pd (
+                _mm256_add_pd (_mm256_cvtps_pd (_mm_loadu_ps (x + i)),
+                               _mm256_mul_pd (length, dx)),
+                _MM_FROUND_CUR_DIRECTION)));
+        _mm_storeu_si128 ((__m128i *) (shadow_row + i),
+            _mm256_cvtpd_epi32 (_mm256_round_pd (
+                _mm256_add_pd (_mm256_cvtps_pd (_mm_loadu_ps (y + i)),
+                               _mm256_mul_pd (length, dy)),
+                _MM_FROUND_CUR_DIRECTION)));
+    }
+
+    return i;
+}
+#endif
+
+/******************************************************************************
+MODULE:  init_shadow_geometry
+
+PURPOSE: Set up the view and solar geometry of the scene for project_cloud
+         and project_shadow
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The values are rounded the way the original code rounded them each time
+   they were used, so the projected pixels are the same.  The shadow
+   direction is signed here instead of adding or subtracting it per pixel;
+   negating a double is exact.
+******************************************************************************/
+void init_shadow_geometry
+(
+    float a,              /* I: view geometry coefficient, see viewgeo */
+    float b,              /* I: view geometry coefficient */
+    float c,              /* I: view geometry coefficient */
+    float omiga_par,      /* I: view geometry angle */
+    float omiga_per,      /* I: view geometry angle */
+    int sub_size,         /* I: pixel size (m) */
+    float sun_ele_rad,    /* I: sun elevation angle in radians */
+    float sun_tazi_rad,   /* I: sun azimuth angle less 90 degrees, in
+                                radians */
+    float sun_az,         /* I: sun azimuth angle in degrees */
+    Shadow_geometry_t *geometry /* O: geometry of the scene */
+)
+{
+    geometry->a = a;
+    geometry->b = b;
+    geometry->c = c;
+    geometry->inv_a_b_distance = 1 / sqrt (a * a + b * b);
+    geometry->inv_cos_omiga_per_minus_par = 1 / cos (omiga_per - omiga_par);
+    geometry->cos_omiga_par = cos (omiga_par);
+    geometry->sin_omiga_par = sin (omiga_par);
+
+    geometry->height_per_pixel = (float) sub_size * tan (sun_ele_rad);
+
+    /* The check here can assume to handle the south up north down scene
+       case correctly as azimuth angle needs to be added by 180.0 degree */
+    if ((sun_az - 180.0) < MINSIGMA)
+    {
+        geometry->shadow_dx = -cos (sun_tazi_rad);
+        geometry->shadow_dy = -sin (sun_tazi_rad);
+    }
+    else
+    {
+        geometry->shadow_dx = cos (sun_tazi_rad);
+        geometry->shadow_dy = sin (sun_tazi_rad);
+    }
+}
+
+/******************************************************************************
+MODULE:  project_cloud
+
+PURPOSE: Calculate the true positions of cloud pixels at the given heights,
+         correcting for the view angle
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+3/15/2013   Song Guo         Original Development (mat_truecloud)
+10/17/2026  USGS EROS        Scene geometry set up once, AVX2 kernel
+
+NOTES:
+1. All the arithmetic is single precision and done in the same order in
+   both kernels, so the AVX2 kernel, used when the CPU has AVX2, gives the
+   same positions as the scalar one.  The scalar kernel does the pixels
+   left over.
+******************************************************************************/
+void project_cloud
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const int *x,         /* I: pixel columns */
+    const int *y,         /* I: pixel rows */
+    const float *h,       /* I: cloud pixel heights (m) */
+    int npixels,          /* I: number of pixels */
+    float *x_new,         /* O: true pixel columns */
+    float *y_new          /* O: true pixel rows */
+)
+{
+    /* Local copies, so the stores can't be taken to change them */
+    float a = geometry->a;
+    float b = geometry->b;
+    float c = geometry->c;
+    float inv_a_b_distance = geometry->inv_a_b_distance;
+    float inv_cos_omiga_per_minus_par = geometry->inv_cos_omiga_per_minus_par;
+    float cos_omiga_par = geometry->cos_omiga_par;
+    float sin_omiga_par = geometry->sin_omiga_par;
+    float dist;                 /* distance */
+    float dist_par;             /* distance in parallel direction */
+    float dist_move;            /* distance moved */
+    int i = 0;
+
+#if defined(AVX2_KERNELS)
+    if (have_avx2 ())
+        i = project_cloud_avx2 (geometry, x, y, h, npixels, x_new, y_new);
+#endif
+
+    for (; i < npixels; i++)
+    {
+        dist = (a * (float) x[i] + b * (float) y[i] + c) * inv_a_b_distance;
+
+        /* from the cetral perpendicular (unit: pixel) */
+        dist_par = dist * inv_cos_omiga_per_minus_par;
+
+        /* cloud move distance (m) */
+        dist_move = (dist_par * h[i]) / SATELLITE_HEIGHT;
+
+        x_new[i] = x[i] + dist_move * cos_omiga_par;
+        y_new[i] = y[i] + dist_move * sin_omiga_par;
+    }
+}
+
+/******************************************************************************
+MODULE:  project_shadow
+
+PURPOSE: Calculate the shadow pixels cast by cloud pixels at their true
+         positions and heights
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The shadow length in pixels is rounded to single precision and the shadow
+   position is rounded to the nearest pixel in double precision, as the
+   original code did, in both kernels.  The AVX2 kernel is used when the
+   CPU has AVX2.  The rows and columns may be outside the image.
+******************************************************************************/
+void project_shadow
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const float *x,       /* I: true pixel columns */
+    const float *y,       /* I: true pixel rows */
+    const float *h,       /* I: cloud pixel heights (m) */
+    int npixels,          /* I: number of pixels */
+    int *shadow_row,      /* O: shadow pixel rows */
+    int *shadow_col       /* O: shadow pixel columns */
+)
+{
+    double height_per_pixel = geometry->height_per_pixel;
+    double shadow_dx = geometry->shadow_dx;
+    double shadow_dy = geometry->shadow_dy;
+    float i_xy;                 /* shadow length (pixels) */
+    int i = 0;
+
+#if defined(AVX2_KERNELS)
+    if (have_avx2 ())
+        i = project_shadow_avx2 (geometry, x, y, h, npixels, shadow_row,
+                                 shadow_col);
+#endif
+
+    for (; i < npixels; i++)
+    {
+        i_xy = h[i] / height_per_pixel;
+        shadow_col[i] = rint (x[i] + i_xy * shadow_dx);
+        shadow_row[i] = rint (y[i] + i_xy * shadow_dy);
+    }
+}
+
+/******************************************************************************
+MODULE:  shadow_motion
+
+PURPOSE: Calculate how far the shadow of each cloud pixel moves per meter of
+         cloud height
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Both the view angle correction of project_cloud and the shadow length of
+   project_shadow are proportional to the cloud height, so without the
+   rounding the shadow column of a pixel at height h is
+   x + h * move_x, and likewise for the row.  The positions this gives are
+   within SHADOW_MOTION_ERROR pixels of the rounded calculation.
+******************************************************************************/
+void shadow_motion
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const int *x,         /* I: pixel columns */
+    const int *y,         /* I: pixel rows */
+    int npixels,          /* I: number of pixels */
+    double *move_x,       /* O: change of the shadow column per meter of
+                                cloud height */
+    double *move_y        /* O: change of the shadow row per meter of cloud
+                                height */
+)
+{
+    double shadow_dx = geometry->shadow_dx / geometry->height_per_pixel;
+    double shadow_dy = geometry->shadow_dy / geometry->height_per_pixel;
+    float dist;                 /* distance */
+    float dist_par;             /* distance in parallel direction */
+    int i;
+
+    for (i = 0; i < npixels; i++)
+    {
+        dist = (geometry->a * (float) x[i] + geometry->b * (float) y[i]
+                + geometry->c) * geometry->inv_a_b_distance;
+        dist_par = dist * geometry->inv_cos_omiga_per_minus_par;
+
+        move_x[i] = (double) dist_par * geometry->cos_omiga_par
+                    / SATELLITE_HEIGHT + shadow_dx;
+        move_y[i] = (double) dist_par * geometry->sin_omiga_par
+                    / SATELLITE_HEIGHT + shadow_dy;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef SHADOW_PROJECT_H
+#define SHADOW_PROJECT_H
+
+#include <stdbool.h>
+
+/* View and solar geometry of a scene used to project the cloud pixels to
+   their true positions and then to their shadows; none of it changes
+   between cloud objects or heights, so it is set up once per scene by
+   init_shadow_geometry */
+typedef struct
+{
+    float a, b, c;                     /* view geometry, see viewgeo */
+    float inv_a_b_distance;            /* 1 / sqrt (a * a + b * b) */
+    float inv_cos_omiga_per_minus_par; /* 1 / cos (omiga_per - omiga_par) */
+    float cos_omiga_par;               /* cos (omiga_par) */
+    float sin_omiga_par;               /* sin (omiga_par) */
+    double height_per_pixel;           /* cloud height (m) which moves the
+                                          shadow one pixel */
+    double shadow_dx;                  /* column move of the shadow per
+                                          pixel of shadow length */
+    double shadow_dy;                  /* row move of the shadow per pixel
+                                          of shadow length */
+} Shadow_geometry_t;
+
+/* Shadow positions found from shadow_motion are within this many pixels of
+   the positions project_cloud and project_shadow give, for positions within
+   +/- 32768 pixels; the error is a few single precision roundings, at most
+   about 0.003 pixel */
+#define SHADOW_MOTION_ERROR 0.01
+
+void init_shadow_geometry
+(
+    float a,              /* I: view geometry coefficient, see viewgeo */
+    float b,              /* I: view geometry coefficient */
+    float c,              /* I: view geometry coefficient */
+    float omiga_par,      /* I: view geometry angle */
+    float omiga_per,      /* I: view geometry angle */
+    int sub_size,         /* I: pixel size (m) */
+    float sun_ele_rad,    /* I: sun elevation angle in radians */
+    float sun_tazi_rad,   /* I: sun azimuth angle less 90 degrees, in
+                                radians */
+    float sun_az,         /* I: sun azimuth angle in degrees */
+    Shadow_geometry_t *geometry /* O: geometry of the scene */
+);
+
+void use_shadow_project_simd
+(
+    bool use_simd         /* I: true to allow the AVX2 kernels */
+);
+
+void project_cloud
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const int *x,         /* I: pixel columns */
+    const int *y,         /* I: pixel rows */
+    const float *h,       /* I: cloud pixel heights (m) */
+    int npixels,          /* I: number of pixels */
+    float *x_new,         /* O: true pixel columns */
+    float *y_new          /* O: true pixel rows */
+);
+
+void project_shadow
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const float *x,       /* I: true pixel columns */
+    const float *y,       /* I: true pixel rows */
+    const float *h,       /* I: cloud pixel heights (m) */
+    int npixels,          /* I: number of pixels */
+    int *shadow_row,      /* O: shadow pixel rows */
+    int *shadow_col       /* O: shadow pixel columns */
+);
+
+void shadow_motion
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const int *x,         /* I: pixel columns */
+    const int *y,         /* I: pixel rows */
+    int npixels,          /* I: number of pixels */
+    double *move_x,       /* O: change of the shadow column per meter of
+                                cloud height */
+    double *move_y        /* O: change of the shadow row per meter of cloud
+                                height */
+);
+
+#endif
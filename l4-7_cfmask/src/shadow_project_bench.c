@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "const.h"
+#include "shadow_project.h"
+
+#define NPIXELS 1000            /* pixels per projection, as timed */
+#define NREPEATS 100000         /* projections timed for each kernel */
+
+/******************************************************************************
+MODULE:  elapsed
+
+PURPOSE: Find the seconds since a start time
+
+RETURN: Seconds elapsed
+******************************************************************************/
+static double elapsed
+(
+    const struct timespec *start  /* I: start time */
+)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec)
+           + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/******************************************************************************
+MODULE:  time_projection
+
+PURPOSE: Time project_cloud and project_shadow over the same pixels
+
+RETURN: Nanoseconds per projection of NPIXELS pixels
+******************************************************************************/
+static double time_projection
+(
+    const Shadow_geometry_t *geometry, /* I: geometry of the scene */
+    const int *x,         /* I: pixel columns */
+    const int *y,         /* I: pixel rows */
+    float *h,             /* I/O: cloud pixel heights (m), stepped up */
+    float *x_new,         /* O: true pixel columns */
+    float *y_new,         /* O: true pixel rows */
+    int *shadow_row,      /* O: shadow pixel rows */
+    int *shadow_col       /* O: shadow pixel columns */
+)
+{
+    struct timespec start;
+    long sink = 0;
+    int k;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (k = 0; k < NREPEATS; k++)
+    {
+        /* Change a height each time so nothing can be hoisted */
+        h[k % NPIXELS] += 1.0;
+        project_cloud (geometry, x, y, h, NPIXELS, x_new, y_new);
+        project_shadow (geometry, x_new, y_new, h, NPIXELS, shadow_row,
+                        shadow_col);
+        sink += shadow_row[k % NPIXELS];
+    }
+    if (sink == 1)
+        printf (" ");
+
+    return elapsed (&start) / NREPEATS * 1e9;
+}
+
+/******************************************************************************
+MODULE:  main (shadow_project_bench)
+
+PURPOSE: Time the cloud and shadow projection kernels per 1000 pixels, with
+         the scalar kernels and with the kernels cfmask picks on this CPU,
+         and check they project the pixels to the same places
+
+RETURN: SUCCESS if the kernels agree
+        FAILURE if they don't
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Built by "make bench"; it needs only shadow_project.o.
+******************************************************************************/
+int main (void)
+{
+    static int x[NPIXELS], y[NPIXELS];
+    static int row[2][NPIXELS], col[2][NPIXELS];
+    static float h[2][NPIXELS];
+    static float x_new[2][NPIXELS], y_new[2][NPIXELS];
+    float sun_az = 140.0;       /* sun azimuth angle in degrees */
+    Shadow_geometry_t geometry;
+    double scalar_ns, default_ns;
+    int mismatches = 0;
+    int i;
+
+    init_shadow_geometry (1000.5, -7000.25, 3.0e7, 0.2, -0.1, 30, 0.6,
+                          (sun_az - 90.0) * PI / 180.0, sun_az, &geometry);
+
+    srand (1);
+    for (i = 0; i < NPIXELS; i++)
+    {
+        x[i] = rand () % 8000;
+        y[i] = rand () % 8000;
+        h[0][i] = h[1][i] = (rand () % 1200000) / 100.0;
+    }
+
+    use_shadow_project_simd (false);
+    scalar_ns = time_projection (&geometry, x, y, h[0], x_new[0], y_new[0],
+                                 row[0], col[0]);
+    use_shadow_project_simd (true);
+    default_ns = time_projection (&geometry, x, y, h[1], x_new[1], y_new[1],
+                                  row[1], col[1]);
+
+    for (i = 0; i < NPIXELS; i++)
+    {
+        if (x_new[0][i] != x_new[1][i] || y_new[0][i] != y_new[1][i]
+            || row[0][i] != row[1][i] || col[0][i] != col[1][i])
+            mismatches++;
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    printf ("CPU has AVX2: %s\n",
+            __builtin_cpu_supports ("avx2") ? "yes" : "no");
+#endif
+    printf ("scalar: %.0f ns per 1k pixels\n", scalar_ns);
+    printf ("default: %.0f ns per 1k pixels (%.2fx)\n", default_ns,
+            scalar_ns / default_ns);
+    printf ("mismatched pixels: %d\n", mismatches);
+
+    return mismatches == 0 ? SUCCESS : FAILURE;
+}
@@ -0,0 +1,290 @@
+
+#include <math.h>
+
+#include "const.h"
+#include "cfmask.h"
+#include "spectral_tests.h"
+
+/* Values kept in the pixel_state scratch line */
+#define STATE_SETS_WHITENESS    1 /* pixel sets the whiteness */
+#define STATE_WHITENESS_PASSED  2 /* the whiteness it sets passes the test */
+#define STATE_REUSES_WHITENESS  4 /* fill pixel which passes every cloud test
+                                     but the whiteness test, which uses the
+                                     whiteness of an earlier pixel */
+
+/******************************************************************************
+MODULE:  init_spectral_tests
+
+PURPOSE: Initialize the counters and state for the first pass
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+******************************************************************************/
+void init_spectral_tests
+(
+    Spectral_tests_t *tests  /* O: counters and state to initialize */
+)
+{
+    tests->mask_counter = 0;
+    tests->clear_pixel_counter = 0;
+    tests->clear_land_pixel_counter = 0;
+    tests->clear_water_pixel_counter = 0;
+
+    /* The whiteness starts at 0.0, which passes the test */
+    tests->whiteness_passed = true;
+}
+
+/******************************************************************************
+MODULE:  spectral_tests_kernel
+
+PURPOSE: Branch-free sweep of the first pass spectral tests over one line
+
+RETURN: Number of fill pixels which reuse the whiteness of an earlier pixel
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. The restrict qualified parameters let the compiler vectorize the loop
+   without checking for overlapping lines.
+******************************************************************************/
+static int spectral_tests_kernel
+(
+    const int16 *restrict blue,   /* I: one line of each band */
+    const int16 *restrict green,
+    const int16 *restrict red,
+    const int16 *restrict nir,
+    const int16 *restrict swir1,
+    const int16 *restrict swir2,
+    const int16 *restrict therm,
+    int ncols,                    /* I: number of columns */
+    int blue_satu,                /* I: saturation thresholds of the */
+    int green_satu,               /*    visible bands */
+    int red_satu,
+    unsigned char *restrict pmask, /* I/O: one line of the pixel mask, with
+                                         the fill bits set */
+    unsigned char *restrict cmask, /* O: one line of the clear mask */
+    unsigned char *restrict state, /* O: one line of the pixel state */
+    Spectral_tests_t *restrict tests /* I/O: counters */
+)
+{
+    int mask_counter = 0;          /* non-fill pixel counter */
+    int clear_counter = 0;         /* clear sky pixel counter */
+    int clear_land_counter = 0;    /* clear land pixel counter */
+    int clear_water_counter = 0;   /* clear water pixel counter */
+    int reuse_counter = 0;         /* pixels which reuse the whiteness */
+    int col;                       /* column index */
+    int b, g, r, n, s1;            /* band values of the pixel */
+    int mask;                      /* is the pixel not fill */
+    int nr_sum, gs_sum, vis_sum;   /* band sums */
+    float ndvi, ndsi;              /* NDVI and NDSI values */
+    int ndvi_default, ndsi_default; /* are NDVI and NDSI set to 0.01 */
+    float visi_mean;               /* mean of visible bands */
+    float whiteness;               /* whiteness value */
+    float hot;                     /* hot value for hot test */
+    float ratio;                   /* band 4/5 ratio */
+    int basic_cloud;               /* passes the basic cloud test */
+    int snow, water;               /* snow and water test results */
+    int satu_bv;                   /* is a visible band saturated */
+    int white_pass;                /* passes the whiteness test */
+    int hot_pass;                  /* passes the haze test */
+    int ratio_pass;                /* passes the band 4/5 ratio test */
+    int cloud;                     /* final cloud test result */
+    int clear, clear_land, clear_water; /* clear test results */
+
+    for (col = 0; col < ncols; col++)
+    {
+        b = blue[col];
+        g = green[col];
+        r = red[col];
+        n = nir[col];
+        s1 = swir1[col];
+
+        /* process non-fill pixels only */
+        mask = (pmask[col] & (1 << FILL_BIT)) == 0;
+
+        /* The sums replace zero with one so the unused divisions are safe.
+           Where the original code sets NDVI or NDSI to 0.01 instead of
+           dividing, the *_default flags give the test results for 0.01
+           directly; selecting the float values keeps gcc from vectorizing
+           the loop. */
+        nr_sum = n + r;
+        ndvi = (float) (n - r) / (float) (nr_sum + (nr_sum == 0));
+        ndvi_default = (nr_sum == 0) | !mask;
+
+        gs_sum = g + s1;
+        ndsi = (float) (g - s1) / (float) (gs_sum + (gs_sum == 0));
+        ndsi_default = (gs_sum == 0) | !mask;
+
+        /* Basic cloud test, equation 1; 0.01 passes both tests */
+        basic_cloud = (ndsi_default | ((ndsi - 0.8) < MINSIGMA))
+                      & (ndvi_default | ((ndvi - 0.8) < MINSIGMA))
+                      & (swir2[col] > 300) & (therm[col] < 2700);
+
+        /* It takes every snow pixels including snow pixel under thin clouds
+           or icy clouds, equation 20; 0.01 fails the NDSI test */
+        snow = (!ndsi_default & ((ndsi - 0.15) > MINSIGMA))
+               & (therm[col] < 1000) & (n > 1100) & (g > 1000);
+
+        /* Zhe's water test (works over thin cloud), equation 5; 0.01 passes
+           all the NDVI tests */
+        water = (((ndvi_default | ((ndvi - 0.01) < MINSIGMA)) & (n < 1100))
+                 | ((ndvi_default | (((ndvi - 0.1) < MINSIGMA)
+                                     & (ndvi > MINSIGMA))) & (n < 500)))
+                & mask;
+
+        /* visible bands flatness (sum(abs)/mean < 0.6 => brigt and dark
+           cloud), equation 2; a zero mean fails the test */
+        vis_sum = b + g + r;
+        visi_mean = (float) (vis_sum + (vis_sum == 0)) / 3.0;
+        whiteness = ((fabs ((float) b - visi_mean)
+                      + fabs ((float) g - visi_mean)
+                      + fabs ((float) r - visi_mean))) / visi_mean;
+
+        /* if one visible band is saturated, whiteness = 0 */
+        satu_bv = (b >= blue_satu) | (g >= green_satu) | (r >= red_satu);
+        white_pass = satu_bv
+                     | ((vis_sum != 0) & ((whiteness - 0.7) < MINSIGMA));
+
+        /* Haze test, equation 3 */
+        hot = (float) b - 0.5 * (float) r - 800.0;
+        hot_pass = (hot > MINSIGMA) | satu_bv;
+
+        /* Ratio 4/5 > 0.75 test, equation 4 */
+        ratio = (float) n / (float) (s1 + (s1 == 0));
+        ratio_pass = (s1 != 0) & ((ratio - 0.75) > MINSIGMA);
+
+        /* Fill pixels which aren't saturated are left for the fix below */
+        cloud = basic_cloud & white_pass & hot_pass & ratio_pass
+                & (mask | satu_bv);
+
+        /* Test whether use thermal band or not */
+        clear = (!cloud) & mask;
+        clear_land = clear & !water;
+        clear_water = clear & water;
+
+        pmask[col] = (pmask[col]
+                      & ~((1 << CLOUD_BIT) | (1 << SNOW_BIT) | (1 << WATER_BIT)))
+                     | (cloud << CLOUD_BIT) | (snow << SNOW_BIT)
+                     | (water << WATER_BIT);
+        cmask[col] = (clear << CLEAR_BIT) | (clear_land << CLEAR_LAND_BIT)
+                     | (clear_water << CLEAR_WATER_BIT);
+
+        /* Keep what is needed to carry the whiteness across pixels */
+        state[col] = ((satu_bv | (basic_cloud & mask)) * STATE_SETS_WHITENESS)
+                     | (white_pass * STATE_WHITENESS_PASSED)
+                     | ((basic_cloud & !mask & !satu_bv & hot_pass
+                         & ratio_pass) * STATE_REUSES_WHITENESS);
+
+        mask_counter += mask;
+        clear_counter += clear;
+        clear_land_counter += clear_land;
+        clear_water_counter += clear_water;
+        reuse_counter += basic_cloud & !mask & !satu_bv;
+    }
+
+    tests->mask_counter += mask_counter;
+    tests->clear_pixel_counter += clear_counter;
+    tests->clear_land_pixel_counter += clear_land_counter;
+    tests->clear_water_pixel_counter += clear_water_counter;
+
+    return reuse_counter;
+}
+
+/******************************************************************************
+MODULE:  spectral_tests_row
+
+PURPOSE: Run the first pass spectral tests (basic cloud, snow, water,
+         whiteness, haze and band 4/5 ratio) on one line, setting the cloud,
+         snow and water bits of the pixel mask and the clear bits of the
+         clear mask
+
+RETURN: None
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Fused the first pass tests of
+                             potential_cloud_shadow_snow_mask into one
+                             branch-free sweep
+10/17/2026  USGS EROS        Take the fill pixels from the fill bits of the
+                             pixel mask, set from the fill bit plane of the
+                             input
+
+NOTES:
+1. The results are identical to the original tests.  Each test is computed
+   for every pixel with the same float/double expressions and the results
+   are combined with bitwise operations, so the main loop has no branches and
+   gcc vectorizes it (SSE2 by default, AVX2 with -mavx2).  There are no
+   SSE2 or AVX2 intrinsics, so the speed up depends on the compiler flags:
+   gcc leaves the loop scalar at plain -O2, for only about 1.3 times the
+   speed of the original loop, and vectorizes it at -O3 or with the
+   -ftree-vectorize -fvect-cost-model=cheap of the Makefiles.
+   spectral_tests_bench times it.  Each pixel mask and clear mask value is
+   stored once.
+2. The original code only computes the whiteness for non-fill pixels which
+   pass the basic cloud test, and saturated pixels set it to 0.0.  A fill
+   pixel which passes the basic cloud test uses whatever whiteness was set
+   last, possibly on an earlier line.  These pixels are rare, so they are
+   fixed after the main loop using the state carried in tests.  Fill pixels
+   are never clear, so only their cloud bit changes.
+******************************************************************************/
+void spectral_tests_row
+(
+    int16 **buf,                 /* I: one line of each TOA reflectance band,
+                                       saturation already corrected */
+    int16 *therm_buf,            /* I: one line of the thermal band,
+                                       saturation already corrected */
+    int ncols,                   /* I: number of columns */
+    int *satu_value_max,         /* I: maximum TOA value of each band */
+    unsigned char *pixel_mask,   /* I/O: one line of the pixel mask, with
+                                       the fill bits already set */
+    unsigned char *clear_mask,   /* O: one line of the clear mask */
+    unsigned char *pixel_state,  /* O: scratch line of ncols values */
+    Spectral_tests_t *tests      /* I/O: counters and state */
+)
+{
+    int reuse_counter;       /* pixels which reuse the whiteness */
+    int col;                 /* column index */
+    bool whiteness_passed;   /* whiteness result carried across pixels */
+
+    reuse_counter = spectral_tests_kernel (buf[BI_BLUE], buf[BI_GREEN],
+        buf[BI_RED], buf[BI_NIR], buf[BI_SWIR_1], buf[BI_SWIR_2], therm_buf,
+        ncols, satu_value_max[BI_BLUE] - 1, satu_value_max[BI_GREEN] - 1,
+        satu_value_max[BI_RED] - 1, pixel_mask, clear_mask, pixel_state,
+        tests);
+
+    /* Carry the whiteness through the line to the pixels which reuse it */
+    whiteness_passed = tests->whiteness_passed;
+    if (reuse_counter > 0)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            if (pixel_state[col] & STATE_SETS_WHITENESS)
+                whiteness_passed = pixel_state[col] & STATE_WHITENESS_PASSED;
+            else if ((pixel_state[col] & STATE_REUSES_WHITENESS)
+                     && whiteness_passed)
+                pixel_mask[col] |= 1 << CLOUD_BIT;
+        }
+    }
+    else
+    {
+        for (col = ncols - 1; col >= 0; col--)
+        {
+            if (pixel_state[col] & STATE_SETS_WHITENESS)
+            {
+                whiteness_passed = pixel_state[col] & STATE_WHITENESS_PASSED;
+                break;
+            }
+        }
+    }
+    tests->whiteness_passed = whiteness_passed;
+}
@@ -0,0 +1,40 @@
+#ifndef SPECTRAL_TESTS_H
+#define SPECTRAL_TESTS_H
+
+#include <stdbool.h>
+
+#include "cfmask.h"
+
+/* Pixel counters and state carried between the rows of the first pass */
+typedef struct
+{
+    int mask_counter;              /* non-fill pixel counter */
+    int clear_pixel_counter;       /* clear sky pixel counter */
+    int clear_land_pixel_counter;  /* clear land pixel counter */
+    int clear_water_pixel_counter; /* clear water pixel counter */
+    bool whiteness_passed;  /* whiteness test result of the last pixel which
+                               set the whiteness; fill pixels which pass the
+                               basic cloud test reuse it */
+} Spectral_tests_t;
+
+void init_spectral_tests
+(
+    Spectral_tests_t *tests  /* O: counters and state to initialize */
+);
+
+void spectral_tests_row
+(
+    int16 **buf,                 /* I: one line of each TOA reflectance band,
+                                       saturation already corrected */
+    int16 *therm_buf,            /* I: one line of the thermal band,
+                                       saturation already corrected */
+    int ncols,                   /* I: number of columns */
+    int *satu_value_max,         /* I: maximum TOA value of each band */
+    unsigned char *pixel_mask,   /* I/O: one line of the pixel mask, with
+                                       the fill bits already set */
+    unsigned char *clear_mask,   /* O: one line of the clear mask */
+    unsigned char *pixel_state,  /* O: scratch line of ncols values */
+    Spectral_tests_t *tests      /* I/O: counters and state */
+);
+
+#endif
@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "const.h"
+#include "cfmask.h"
+#include "spectral_tests.h"
+
+#define NCOLS 8000              /* pixels per line, as timed */
+#define NLINES 100              /* random lines checked */
+#define NREPEATS 2000           /* lines timed for each version */
+#define SATU_VALUE_MAX 12001    /* maximum TOA value of each band */
+
+/* Counters of the original first pass */
+typedef struct
+{
+    int mask_counter;              /* non-fill pixel counter */
+    int clear_pixel_counter;       /* clear sky pixel counter */
+    int clear_land_pixel_counter;  /* clear land pixel counter */
+    int clear_water_pixel_counter; /* clear water pixel counter */
+    float whiteness;               /* whiteness value, kept across lines */
+} Original_tests_t;
+
+/******************************************************************************
+MODULE:  original_tests_row
+
+PURPOSE: First pass spectral tests of one line as the per-pixel loop of
+         potential_cloud_shadow_snow_mask ran them before spectral_tests_row
+
+RETURN: None
+
+NOTES:
+1. The saturated values are already corrected, as they are for
+   spectral_tests_row.
+******************************************************************************/
+static void original_tests_row
+(
+    int16 **buf,                 /* I: one line of each TOA reflectance band */
+    int16 *therm_buf,            /* I: one line of the thermal band */
+    int ncols,                   /* I: number of columns */
+    int *satu_value_max,         /* I: maximum TOA value of each band */
+    unsigned char *pixel_mask,   /* I/O: one line of the pixel mask */
+    unsigned char *clear_mask,   /* I/O: one line of the clear mask */
+    Original_tests_t *tests      /* I/O: counters and whiteness */
+)
+{
+    int col;                    /* column index */
+    unsigned char mask;         /* is the pixel not fill */
+    float ndvi, ndsi;           /* NDVI and NDSI values */
+    float visi_mean;            /* mean of visible bands */
+    float hot;                  /* hot value for hot test */
+    int satu_bv;                /* is a visible band saturated */
+
+    for (col = 0; col < ncols; col++)
+    {
+        if (therm_buf[col] <= -9999 || buf[BI_BLUE][col] == -9999
+            || buf[BI_GREEN][col] == -9999 || buf[BI_RED][col] == -9999
+            || buf[BI_NIR][col] == -9999 || buf[BI_SWIR_1][col] == -9999
+            || buf[BI_SWIR_2][col] == -9999)
+        {
+            mask = 0;
+        }
+        else
+        {
+            mask = 1;
+            tests->mask_counter++;
+        }
+
+        if ((buf[BI_RED][col] + buf[BI_NIR][col]) != 0 && mask == 1)
+        {
+            ndvi = (float) (buf[BI_NIR][col] - buf[BI_RED][col])
+                   / (float) (buf[BI_NIR][col] + buf[BI_RED][col]);
+        }
+        else
+            ndvi = 0.01;
+
+        if ((buf[BI_GREEN][col] + buf[BI_SWIR_1][col]) != 0 && mask == 1)
+        {
+            ndsi = (float) (buf[BI_GREEN][col] - buf[BI_SWIR_1][col])
+                   / (float) (buf[BI_GREEN][col] + buf[BI_SWIR_1][col]);
+        }
+        else
+            ndsi = 0.01;
+
+        /* Basic cloud test, equation 1 */
+        if (((ndsi - 0.8) < MINSIGMA) && ((ndvi - 0.8) < MINSIGMA)
+            && (buf[BI_SWIR_2][col] > 300) && (therm_buf[col] < 2700))
+            pixel_mask[col] |= 1 << CLOUD_BIT;
+        else
+            pixel_mask[col] &= ~(1 << CLOUD_BIT);
+
+        /* Snow test, equation 20 */
+        if (((ndsi - 0.15) > MINSIGMA) && (therm_buf[col] < 1000)
+            && (buf[BI_NIR][col] > 1100) && (buf[BI_GREEN][col] > 1000))
+            pixel_mask[col] |= 1 << SNOW_BIT;
+        else
+            pixel_mask[col] &= ~(1 << SNOW_BIT);
+
+        /* Zhe's water test, equation 5 */
+        if (((((ndvi - 0.01) < MINSIGMA) && (buf[BI_NIR][col] < 1100))
+             || (((ndvi - 0.1) < MINSIGMA) && (ndvi > MINSIGMA)
+                 && (buf[BI_NIR][col] < 500)))
+            && (mask == 1))
+            pixel_mask[col] |= 1 << WATER_BIT;
+        else
+            pixel_mask[col] &= ~(1 << WATER_BIT);
+        if (mask == 0)
+            pixel_mask[col] |= 1 << FILL_BIT;
+
+        /* Visible bands flatness, equation 2 */
+        if ((pixel_mask[col] & (1 << CLOUD_BIT)) && mask == 1)
+        {
+            visi_mean = (float) (buf[BI_BLUE][col] + buf[BI_GREEN][col]
+                                 + buf[BI_RED][col]) / 3.0;
+            if (visi_mean != 0)
+            {
+                tests->whiteness = ((fabs ((float) buf[BI_BLUE][col]
+                                           - visi_mean)
+                                     + fabs ((float) buf[BI_GREEN][col]
+                                             - visi_mean)
+                                     + fabs ((float) buf[BI_RED][col]
+                                             - visi_mean))) / visi_mean;
+            }
+            else
+                tests->whiteness = 100.0;
+        }
+
+        if ((buf[BI_BLUE][col] >= (satu_value_max[BI_BLUE] - 1))
+            || (buf[BI_GREEN][col] >= (satu_value_max[BI_GREEN] - 1))
+            || (buf[BI_RED][col] >= (satu_value_max[BI_RED] - 1)))
+        {
+            tests->whiteness = 0.0;
+            satu_bv = 1;
+        }
+        else
+            satu_bv = 0;
+
+        if ((pixel_mask[col] & (1 << CLOUD_BIT))
+            && (tests->whiteness - 0.7) < MINSIGMA)
+            pixel_mask[col] |= 1 << CLOUD_BIT;
+        else
+            pixel_mask[col] &= ~(1 << CLOUD_BIT);
+
+        /* Haze test, equation 3 */
+        hot = (float) buf[BI_BLUE][col] - 0.5 * (float) buf[BI_RED][col]
+              - 800.0;
+        if ((pixel_mask[col] & (1 << CLOUD_BIT))
+            && (hot > MINSIGMA || satu_bv == 1))
+            pixel_mask[col] |= 1 << CLOUD_BIT;
+        else
+            pixel_mask[col] &= ~(1 << CLOUD_BIT);
+
+        /* Ratio 4/5 > 0.75 test, equation 4 */
+        if ((pixel_mask[col] & (1 << CLOUD_BIT)) && buf[BI_SWIR_1][col] != 0)
+        {
+            if ((float) buf[BI_NIR][col] / (float) (buf[BI_SWIR_1][col])
+                - 0.75 > MINSIGMA)
+                pixel_mask[col] |= 1 << CLOUD_BIT;
+            else
+                pixel_mask[col] &= ~(1 << CLOUD_BIT);
+        }
+        else
+            pixel_mask[col] &= ~(1 << CLOUD_BIT);
+
+        /* Clear tests */
+        if ((!(pixel_mask[col] & (1 << CLOUD_BIT))) && mask == 1)
+        {
+            clear_mask[col] |= 1 << CLEAR_BIT;
+            tests->clear_pixel_counter++;
+        }
+        else
+            clear_mask[col] &= ~(1 << CLEAR_BIT);
+
+        if ((!(pixel_mask[col] & (1 << WATER_BIT)))
+            && clear_mask[col] & (1 << CLEAR_BIT))
+        {
+            clear_mask[col] |= 1 << CLEAR_LAND_BIT;
+            tests->clear_land_pixel_counter++;
+            clear_mask[col] &= ~(1 << CLEAR_WATER_BIT);
+        }
+        else if ((pixel_mask[col] & (1 << WATER_BIT))
+                 && clear_mask[col] & (1 << CLEAR_BIT))
+        {
+            clear_mask[col] |= 1 << CLEAR_WATER_BIT;
+            tests->clear_water_pixel_counter++;
+            clear_mask[col] &= ~(1 << CLEAR_LAND_BIT);
+        }
+        else
+        {
+            clear_mask[col] &= ~(1 << CLEAR_WATER_BIT);
+            clear_mask[col] &= ~(1 << CLEAR_LAND_BIT);
+        }
+    }
+}
+
+/******************************************************************************
+MODULE:  random_line
+
+PURPOSE: Fill a line of each band with random values, including fill, zero
+         and saturated values, and set the fill bits of a pixel mask line
+
+RETURN: None
+******************************************************************************/
+static void random_line
+(
+    int16 **buf,                 /* O: one line of each TOA reflectance band */
+    int16 *therm_buf,            /* O: one line of the thermal band */
+    unsigned char *pixel_mask    /* O: one line of the pixel mask, with the
+                                       fill bits set */
+)
+{
+    int band;                   /* band index */
+    int col;                    /* column index */
+    int kind;                   /* kind of value */
+    int fill;                   /* is the pixel fill */
+
+    for (col = 0; col < NCOLS; col++)
+    {
+        fill = 0;
+        for (band = 0; band < BI_REFL_BAND_COUNT; band++)
+        {
+            kind = rand () % 100;
+            if (kind == 0)
+                buf[band][col] = -9999;
+            else if (kind == 1)
+                buf[band][col] = 0;
+            else if (kind == 2)
+                buf[band][col] = SATU_VALUE_MAX;
+            else
+                buf[band][col] = rand () % 6000;
+            fill |= buf[band][col] == -9999;
+        }
+        therm_buf[col] = rand () % 100 == 0 ? -9999 : rand () % 5000 - 2000;
+        fill |= therm_buf[col] <= -9999;
+        pixel_mask[col] = fill << FILL_BIT;
+    }
+}
+
+/******************************************************************************
+MODULE:  elapsed
+
+PURPOSE: Find the seconds since a start time
+
+RETURN: Seconds elapsed
+******************************************************************************/
+static double elapsed
+(
+    const struct timespec *start  /* I: start time */
+)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec)
+           + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/******************************************************************************
+MODULE:  main (spectral_tests_bench)
+
+PURPOSE: Time the original first pass loop and spectral_tests_row on one
+         line, and check they set the same masks and counters
+
+RETURN: SUCCESS if they agree
+        FAILURE if they don't
+
+HISTORY:
+Date        Programmer       Reason
+--------    ---------------  -------------------------------------
+10/17/2026  USGS EROS        Original Development
+
+NOTES:
+1. Built by "make bench"; it needs only spectral_tests.o.
+2. spectral_tests_row has no SSE2 or AVX2 code of its own; it is written so
+   the compiler vectorizes it.  gcc 12 at plain -O2 only uses its very cheap
+   vectorizer cost model and leaves the loop scalar, for about 1.3 times the
+   speed of the original loop, which is why the Makefiles add
+   -ftree-vectorize -fvect-cost-model=cheap.  Time it with and without them,
+   and with -mavx2, through EXTRA.
+******************************************************************************/
+int main (void)
+{
+    static int16 line[BI_REFL_BAND_COUNT][NCOLS];
+    static int16 therm_buf[NCOLS];
+    static unsigned char fill_mask[NCOLS];
+    static unsigned char pixel_mask[2][NCOLS], clear_mask[2][NCOLS];
+    static unsigned char pixel_state[NCOLS];
+    int16 *buf[BI_REFL_BAND_COUNT];
+    int satu_value_max[BI_REFL_BAND_COUNT];
+    Original_tests_t original;
+    Spectral_tests_t tests;
+    struct timespec start;
+    double original_us, fused_us;
+    int mismatches = 0;
+    int band;
+    int col;
+    int i;
+
+    for (band = 0; band < BI_REFL_BAND_COUNT; band++)
+    {
+        buf[band] = line[band];
+        satu_value_max[band] = SATU_VALUE_MAX;
+    }
+    memset (&original, 0, sizeof (original));
+    init_spectral_tests (&tests);
+
+    /* Check the lines one after another, as the first pass runs them */
+    srand (7);
+    for (i = 0; i < NLINES; i++)
+    {
+        random_line (buf, therm_buf, fill_mask);
+        memset (pixel_mask[0], 0, NCOLS);
+        memcpy (pixel_mask[1], fill_mask, NCOLS);
+        original_tests_row (buf, therm_buf, NCOLS, satu_value_max,
+                            pixel_mask[0], clear_mask[0], &original);
+        spectral_tests_row (buf, therm_buf, NCOLS, satu_value_max,
+                            pixel_mask[1], clear_mask[1], pixel_state,
+                            &tests);
+        for (col = 0; col < NCOLS; col++)
+        {
+            if (pixel_mask[0][col] != pixel_mask[1][col]
+                || clear_mask[0][col] != clear_mask[1][col])
+                mismatches++;
+        }
+    }
+    if (original.mask_counter != tests.mask_counter
+        || original.clear_pixel_counter != tests.clear_pixel_counter
+        || original.clear_land_pixel_counter
+           != tests.clear_land_pixel_counter
+        || original.clear_water_pixel_counter
+           != tests.clear_water_pixel_counter)
+        mismatches++;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NREPEATS; i++)
+    {
+        original_tests_row (buf, therm_buf, NCOLS, satu_value_max,
+                            pixel_mask[0], clear_mask[0], &original);
+    }
+    original_us = elapsed (&start) / NREPEATS * 1e6;
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NREPEATS; i++)
+    {
+        spectral_tests_row (buf, therm_buf, NCOLS, satu_value_max,
+                            pixel_mask[1], clear_mask[1], pixel_state,
+                            &tests);
+    }
+    fused_us = elapsed (&start) / NREPEATS * 1e6;
+
+    printf ("original loop:      %.1f us per %d pixel line\n", original_us,
+            NCOLS);
+    printf ("spectral_tests_row: %.1f us per %d pixel line (%.2fx)\n",
+            fused_us, NCOLS, original_us / fused_us);
+    printf ("mismatches: %d\n", mismatches);
+
+    return mismatches == 0 ? SUCCESS : FAILURE;
+}